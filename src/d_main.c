@@ -487,7 +487,9 @@ static void D_Display(void)
 
 			if (!automapactive && !dedicated && cv_renderview.value)
 			{
+				R_NextTextureCacheFrame();
 				R_ApplyLevelInterpolators(R_UsingFrameInterpolation() ? rendertimefrac : FRACUNIT);
+				PS_TRACE_BEGIN("Render view");
 				PS_START_TIMING(ps_rendercalltime);
 				if (players[displayplayer].mo || players[displayplayer].playerstate == PST_DEAD)
 				{
@@ -536,6 +538,7 @@ static void D_Display(void)
 						V_DoPostProcessor(1, postimgtype2, postimgparam2);
 				}
 				PS_STOP_TIMING(ps_rendercalltime);
+				PS_TRACE_END();
 				R_RestoreLevelInterpolators();
 			}
 
@@ -550,6 +553,7 @@ static void D_Display(void)
 				lastdraw = false;
 			}
 
+			PS_TRACE_BEGIN("UI");
 			PS_START_TIMING(ps_uitime);
 
 			if (gamestate == GS_LEVEL)
@@ -563,6 +567,7 @@ static void D_Display(void)
 		}
 		else
 		{
+			PS_TRACE_BEGIN("UI");
 			PS_START_TIMING(ps_uitime);
 		}
 	}
@@ -606,6 +611,7 @@ static void D_Display(void)
 	CON_Drawer();
 
 	PS_STOP_TIMING(ps_uitime);
+	PS_TRACE_END();
 
 	//
 	// wipe update
@@ -648,6 +654,8 @@ static void D_Display(void)
 		{
 			framecount = 0;
 			demostarttime = I_GetTime();
+			if (ps_benchmarking)
+				PS_ResetBenchmark();
 		}
 
 		wipetypepost = -1;
@@ -691,9 +699,13 @@ static void D_Display(void)
 			M_DrawPerfStats();
 		}
 
+		PS_TRACE_BEGIN("I_FinishUpdate");
 		PS_START_TIMING(ps_swaptime);
 		I_FinishUpdate(); // page flip or blit buffer
 		PS_STOP_TIMING(ps_swaptime);
+		PS_TRACE_END();
+
+		PS_UpdateBenchmarkFrame();
 	}
 }
 
@@ -1492,6 +1504,8 @@ void D_SRB2Main(void)
 	//--------------------------------------------------------- CONFIG.CFG
 	M_FirstLoadConfig(); // WARNING : this do a "COM_BufExecute()"
 
+	Picture_PrunePNGCache(); // now that r_pngcachesize is known
+
 	if (M_CheckParm("-gamedata") && M_IsNextParm())
 	{
 		// Moved from G_LoadGameData itself, as it would cause some crazy
@@ -1629,6 +1643,8 @@ void D_SRB2Main(void)
 	p = M_CheckParm("-playdemo");
 	if (!p)
 		p = M_CheckParm("-timedemo");
+	if (!p)
+		p = M_CheckParm("-benchdemo");
 	if (p && M_IsNextParm())
 	{
 		char tmp[MAX_WADPATH];
@@ -1644,7 +1660,9 @@ void D_SRB2Main(void)
 			strcat(tmp, M_GetNextParm());
 		}
 
-		FIL_DefaultExtension(tmp, ".lmp");
+		// -benchdemo can also play an internal demo lump
+		if (!M_CheckParm("-benchdemo"))
+			FIL_DefaultExtension(tmp, ".lmp");
 
 		CONS_Printf(M_GetText("Playing demo %s.\n"), tmp);
 
@@ -1653,6 +1671,18 @@ void D_SRB2Main(void)
 			singledemo = true; // quit after one demo
 			G_DeferedPlayDemo(tmp);
 		}
+		else if (M_CheckParm("-benchdemo"))
+		{
+			// Dump per-tic and per-frame timings and exit when done.
+			// Use -nodraw to leave rendering out of the measurement.
+			if (M_CheckParm("-benchout") && M_IsNextParm())
+				strlcpy(timedemo_benchout, M_GetNextParm(), sizeof timedemo_benchout);
+			else
+				strlcpy(timedemo_benchout, va("%s"PATHSEP"benchmark.json", srb2home), sizeof timedemo_benchout);
+			strlcpy(timedemo_name, tmp, sizeof timedemo_name);
+			timedemo_quit = true;
+			G_TimeDemo(tmp);
+		}
 		else
 			G_TimeDemo(tmp);
 
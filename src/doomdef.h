@@ -125,6 +125,11 @@ FILE *fopenfile(const char*, const char*);
 #define LOGMESSAGES // write message in log.txt
 #endif
 
+// Map WAD/PK3 files into memory instead of reading lumps through stdio
+#if (defined (__unix__) || defined (UNIXCOMMON)) && !defined (__CYGWIN__) && !defined (NOMMAP)
+#define HAVE_MMAP
+#endif
+
 #ifdef LOGMESSAGES
 extern FILE *logstream;
 extern char logfilename[1024];
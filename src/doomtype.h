@@ -244,8 +244,11 @@ enum {false = 0, true = 1};
 
 	#define FUNCNOINLINE __attribute__((noinline))
 
-	#if (__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 4) // >= GCC 4.4
-		#ifdef __i386__ // i386 only
+	#define PREFETCH(p) __builtin_prefetch(p)
+	#define THREADLOCAL __thread
+
+	#if (__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 4) || defined (__clang__) // >= GCC 4.4
+		#if defined (__i386__) || defined (__x86_64__) // x86 only
 			#define FUNCTARGET(X)  __attribute__ ((__target__ (X)))
 		#endif
 	#endif
@@ -263,6 +266,7 @@ enum {false = 0, true = 1};
 	#if _MSC_VER > 1200 // >= MSVC 6.0
 		#define ATTRNOINLINE __declspec(noinline)
 	#endif
+	#define THREADLOCAL __declspec(thread)
 #endif
 
 #ifndef FUNCPRINTF
@@ -310,6 +314,9 @@ enum {false = 0, true = 1};
 #ifndef ATTRNOINLINE
 #define ATTRNOINLINE
 #endif
+#ifndef PREFETCH
+#define PREFETCH(p) ((void)(p))
+#endif
 
 /* Miscellaneous types that don't fit anywhere else (Can this be changed?) */
 
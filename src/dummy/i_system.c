@@ -14,6 +14,11 @@ size_t I_GetFreeMem(size_t *total)
 	return 0;
 }
 
+INT32 I_GetCPUCount(void)
+{
+	return 1;
+}
+
 void I_Sleep(UINT32 ms)
 {
 	(void)ms;
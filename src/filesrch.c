@@ -640,6 +640,36 @@ INT32 samepaths(const char *path1, const char *path2)
 	return 0;
 }
 
+// Calls func for every regular file directly inside a directory, with
+// its full path, size and modification time.
+// Returns 1 if the directory could be read, and 0 if not.
+INT32 foreachfile(const char *path, void (*func)(const char *filepath, size_t size, time_t mtime, void *userdata), void *userdata)
+{
+	char filepath[dirpathlen];
+	struct dirent *dent;
+	struct stat fsstat;
+	DIR *dirhandle;
+
+	dirhandle = opendir(path);
+	if (dirhandle == NULL)
+		return 0;
+
+	while ((dent = readdir(dirhandle)) != NULL)
+	{
+		if (dent->d_name[0] == '.')
+			continue;
+
+		snprintf(filepath, sizeof filepath, "%s" PATHSEP "%s", path, dent->d_name);
+		if (stat(filepath, &fsstat) < 0 || !S_ISREG(fsstat.st_mode))
+			continue;
+
+		func(filepath, (size_t)fsstat.st_size, fsstat.st_mtime, userdata);
+	}
+
+	closedir(dirhandle);
+	return 1;
+}
+
 //
 // Directory loading
 //
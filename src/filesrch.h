@@ -32,6 +32,7 @@ filestatus_t filesearch(char *filename, const char *startpath, const UINT8 *want
 INT32 pathisdirectory(const char *path);
 INT32 samepaths(const char *path1, const char *path2);
 INT32 concatpaths(const char *path, const char *startpath);
+INT32 foreachfile(const char *path, void (*func)(const char *filepath, size_t size, time_t mtime, void *userdata), void *userdata);
 
 #ifndef AVOID_ERRNO
 extern int direrror;
@@ -39,6 +39,7 @@
 #include "v_video.h"
 #include "lua_hook.h"
 #include "md5.h" // demo checksums
+#include "m_perfstats.h" // -benchdemo
 #include "netcode/d_netfil.h" // G_CheckDemoExtraFiles
 
 boolean timingdemo; // if true, exit with report on completion
@@ -1664,7 +1665,7 @@ static void G_LoadDemoExtraFiles(UINT8 **pp, UINT16 this_demo_version)
 			if (numwadfiles >= MAX_WADFILES)
 				toomany = true;
 			else
-				ncs = findfile(filename, md5sum, false);
+				ncs = findfile(filename, sizeof filename, md5sum, false);
 
 			if (toomany)
 			{
@@ -1773,7 +1774,7 @@ static UINT8 G_CheckDemoExtraFiles(UINT8 **pp, boolean quick, UINT16 this_demo_v
 
 			if (numwadfiles >= MAX_WADFILES)
 				error = DFILE_ERROR_CANNOTLOAD;
-			else if (!quick && findfile(filename, md5sum, false) != FS_FOUND)
+			else if (!quick && findfile(filename, sizeof filename, md5sum, false) != FS_FOUND)
 				error = DFILE_ERROR_CANNOTLOAD;
 			else if (error < DFILE_ERROR_INCOMPLETEOUTOFORDER)
 				error |= DFILE_ERROR_NOTLOADED;
@@ -2615,6 +2616,8 @@ void G_TimeDemo(const char *name)
 	singletics = true;
 	framecount = 0;
 	demostarttime = I_GetTime();
+	if (timedemo_benchout[0])
+		PS_StartBenchmark();
 	G_DeferedPlayDemo(name);
 }
 
@@ -2685,6 +2688,8 @@ void G_DoneLevelLoad(void)
 	CONS_Printf(M_GetText("Loaded level in %f sec\n"), (double)(I_GetTime() - demostarttime) / TICRATE);
 	framecount = 0;
 	demostarttime = I_GetTime();
+	if (ps_benchmarking)
+		PS_ResetBenchmark();
 }
 
 /*
@@ -2777,6 +2782,10 @@ static void G_StopTimingDemo(void)
 	CONS_Printf(M_GetText("timed %u gametics in %d realtics - %u frames\n%f seconds, %f avg fps\n"),
 		leveltime,demotime,(UINT32)framecount,f1/TICRATE,f2/f1);
 
+	// Per-tic and per-frame timings, for -benchdemo
+	if (ps_benchmarking)
+		PS_StopBenchmark(timedemo_benchout, timedemo_name);
+
 	// CSV-readable timedemo results, for external parsing
 	if (timedemo_csv)
 	{
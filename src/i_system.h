@@ -42,6 +42,10 @@ extern UINT8 keyboard_started;
 */
 size_t I_GetFreeMem(size_t *total);
 
+/**	\brief	Returns the number of logical CPUs, at least 1
+*/
+INT32 I_GetCPUCount(void);
+
 /**	\brief	Returns precise time value for performance measurement. The precise
             time should be a monotonically increasing counter, and will wrap.
 			precise_t is internally represented as an unsigned integer and
@@ -283,6 +287,7 @@ typedef struct {
 	int PPCMM64    : 1; ///< PowerPC Movemem 64bit ok?
 	int ALPHAbyte  : 1; ///< ?
 	int PAE        : 1; ///< Physical Address Extension
+	int AVX2       : 1; ///< AVX2 features
 	int CPUs       : 8;
 } CPUInfoFlags;
 
@@ -430,6 +430,22 @@ static int call_single_hook(Hook_State *hook)
 {
 	int i;
 
+	if (ps_tracing)
+	{
+		/* name the span after the script the hook came from */
+		lua_Debug ar;
+		lua_pushvalue(gL, -1);
+		lua_getinfo(gL, ">S", &ar);
+		PS_TraceBeginCopy(ar.short_src);
+
+		for (i = -(hook->values) + 1; i <= 0; ++i)
+			lua_pushvalue(gL, hook->top + i);
+
+		call_single_hook_no_copy(hook);
+		PS_TRACE_END();
+		return 1;
+	}
+
 	for (i = -(hook->values) + 1; i <= 0; ++i)
 		lua_pushvalue(gL, hook->top + i);
 
@@ -566,6 +582,12 @@ int LUA_HookMobj(mobj_t *mobj, int hook_type)
 	return hook.status;
 }
 
+// Lets the game skip work that a hook might otherwise have overridden.
+boolean LUA_MobjHookAvailable(mobj_t *mobj, int hook_type)
+{
+	return mobj_hook_available(hook_type, mobj->type);
+}
+
 int LUA_Hook2Mobj(mobj_t *t1, mobj_t *t2, int hook_type)
 {
 	Hook_State hook;
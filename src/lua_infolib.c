@@ -34,6 +34,7 @@ extern CV_PossibleValue_t Color_cons_t[];
 extern UINT8 skincolor_modified[];
 
 boolean LUA_CallAction(enum actionnum actionnum, mobj_t *actor);
+boolean LUA_ActionOverridden(enum actionnum actionnum);
 state_t *astate;
 
 enum sfxinfo_read {
@@ -811,6 +812,11 @@ boolean LUA_SetLuaAction(void *stv, const char *action)
 	return true; // action successfully set.
 }
 
+boolean LUA_ActionOverridden(enum actionnum actionnum)
+{
+	return actionsoverridden[actionnum][0] != LUA_REFNIL;
+}
+
 static UINT8 superstack[NUMACTIONS];
 boolean LUA_CallAction(enum actionnum actionnum, mobj_t *actor)
 {
@@ -500,6 +500,8 @@ static int mobj_set(lua_State *L)
 	if (hook_cmd_running)
 		return luaL_error(L, "Do not alter mobj_t in CMD building code!");
 
+	P_WakeMobj(mo);
+
 	switch(field)
 	{
 	case mobj_valid:
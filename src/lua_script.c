@@ -694,7 +694,7 @@ void LUA_DumpFile(const char *filename)
 
 		// If findfile finds the file, the full path will be returned
 		// in filenamebuf == filename.
-		if (findfile(filenamebuf, NULL, true))
+		if (findfile(filenamebuf, sizeof filenamebuf, NULL, true))
 		{
 			if ((handle = fopen(filename, "rb")) == NULL)
 			{
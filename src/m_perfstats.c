@@ -18,6 +18,7 @@
 #include "z_zone.h"
 #include "p_local.h"
 #include "r_fps.h"
+#include "d_main.h" // srb2home
 
 #ifdef HWRENDER
 #include "hardware/hw_main.h"
@@ -103,6 +104,7 @@ perfstatrow_t rendertime_rows[] = {
 	{" portals", " Portals+Skybox:", &ps_sw_portaltime, PS_TIME|PS_LEVEL|PS_SW},
 	{" planes ", " R_DrawPlanes:  ", &ps_sw_planetime, PS_TIME|PS_LEVEL|PS_SW},
 	{" masked ", " R_DrawMasked:  ", &ps_sw_maskedtime, PS_TIME|PS_LEVEL|PS_SW},
+	{" drwqueu", " Draw queue:    ", &ps_sw_drawqueuetime, PS_TIME|PS_LEVEL|PS_SW|PS_HIDE_ZERO},
 	{" other  ", " Other:         ", &ps_otherrendertime, PS_TIME|PS_LEVEL|PS_SW},
 
 	{"ui     ", "UI render:     ", &ps_uitime, PS_TIME},
@@ -118,8 +120,17 @@ perfstatrow_t gamelogicbrief_row[] = {
 perfstatrow_t commoncounter_rows[] = {
 	{"bspcall", "BSP calls:   ", &ps_numbspcalls, 0},
 	{"sprites", "Sprites:     ", &ps_numsprites, 0},
+	{"thvisit", "Things seen: ", &ps_sw_spritesvisited, PS_SW},
+	{"thculld", "Thing culls: ", &ps_sw_spritesculled, PS_SW},
+	{"thprojd", "Projected:   ", &ps_sw_spritesprojected, PS_SW},
 	{"drwnode", "Drawnodes:   ", &ps_numdrawnodes, 0},
 	{"plyobjs", "Polyobjects: ", &ps_numpolyobjects, 0},
+	{"visplns", "Visplanes:   ", &ps_sw_numvisplanes, PS_SW},
+	{"plprobe", "Plane probes:", &ps_sw_planeprobes, PS_SW},
+	{"maxprob", "Max probe:   ", &ps_sw_maxplaneprobe, PS_SW},
+	{"drwcmds", "Draw cmds:   ", &ps_sw_numdrawcmds, PS_SW|PS_HIDE_ZERO},
+	{"drwtile", "Draw tiles:  ", &ps_sw_numdrawtiles, PS_SW|PS_HIDE_ZERO},
+	{"drwbins", "Binned cmds: ", &ps_sw_numdrawbinned, PS_SW|PS_HIDE_ZERO},
 	{0}
 };
 
@@ -470,7 +481,8 @@ static void PS_UpdateFrameStats(void)
 				ps_sw_spritecliptime.value.p +
 				ps_sw_portaltime.value.p +
 				ps_sw_planetime.value.p +
-				ps_sw_maskedtime.value.p;
+				ps_sw_maskedtime.value.p +
+				ps_sw_drawqueuetime.value.p;
 		}
 	}
 
@@ -549,9 +561,14 @@ static void PS_CountThinkers(void)
 	}
 }
 
+static void PS_UpdateBenchmarkTic(void);
+
 // Update all metrics that are calculated on every tick.
 void PS_UpdateTickStats(void)
 {
+	if (ps_benchmarking)
+		PS_UpdateBenchmarkTic();
+
 	if (cv_perfstats.value == 1 && cv_ps_samplesize.value > 1)
 	{
 		PS_UpdateRowHistories(gamelogicbrief_row, false);
@@ -840,3 +857,606 @@ void PS_SampleSize_OnChange(void)
 	if (cv_ps_samplesize.value > 1)
 		PS_ClearHistory();
 }
+
+//
+// Benchmark recording
+//
+// Unlike the HUD stats above, which only keep a rolling window
+// of samples, this keeps every tic and frame from the moment
+// PS_StartBenchmark is called, so that the whole run can be
+// written out for external comparison between builds.
+//
+
+typedef struct
+{
+	precise_t tictime;
+	precise_t playerthink;
+	precise_t thinkers;
+	precise_t thlist[NUM_THINKERLISTS];
+	precise_t luathinkframe;
+	precise_t other;
+	INT32 checkposition_calls;
+	INT32 lua_mobjhooks;
+} ps_benchtic_t;
+
+typedef struct
+{
+	precise_t frametime;
+	precise_t rendercall;
+	precise_t bsp;
+	precise_t spriteclip;
+	precise_t portals;
+	precise_t planes;
+	precise_t masked;
+	precise_t ui;
+	precise_t swap;
+} ps_benchframe_t;
+
+boolean ps_benchmarking = false;
+
+static ps_benchtic_t *bench_tics = NULL;
+static size_t bench_numtics = 0;
+static size_t bench_maxtics = 0;
+
+static ps_benchframe_t *bench_frames = NULL;
+static size_t bench_numframes = 0;
+static size_t bench_maxframes = 0;
+
+static precise_t bench_prevframetime = 0;
+
+static const char *const bench_thlist_names[NUM_THINKERLISTS] = {
+	"polyobj",
+	"main",
+	"mobj",
+	"dynslope",
+	"precip"
+};
+
+void PS_StartBenchmark(void)
+{
+	ps_benchmarking = true;
+	PS_ResetBenchmark();
+}
+
+// Throws away everything recorded so far, e.g. the level load or a wipe.
+void PS_ResetBenchmark(void)
+{
+	bench_numtics = 0;
+	bench_numframes = 0;
+	bench_prevframetime = I_GetPreciseTime();
+}
+
+static void PS_UpdateBenchmarkTic(void)
+{
+	ps_benchtic_t *tic;
+	int i;
+
+	if (bench_numtics >= bench_maxtics)
+	{
+		bench_maxtics = bench_maxtics ? bench_maxtics * 2 : 4096;
+		bench_tics = Z_Realloc(bench_tics, bench_maxtics * sizeof (ps_benchtic_t), PU_STATIC, NULL);
+	}
+
+	tic = &bench_tics[bench_numtics++];
+	tic->tictime = ps_tictime.value.p;
+	tic->playerthink = ps_playerthink_time.value.p;
+	tic->thinkers = ps_thinkertime.value.p;
+	for (i = 0; i < NUM_THINKERLISTS; i++)
+		tic->thlist[i] = ps_thlist_times[i].value.p;
+	tic->luathinkframe = ps_lua_thinkframe_time.value.p;
+	tic->other = tic->tictime - tic->playerthink - tic->thinkers - tic->luathinkframe;
+	tic->checkposition_calls = ps_checkposition_calls.value.i;
+	tic->lua_mobjhooks = ps_lua_mobjhooks.value.i;
+}
+
+// Called once per displayed frame, after I_FinishUpdate.
+void PS_UpdateBenchmarkFrame(void)
+{
+	ps_benchframe_t *frame;
+	precise_t currenttime;
+
+	if (!ps_benchmarking)
+		return;
+
+	if (bench_numframes >= bench_maxframes)
+	{
+		bench_maxframes = bench_maxframes ? bench_maxframes * 2 : 4096;
+		bench_frames = Z_Realloc(bench_frames, bench_maxframes * sizeof (ps_benchframe_t), PU_STATIC, NULL);
+	}
+
+	currenttime = I_GetPreciseTime();
+
+	frame = &bench_frames[bench_numframes++];
+	frame->frametime = currenttime - bench_prevframetime;
+	frame->rendercall = ps_rendercalltime.value.p;
+	frame->bsp = ps_bsptime.value.p;
+	frame->spriteclip = ps_sw_spritecliptime.value.p;
+	frame->portals = ps_sw_portaltime.value.p;
+	frame->planes = ps_sw_planetime.value.p;
+	frame->masked = ps_sw_maskedtime.value.p;
+	frame->ui = ps_uitime.value.p;
+	frame->swap = ps_swaptime.value.p;
+
+	bench_prevframetime = currenttime;
+}
+
+static double PS_BenchMicroseconds(precise_t value)
+{
+	const UINT64 precision = I_GetPrecisePrecision();
+	return (double)value * 1000000.0 / (double)precision;
+}
+
+static int PS_CompareBenchValues(const void *a, const void *b)
+{
+	const double va = *(const double *)a;
+	const double vb = *(const double *)b;
+	return (va > vb) - (va < vb);
+}
+
+typedef struct
+{
+	double mean, p50, p95, p99, max;
+} ps_benchsummary_t;
+
+// Nearest-rank percentiles over samples, which gets sorted in place.
+static void PS_SummarizeBenchValues(double *samples, size_t count, ps_benchsummary_t *summary)
+{
+	double sum = 0.0;
+	size_t i;
+
+	memset(summary, 0, sizeof (*summary));
+	if (!count)
+		return;
+
+	for (i = 0; i < count; i++)
+		sum += samples[i];
+
+	qsort(samples, count, sizeof (double), PS_CompareBenchValues);
+
+#define PERCENTILE(p) samples[(count * (p) + 99) / 100 - 1]
+	summary->mean = sum / count;
+	summary->p50 = PERCENTILE(50);
+	summary->p95 = PERCENTILE(95);
+	summary->p99 = PERCENTILE(99);
+	summary->max = samples[count - 1];
+#undef PERCENTILE
+}
+
+static void PS_WriteBenchSummary(FILE *f, const char *name, const ps_benchsummary_t *summary, boolean last)
+{
+	fprintf(f, "\t\t\"%s\": {\"mean\": %.3f, \"p50\": %.3f, \"p95\": %.3f, \"p99\": %.3f, \"max\": %.3f}%s\n",
+		name, summary->mean, summary->p50, summary->p95, summary->p99, summary->max, last ? "" : ",");
+}
+
+// Summarizes one precise_t field, at the given offset, of every recorded tic or frame.
+static void PS_SummarizeBenchField(const void *array, size_t stride, size_t count, size_t offset,
+	double *samples, ps_benchsummary_t *summary)
+{
+	const UINT8 *p = (const UINT8 *)array + offset;
+	size_t i;
+
+	for (i = 0; i < count; i++, p += stride)
+		samples[i] = PS_BenchMicroseconds(*(const precise_t *)p);
+
+	PS_SummarizeBenchValues(samples, count, summary);
+}
+
+static void PS_WriteJSONString(FILE *f, const char *s)
+{
+	fputc('"', f);
+	for (; *s; s++)
+	{
+		if (*s == '"' || *s == '\\')
+			fprintf(f, "\\%c", *s);
+		else if ((UINT8)*s < 0x20)
+			fprintf(f, "\\u%04x", (UINT8)*s);
+		else
+			fputc(*s, f);
+	}
+	fputc('"', f);
+}
+
+#define TICFIELD(field) bench_tics, sizeof (ps_benchtic_t), bench_numtics, offsetof(ps_benchtic_t, field)
+#define FRAMEFIELD(field) bench_frames, sizeof (ps_benchframe_t), bench_numframes, offsetof(ps_benchframe_t, field)
+
+static void PS_WriteBenchmarkJSON(FILE *f, const char *demoname)
+{
+	const size_t maxcount = max(bench_numtics, bench_numframes);
+	double *samples = malloc(max(maxcount, 1) * sizeof (double));
+	ps_benchsummary_t summary;
+	char name[32];
+	size_t i;
+	int j;
+
+	if (!samples)
+		I_Error("PS_WriteBenchmarkJSON: Out of memory");
+
+	fprintf(f, "{\n");
+	fputs("\t\"demo\": ", f);
+	PS_WriteJSONString(f, demoname);
+	fputs(",\n", f);
+	fprintf(f, "\t\"rendermode\": %d,\n", rendermode);
+	fprintf(f, "\t\"width\": %d,\n", vid.width);
+	fprintf(f, "\t\"height\": %d,\n", vid.height);
+	fprintf(f, "\t\"ticrate\": %d,\n", TICRATE);
+	fprintf(f, "\t\"numtics\": %s,\n", sizeu1(bench_numtics));
+	fprintf(f, "\t\"numframes\": %s,\n", sizeu1(bench_numframes));
+	fprintf(f, "\t\"units\": \"microseconds\",\n");
+
+	fprintf(f, "\t\"summary\": {\n");
+
+	PS_SummarizeBenchField(FRAMEFIELD(frametime), samples, &summary);
+	PS_WriteBenchSummary(f, "frametime", &summary, false);
+
+	PS_SummarizeBenchField(FRAMEFIELD(rendercall), samples, &summary);
+	PS_WriteBenchSummary(f, "rendertime", &summary, false);
+
+	PS_SummarizeBenchField(TICFIELD(tictime), samples, &summary);
+	PS_WriteBenchSummary(f, "tictime", &summary, false);
+
+	PS_SummarizeBenchField(TICFIELD(thinkers), samples, &summary);
+	PS_WriteBenchSummary(f, "thinkers", &summary, false);
+
+	for (j = 0; j < NUM_THINKERLISTS; j++)
+	{
+		PS_SummarizeBenchField(TICFIELD(thlist[j]), samples, &summary);
+		snprintf(name, sizeof name, "thlist_%s", bench_thlist_names[j]);
+		PS_WriteBenchSummary(f, name, &summary, false);
+	}
+
+	for (i = 0; i < bench_numtics; i++)
+		samples[i] = (double)bench_tics[i].checkposition_calls;
+	PS_SummarizeBenchValues(samples, bench_numtics, &summary);
+	PS_WriteBenchSummary(f, "checkposition_calls", &summary, true);
+
+	fprintf(f, "\t},\n");
+
+	fprintf(f, "\t\"tics\": [\n");
+	for (i = 0; i < bench_numtics; i++)
+	{
+		const ps_benchtic_t *tic = &bench_tics[i];
+
+		fprintf(f, "\t\t{\"tictime\": %.3f, \"playerthink\": %.3f, \"thinkers\": %.3f, \"thlist\": {",
+			PS_BenchMicroseconds(tic->tictime), PS_BenchMicroseconds(tic->playerthink), PS_BenchMicroseconds(tic->thinkers));
+		for (j = 0; j < NUM_THINKERLISTS; j++)
+			fprintf(f, "%s\"%s\": %.3f", j ? ", " : "", bench_thlist_names[j], PS_BenchMicroseconds(tic->thlist[j]));
+		fprintf(f, "}, \"luathinkframe\": %.3f, \"other\": %.3f, \"checkposition_calls\": %d, \"lua_mobjhooks\": %d}%s\n",
+			PS_BenchMicroseconds(tic->luathinkframe), PS_BenchMicroseconds(tic->other),
+			tic->checkposition_calls, tic->lua_mobjhooks, (i + 1 < bench_numtics) ? "," : "");
+	}
+	fprintf(f, "\t],\n");
+
+	fprintf(f, "\t\"frames\": [\n");
+	for (i = 0; i < bench_numframes; i++)
+	{
+		const ps_benchframe_t *frame = &bench_frames[i];
+
+		fprintf(f, "\t\t{\"frametime\": %.3f, \"rendertime\": %.3f, \"bsp\": %.3f, \"spriteclip\": %.3f, \"portals\": %.3f, "
+			"\"planes\": %.3f, \"masked\": %.3f, \"ui\": %.3f, \"finishupdate\": %.3f}%s\n",
+			PS_BenchMicroseconds(frame->frametime), PS_BenchMicroseconds(frame->rendercall),
+			PS_BenchMicroseconds(frame->bsp), PS_BenchMicroseconds(frame->spriteclip),
+			PS_BenchMicroseconds(frame->portals), PS_BenchMicroseconds(frame->planes),
+			PS_BenchMicroseconds(frame->masked), PS_BenchMicroseconds(frame->ui),
+			PS_BenchMicroseconds(frame->swap), (i + 1 < bench_numframes) ? "," : "");
+	}
+	fprintf(f, "\t]\n");
+
+	fprintf(f, "}\n");
+
+	// Echo the headline numbers to the console as well
+	PS_SummarizeBenchField(FRAMEFIELD(frametime), samples, &summary);
+	CONS_Printf("Frame time (us): p50 %.1f, p95 %.1f, p99 %.1f\n", summary.p50, summary.p95, summary.p99);
+
+	PS_SummarizeBenchField(TICFIELD(tictime), samples, &summary);
+	CONS_Printf("Tic time (us):   p50 %.1f, p95 %.1f, p99 %.1f\n", summary.p50, summary.p95, summary.p99);
+
+	free(samples);
+}
+
+#undef TICFIELD
+#undef FRAMEFIELD
+
+// One row per tic and per frame; the columns that don't apply to a row are left empty.
+static void PS_WriteBenchmarkCSV(FILE *f)
+{
+	size_t i;
+	int j;
+
+	fputs("kind,index,frametime,rendertime,bsp,spriteclip,portals,planes,masked,ui,finishupdate,"
+		"tictime,playerthink,thinkers", f);
+	for (j = 0; j < NUM_THINKERLISTS; j++)
+		fprintf(f, ",thlist_%s", bench_thlist_names[j]);
+	fputs(",luathinkframe,other,checkposition_calls,lua_mobjhooks\n", f);
+
+	for (i = 0; i < bench_numframes; i++)
+	{
+		const ps_benchframe_t *frame = &bench_frames[i];
+
+		fprintf(f, "frame,%s,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,,,", sizeu1(i),
+			PS_BenchMicroseconds(frame->frametime), PS_BenchMicroseconds(frame->rendercall),
+			PS_BenchMicroseconds(frame->bsp), PS_BenchMicroseconds(frame->spriteclip),
+			PS_BenchMicroseconds(frame->portals), PS_BenchMicroseconds(frame->planes),
+			PS_BenchMicroseconds(frame->masked), PS_BenchMicroseconds(frame->ui),
+			PS_BenchMicroseconds(frame->swap));
+		for (j = 0; j < NUM_THINKERLISTS; j++)
+			fputc(',', f);
+		fputs(",,,\n", f);
+	}
+
+	for (i = 0; i < bench_numtics; i++)
+	{
+		const ps_benchtic_t *tic = &bench_tics[i];
+
+		fprintf(f, "tic,%s,,,,,,,,,,%.3f,%.3f,%.3f", sizeu1(i),
+			PS_BenchMicroseconds(tic->tictime), PS_BenchMicroseconds(tic->playerthink),
+			PS_BenchMicroseconds(tic->thinkers));
+		for (j = 0; j < NUM_THINKERLISTS; j++)
+			fprintf(f, ",%.3f", PS_BenchMicroseconds(tic->thlist[j]));
+		fprintf(f, ",%.3f,%.3f,%d,%d\n",
+			PS_BenchMicroseconds(tic->luathinkframe), PS_BenchMicroseconds(tic->other),
+			tic->checkposition_calls, tic->lua_mobjhooks);
+	}
+}
+
+// Writes everything recorded since PS_StartBenchmark to path, as CSV
+// if the file name ends in ".csv" and as JSON otherwise.
+boolean PS_StopBenchmark(const char *path, const char *demoname)
+{
+	const size_t len = strlen(path);
+	boolean written = false;
+	FILE *f;
+
+	if (!ps_benchmarking)
+		return false;
+
+	ps_benchmarking = false;
+
+	f = fopen(path, "w");
+	if (f)
+	{
+		if (len >= 4 && !stricmp(path + len - 4, ".csv"))
+			PS_WriteBenchmarkCSV(f);
+		else
+			PS_WriteBenchmarkJSON(f, demoname);
+
+		written = !ferror(f);
+		fclose(f);
+	}
+
+	if (written)
+		CONS_Printf("Benchmark results (%s tics, %s frames) saved to '%s'\n", sizeu1(bench_numtics), sizeu2(bench_numframes), path);
+	else
+		CONS_Alert(CONS_ERROR, "Couldn't write benchmark results to '%s'\n", path);
+
+	Z_Free(bench_tics);
+	Z_Free(bench_frames);
+	bench_tics = NULL;
+	bench_frames = NULL;
+	bench_numtics = bench_maxtics = 0;
+	bench_numframes = bench_maxframes = 0;
+
+	return written;
+}
+
+// ===========================================================================
+//                              TIMELINE TRACES
+// ===========================================================================
+
+// Every closed span becomes one complete ("X") event in a ring buffer.
+// Once the ring is full the oldest spans are overwritten, so a long
+// trace keeps the most recent stretch. Only the main thread writes to
+// the ring, and nothing is written to disk until the trace is stopped.
+
+#define PS_TRACE_EVENTS (1<<18) // must be a power of two
+#define PS_TRACE_DEPTH 64
+#define PS_TRACE_NAMES 512
+
+typedef struct
+{
+	const char *name;
+	precise_t start;
+	precise_t duration;
+	tic_t gametic;
+	UINT8 depth;
+} ps_traceevent_t;
+
+boolean ps_tracing = false;
+
+static ps_traceevent_t *trace_events = NULL;
+static UINT32 trace_head = 0; // total events written since the trace began
+
+static struct
+{
+	const char *name;
+	precise_t start;
+} trace_stack[PS_TRACE_DEPTH];
+static INT32 trace_depth = 0;
+
+static precise_t trace_starttime = 0;
+static char trace_path[256];
+
+// Copies of names that don't live for the whole trace, such as the
+// source file of a Lua hook. Looked up by hash so each is stored once.
+static char *trace_names[PS_TRACE_NAMES];
+
+static const char *PS_TraceInternName(const char *name)
+{
+	UINT32 hash = 5381;
+	const char *c;
+	size_t i, slot;
+
+	for (c = name; *c; c++)
+		hash = hash * 33 + (UINT8)*c;
+
+	for (i = 0; i < PS_TRACE_NAMES; i++)
+	{
+		slot = (hash + i) & (PS_TRACE_NAMES - 1);
+
+		if (!trace_names[slot])
+		{
+			trace_names[slot] = Z_StrDup(name);
+			return trace_names[slot];
+		}
+
+		if (!strcmp(trace_names[slot], name))
+			return trace_names[slot];
+	}
+
+	return "(too many names)";
+}
+
+void PS_TraceBegin(const char *name)
+{
+	if (trace_depth < PS_TRACE_DEPTH)
+	{
+		trace_stack[trace_depth].name = name;
+		trace_stack[trace_depth].start = I_GetPreciseTime();
+	}
+	trace_depth++;
+}
+
+void PS_TraceBeginCopy(const char *name)
+{
+	PS_TraceBegin(PS_TraceInternName(name));
+}
+
+void PS_TraceEnd(void)
+{
+	ps_traceevent_t *event;
+
+	// The trace may have started in the middle of this span
+	if (trace_depth <= 0)
+		return;
+
+	if (--trace_depth >= PS_TRACE_DEPTH)
+		return;
+
+	event = &trace_events[trace_head++ & (PS_TRACE_EVENTS - 1)];
+	event->name = trace_stack[trace_depth].name;
+	event->start = trace_stack[trace_depth].start;
+	event->duration = I_GetPreciseTime() - event->start;
+	event->gametic = gametic;
+	event->depth = (UINT8)trace_depth;
+}
+
+static void PS_WriteTraceJSON(FILE *f, UINT32 first)
+{
+	UINT32 i;
+
+	fputs("{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n", f);
+	fputs("{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, \"args\": {\"name\": \"main\"}}", f);
+
+	for (i = first; i != trace_head; i++)
+	{
+		const ps_traceevent_t *event = &trace_events[i & (PS_TRACE_EVENTS - 1)];
+
+		fputs(",\n{\"name\": ", f);
+		PS_WriteJSONString(f, event->name);
+		fprintf(f, ", \"cat\": \"srb2\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, \"tid\": 1, "
+			"\"args\": {\"gametic\": %u, \"depth\": %u}}",
+			PS_BenchMicroseconds(event->start - trace_starttime), PS_BenchMicroseconds(event->duration),
+			(unsigned)event->gametic, (unsigned)event->depth);
+	}
+
+	fputs("\n]}\n", f);
+}
+
+static void PS_StartTrace(const char *path)
+{
+	if (ps_tracing)
+	{
+		CONS_Printf("Already recording a trace to '%s'\n", trace_path);
+		return;
+	}
+
+	trace_events = malloc(PS_TRACE_EVENTS * sizeof (ps_traceevent_t));
+	if (!trace_events)
+	{
+		CONS_Alert(CONS_ERROR, "Not enough memory to record a trace\n");
+		return;
+	}
+
+	strlcpy(trace_path, path, sizeof trace_path);
+	trace_head = 0;
+	trace_depth = 0;
+	trace_starttime = I_GetPreciseTime();
+	ps_tracing = true;
+
+	CONS_Printf("Recording trace, use 'perftrace stop' to save it to '%s'\n", trace_path);
+}
+
+static void PS_StopTrace(const char *path)
+{
+	UINT32 first = 0, dropped = 0;
+	boolean written = false;
+	FILE *f;
+	size_t i;
+
+	if (!ps_tracing)
+	{
+		CONS_Printf("No trace is being recorded\n");
+		return;
+	}
+
+	ps_tracing = false;
+
+	if (path)
+		strlcpy(trace_path, path, sizeof trace_path);
+
+	if (trace_head > PS_TRACE_EVENTS)
+	{
+		first = trace_head - PS_TRACE_EVENTS;
+		dropped = first;
+	}
+
+	f = fopen(trace_path, "w");
+	if (f)
+	{
+		PS_WriteTraceJSON(f, first);
+		written = !ferror(f);
+		fclose(f);
+	}
+
+	if (written)
+	{
+		CONS_Printf("Trace (%u spans) saved to '%s'\n", (unsigned)(trace_head - first), trace_path);
+		if (dropped)
+			CONS_Printf("The oldest %u spans did not fit and were dropped\n", (unsigned)dropped);
+	}
+	else
+		CONS_Alert(CONS_ERROR, "Couldn't write trace to '%s'\n", trace_path);
+
+	free(trace_events);
+	trace_events = NULL;
+
+	for (i = 0; i < PS_TRACE_NAMES; i++)
+	{
+		Z_Free(trace_names[i]);
+		trace_names[i] = NULL;
+	}
+}
+
+// perftrace start [file], perftrace stop [file]
+void Command_Perftrace_f(void)
+{
+	const char *path = NULL;
+
+	if (COM_Argc() < 2)
+	{
+		CONS_Printf("perftrace start [file]: start recording a timeline of tics and frames\n");
+		CONS_Printf("perftrace stop [file]: stop recording and save it as a Chrome trace\n");
+		if (ps_tracing)
+			CONS_Printf("A trace is being recorded to '%s'\n", trace_path);
+		return;
+	}
+
+	if (COM_Argc() > 2)
+		path = va("%s"PATHSEP"%s", srb2home, COM_Argv(2));
+
+	if (!stricmp(COM_Argv(1), "start"))
+		PS_StartTrace(path ? path : va("%s"PATHSEP"perftrace.json", srb2home));
+	else if (!stricmp(COM_Argv(1), "stop"))
+		PS_StopTrace(path);
+	else
+		CONS_Printf("Unknown perftrace action '%s'\n", COM_Argv(1));
+}
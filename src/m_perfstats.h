@@ -57,4 +57,27 @@ void M_DrawPerfStats(void);
 void PS_PerfStats_OnChange(void);
 void PS_SampleSize_OnChange(void);
 
+// Benchmark recording, used by -benchdemo to dump
+// per-tic and per-frame timings to a file.
+extern boolean ps_benchmarking;
+
+void PS_StartBenchmark(void);
+void PS_ResetBenchmark(void);
+void PS_UpdateBenchmarkFrame(void);
+boolean PS_StopBenchmark(const char *path, const char *demoname);
+
+// Timeline recording for the perftrace command. Spans nest, must be
+// opened and closed on the main thread, and end up as Chrome trace
+// events that chrome://tracing or Perfetto can load.
+extern boolean ps_tracing;
+
+void PS_TraceBegin(const char *name);
+void PS_TraceBeginCopy(const char *name);
+void PS_TraceEnd(void);
+
+#define PS_TRACE_BEGIN(name) do { if (ps_tracing) PS_TraceBegin(name); } while (0)
+#define PS_TRACE_END() do { if (ps_tracing) PS_TraceEnd(); } while (0)
+
+void Command_Perftrace_f(void);
+
 #endif
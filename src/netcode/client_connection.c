@@ -263,6 +263,7 @@ boolean CL_SendJoin(void)
 
 	strncpy(netbuffer->u.clientcfg.names[0], cv_playername.zstring, MAXPLAYERNAME);
 	strncpy(netbuffer->u.clientcfg.names[1], player2name, MAXPLAYERNAME);
+	netbuffer->u.clientcfg.gamestatecodecs = CL_GamestateCodecs();
 
 	return HSendPacket(servernode, true, 0, sizeof (clientconfig_pak));
 }
@@ -109,6 +109,7 @@ static CV_PossibleValue_t resynchattempts_cons_t[] = {{1, "MIN"}, {20, "MAX"}, {
 consvar_t cv_resynchattempts = CVAR_INIT ("resynchattempts", "10", CV_SAVE|CV_NETVAR, resynchattempts_cons_t, NULL);
 
 consvar_t cv_blamecfail = CVAR_INIT ("blamecfail", "Off", CV_SAVE|CV_NETVAR, CV_OnOff, NULL);
+consvar_t cv_deltaresync = CVAR_INIT ("deltaresync", "Off", CV_SAVE, CV_OnOff, NULL);
 
 static CV_PossibleValue_t playbackspeed_cons_t[] = {{1, "MIN"}, {10, "MAX"}, {0, NULL}};
 consvar_t cv_playbackspeed = CVAR_INIT ("playbackspeed", "1", 0, playbackspeed_cons_t, NULL);
@@ -117,6 +118,7 @@ consvar_t cv_dedicatedidletime = CVAR_INIT ("dedicatedidletime", "10", CV_SAVE,
 
 void ResetNode(INT32 node)
 {
+	SV_ClearGamestateReference(node);
 	memset(&netnodes[node], 0, sizeof(*netnodes));
 	netnodes[node].player = -1;
 	netnodes[node].player2 = -1;
@@ -1117,6 +1119,7 @@ static void HandlePacketFromPlayer(SINT8 node)
 		case PT_LOGIN              : PT_Login              (node, netconsole); break;
 		case PT_CLIENTQUIT         : PT_ClientQuit         (node, netconsole); break;
 		case PT_CANRECEIVEGAMESTATE: PT_CanReceiveGamestate(node            ); break;
+		case PT_ASKFULLGAMESTATE   : PT_AskFullGamestate   (node            ); break;
 		case PT_ASKLUAFILE         : PT_AskLuaFile         (node            ); break;
 		case PT_HASLUAFILE         : PT_HasLuaFile         (node            ); break;
 		case PT_RECEIVEDGAMESTATE  : PT_ReceivedGamestate  (node            ); break;
@@ -1226,8 +1229,10 @@ boolean TryRunTics(tic_t realtics)
 				if (update_stats)
 					PS_START_TIMING(ps_tictime);
 
+				PS_TRACE_BEGIN("G_Ticker");
 				G_Ticker((gametic % NEWTICRATERATIO) == 0);
 				ExtraDataTicker();
+				PS_TRACE_END();
 				gametic++;
 				consistancy[gametic%BACKUPTICS] = Consistancy();
 
@@ -1333,6 +1338,8 @@ void NetUpdate(void)
 	if (realtics <= 0) // nothing new to update
 		return;
 
+	PS_TRACE_BEGIN("NetUpdate");
+
 	if (realtics > 5)
 	{
 		if (server)
@@ -1488,6 +1495,11 @@ void NetUpdate(void)
 	}
 
 	FileSendTicker();
+
+	if (I_NetFlush)
+		I_NetFlush(); // Send everything queued during this update
+
+	PS_TRACE_END();
 }
 
 // called one time at init
@@ -54,6 +54,7 @@ typedef struct netnode_s
 	boolean sendingsavegame; // Are we sending the savegame?
 	boolean resendingsavegame; // Are we resending the savegame?
 	tic_t savegameresendcooldown; // How long before we can resend again?
+	UINT8 gamestatecodecs; // Which gamestate codecs the client can decompress
 } netnode_t;
 
 extern netnode_t netnodes[MAXNETNODES];
@@ -37,6 +37,7 @@
 #include "d_clisrv.h"
 #include "server_connection.h"
 #include "net_command.h"
+#include "gamestate.h"
 #include "d_net.h"
 #include "../v_video.h"
 #include "../d_main.h"
@@ -393,6 +394,7 @@ char timedemo_name[256];
 boolean timedemo_csv;
 char timedemo_csv_id[256];
 boolean timedemo_quit;
+char timedemo_benchout[256];
 
 INT16 gametype = GT_COOP;
 UINT32 gametyperules = 0;
@@ -593,6 +595,9 @@ void D_RegisterServerCommands(void)
 	CV_RegisterVar(&cv_joindelay);
 	CV_RegisterVar(&cv_rejointimeout);
 	CV_RegisterVar(&cv_resynchattempts);
+	CV_RegisterVar(&cv_deltaresync);
+	CV_RegisterVar(&cv_gamestatecodec);
+	CV_RegisterVar(&cv_gamestatelevel);
 	CV_RegisterVar(&cv_maxsend);
 	CV_RegisterVar(&cv_noticedownload);
 	CV_RegisterVar(&cv_downloadspeed);
@@ -890,6 +895,7 @@ void D_RegisterClientCommands(void)
 	CV_RegisterVar(&cv_perfstats);
 	CV_RegisterVar(&cv_ps_samplesize);
 	CV_RegisterVar(&cv_ps_descriptor);
+	COM_AddCommand("perftrace", Command_Perftrace_f, 0);
 
 	// ingame object placing
 	COM_AddCommand("objectplace", Command_ObjectPlace_f, COM_LUA);
@@ -1697,7 +1703,7 @@ static void Command_Timedemo_f(void)
 
 	if (COM_Argc() < 2)
 	{
-		CONS_Printf(M_GetText("timedemo <demoname> [-csv [<trialid>]] [-quit]: time a demo\n"));
+		CONS_Printf(M_GetText("timedemo <demoname> [-csv [<trialid>]] [-benchout <file>] [-quit]: time a demo\n"));
 		return;
 	}
 
@@ -1725,6 +1731,13 @@ static void Command_Timedemo_f(void)
 	else
 		timedemo_csv_id[0] = 0;
 
+	// dump per-tic and per-frame timings to a file?
+	i = COM_CheckParm("-benchout");
+	if (i && i + 1 < COM_Argc())
+		strlcpy(timedemo_benchout, COM_Argv(i + 1), sizeof timedemo_benchout);
+	else
+		timedemo_benchout[0] = 0;
+
 	// exit after the timedemo?
 	timedemo_quit = (COM_CheckParm("-quit") > 0);
 
@@ -3294,7 +3307,7 @@ static void Got_RunSOCcmd(UINT8 **cp, INT32 playernum)
 	// Maybe add md5 support?
 	if (strstr(filename, ".soc") != NULL)
 	{
-		ncs = findfile(filename,NULL,true);
+		ncs = findfile(filename,sizeof filename,NULL,true);
 
 		if (ncs != FS_FOUND)
 		{
@@ -3668,7 +3681,7 @@ static void Got_RequestAddfilecmd(UINT8 **cp, INT32 playernum)
 	if (numwadfiles >= MAX_WADFILES)
 		toomany = true;
 	else
-		ncs = findfile(filename,md5sum,true);
+		ncs = findfile(filename,sizeof filename,md5sum,true);
 
 	if (ncs != FS_FOUND || toomany)
 	{
@@ -3768,7 +3781,7 @@ static void Got_Addfilecmd(UINT8 **cp, INT32 playernum)
 		return;
 	}
 
-	ncs = findfile(filename,md5sum,true);
+	ncs = findfile(filename,sizeof filename,md5sum,true);
 
 	if (ncs != FS_FOUND || !P_AddWadFile(filename))
 	{
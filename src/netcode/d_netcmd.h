@@ -118,6 +118,7 @@ extern char timedemo_name[256];
 extern boolean timedemo_csv;
 extern char timedemo_csv_id[256];
 extern boolean timedemo_quit;
+extern char timedemo_benchout[256];
 
 extern consvar_t cv_freedemocamera;
 
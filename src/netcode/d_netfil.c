@@ -67,23 +67,56 @@ typedef struct filetx_s
 	UINT32 size; // Size of the file
 	UINT8 fileid;
 	INT32 node; // Destination
+	FILE *currentfile; // The file currently being sent, NULL until it starts
+	UINT8 iteration;
+	UINT8 ackediteration;
+	UINT32 position; // The current position in the file
+	boolean *ackedfragments;
+	UINT32 *sentseq; // Send number of each fragment's last send, see filesent_t
+	UINT32 ackedsize;
+	tic_t dontsenduntil;
+	UINT32 probefragment; // Fragment timed for the next round trip sample, or UINT32_MAX
+	precise_t probetime;
 	struct filetx_s *next; // Next file in the list
 } filetx_t;
 
+// One send of a fragment, kept until it is acknowledged, sent again or
+// given up for lost, so that each fragment is counted in flight at most once
+typedef struct
+{
+	filetx_t *file; // NULL once it no longer counts
+	UINT32 fragment;
+	UINT32 seq;
+} filesent_t;
+
 // Current transfers (one for each node)
 typedef struct filetran_s
 {
 	filetx_t *txlist; // Linked list of all files for the node
-	UINT8 iteration;
-	UINT8 ackediteration;
-	UINT32 position; // The current position in the file
-	boolean *ackedfragments;
-	UINT32 ackedsize;
-	FILE *currentfile; // The file currently being sent/received
-	tic_t dontsenduntil;
+	UINT8 nextfile; // Which of the files in flight sends next
+
+	// Congestion control, shared by all the files in flight
+	boolean ccstarted;
+	boolean slowstart;
+	fixed_t window; // Fragments allowed in flight
+	fixed_t credit; // Fragments the pacing lets us send right now
+	UINT32 inflight; // Fragments sent and not acknowledged or lost yet
+	filesent_t *sent; // The last FILESENTRING sends, by send number
+	UINT32 sendseq; // Number of the next send
+	UINT32 highestacked; // Latest send acknowledged so far
+	UINT32 lossscan; // Oldest send not checked for loss yet
+	UINT32 recoveryseq; // Losses of sends before this one were already answered
+	UINT32 srtt; // Smoothed round trip time in microseconds, 0 until measured
+	UINT32 basedelay[2]; // Lowest round trip in the current and previous periods
+	tic_t basedelayperiod; // When the current period began
+	precise_t lastpace; // When the credit was last topped up
+	precise_t lastprogress; // When a fragment was last acknowledged
+	precise_t lastack; // When any ack last came in
 } filetran_t;
 static filetran_t transfer[MAXNETNODES];
 
+static void SV_ForgetFileSends(filetran_t *trans, filetx_t *f);
+
 // Read time of file: stat _stmtime
 // Write time of file: utime
 
@@ -93,16 +126,18 @@ fileneeded_t *fileneeded; // List of needed files
 static tic_t lasttimeackpacketsent = 0;
 char downloaddir[512] = "DOWNLOAD";
 
-// For resuming failed downloads
-typedef struct
+// For resuming failed downloads, one for each file that was being
+// downloaded, since several files are sent at once
+typedef struct pauseddownload_s
 {
 	char filename[MAX_WADPATH];
 	UINT8 md5sum[16];
 	boolean *receivedfragments;
 	UINT32 fragmentsize;
 	UINT32 currentsize;
+	struct pauseddownload_s *next;
 } pauseddownload_t;
-static pauseddownload_t *pauseddownload = NULL;
+static pauseddownload_t *pauseddownloads = NULL;
 
 // for cl loading screen
 INT32 lastfilenum = -1;
@@ -122,7 +157,7 @@ consvar_t cv_maxsend = CVAR_INIT ("maxsend", "4096", CV_SAVE|CV_NETVAR, maxsend_
 
 consvar_t cv_noticedownload = CVAR_INIT ("noticedownload", "Off", CV_SAVE|CV_NETVAR, CV_OnOff, NULL);
 
-// Speed of file downloading (in packets per tic)
+// Starting window of file downloads (in packets), adapted to the link from there
 static CV_PossibleValue_t downloadspeed_cons_t[] = {{1, "MIN"}, {300, "MAX"}, {0, NULL}};
 consvar_t cv_downloadspeed = CVAR_INIT ("downloadspeed", "16", CV_SAVE|CV_NETVAR, downloadspeed_cons_t, NULL);
 
@@ -337,27 +372,50 @@ boolean CL_CheckDownloadable(void)
 
 /** Returns true if a needed file transfer can be resumed
   *
+  * \param pauseddownload The paused download with the same name
   * \param file The needed file to resume the transfer for
   * \return True if the transfer can be resumed
   *
   */
-static boolean CL_CanResumeDownload(fileneeded_t *file)
+static boolean CL_CanResumeDownload(pauseddownload_t *pauseddownload, fileneeded_t *file)
 {
-	return pauseddownload
-		&& !strcmp(pauseddownload->filename, file->filename) // Same name
-		&& !memcmp(pauseddownload->md5sum, file->md5sum, 16) // Same checksum
+	return !memcmp(pauseddownload->md5sum, file->md5sum, 16) // Same checksum
 		&& pauseddownload->fragmentsize == file->fragmentsize; // Same fragment size
 }
 
-void CL_AbortDownloadResume(void)
+/** Finds the paused download saved under the same name as a needed file
+  *
+  * \param filename The name of the needed file
+  * \return The link pointing to the paused download, or to NULL if none
+  *
+  */
+static pauseddownload_t **CL_FindPausedDownload(const char *filename)
 {
-	if (!pauseddownload)
-		return;
+	pauseddownload_t **p;
+
+	for (p = &pauseddownloads; *p; p = &(*p)->next)
+		if (!strcmp((*p)->filename, filename))
+			break;
+
+	return p;
+}
+
+static void CL_FreePausedDownload(pauseddownload_t **p, boolean removefile)
+{
+	pauseddownload_t *pauseddownload = *p;
+
+	*p = pauseddownload->next;
 
 	free(pauseddownload->receivedfragments);
-	remove(pauseddownload->filename);
+	if (removefile)
+		remove(pauseddownload->filename);
 	free(pauseddownload);
-	pauseddownload = NULL;
+}
+
+void CL_AbortDownloadResume(void)
+{
+	while (pauseddownloads)
+		CL_FreePausedDownload(&pauseddownloads, true);
 }
 
 /** Sends requests for files in the ::fileneeded table with a status of
@@ -519,13 +577,17 @@ INT32 CL_CheckFiles(void)
 		if (fileneeded[i].folder)
 			fileneeded[i].status = findfolder(fileneeded[i].filename);
 		else
-			fileneeded[i].status = findfile(fileneeded[i].filename, fileneeded[i].md5sum, true);
+			fileneeded[i].status = findfile(fileneeded[i].filename, sizeof(fileneeded[i].filename), fileneeded[i].md5sum, true);
 
 		CONS_Debug(DBG_NETPLAY, "found %d\n", fileneeded[i].status);
 		return 4;
 	}
 
 	//now making it here means we've checked the entire list and no FS_NOTCHECKED files remain
+#ifndef NOMD5
+	saveaddonindex(); // keep whatever the search had to hash
+#endif
+
 	if (numwadfiles+filestoload > MAX_WADFILES)
 		return 3;
 	else if (downloadrequired)
@@ -944,11 +1006,12 @@ boolean AddLuaFileToSendQueue(INT32 node, const char *filename)
   * either because the file has been fully sent or because the node was disconnected
   *
   * \param node The destination
+  * \param p The file request to remove
   *
   */
-static void SV_EndFileSend(INT32 node)
+static void SV_EndFileSend(INT32 node, filetx_t *p)
 {
-	filetx_t *p = transfer[node].txlist;
+	filetx_t **q;
 
 	// Free the file request according to the freemethod
 	// parameter used with AddFileToSendQueue/AddRamToSendQueue
@@ -957,8 +1020,8 @@ static void SV_EndFileSend(INT32 node)
 		case SF_FILE: // It's a file, close it and free its filename
 			if (cv_noticedownload.value)
 				CONS_Printf("Ending file transfer for node %d\n", node);
-			if (transfer[node].currentfile)
-				fclose(transfer[node].currentfile);
+			if (p->currentfile)
+				fclose(p->currentfile);
 			free(p->id.filename);
 			break;
 		case SF_Z_RAM: // It's a memory block allocated with Z_Alloc or the likes, use Z_Free
@@ -971,184 +1034,467 @@ static void SV_EndFileSend(INT32 node)
 	}
 
 	// Remove the file request from the list
-	transfer[node].txlist = p->next;
+	for (q = &transfer[node].txlist; *q != p; q = &(*q)->next)
+		;
+	*q = p->next;
+
+	SV_ForgetFileSends(&transfer[node], p);
+
+	if (p->ackedfragments)
+		free(p->ackedfragments);
+	if (p->sentseq)
+		free(p->sentseq);
 	free(p);
 
-	// Indicate that the transmission is over
-	transfer[node].currentfile = NULL;
-	if (transfer[node].ackedfragments)
-		free(transfer[node].ackedfragments);
-	transfer[node].ackedfragments = NULL;
+	// The next batch of files starts over with a fresh window
+	if (!transfer[node].txlist)
+		transfer[node].ccstarted = false;
 
 	filestosend--;
 }
 
 #define FILEFRAGMENTSIZE (software_MAXPACKETLENGTH - (FILETXHEADER + BASEPACKETSIZE))
 
-/** Handles file transmission
-  *
-  */
-void FileSendTicker(void)
+// Number of files from the front of a node's queue that are sent at once
+#define FILESINFLIGHT 4
+
+// Each node's window grows while round trips stay close to the lowest one
+// seen recently and shrinks once fragments start queueing up on the link,
+// the way LEDBAT does, so downloads yield to game traffic. Fragments are
+// paced over the round trip rather than sent in bursts.
+#define FILETARGETDELAY 50000 // Queueing delay to aim for (microseconds)
+#define FILEMINRTO 250000 // Shortest wait for acks before assuming loss (microseconds)
+#define FILEPROBETIMEOUT 2000000 // Give up on a timed fragment after this (microseconds)
+#define FILEBASEDELAYPERIOD (10*TICRATE)
+#define FILEMINWINDOW 4
+#define FILEMAXWINDOW 4096
+#define FILESENTRING (2*FILEMAXWINDOW) // more than can ever be in flight
+#define FILEREORDER 3 // Later sends acked before a fragment counts as lost
+
+static UINT32 PreciseToMicros(precise_t t)
 {
-	static INT32 currentnode = 0;
-	filetx_pak *p;
-	size_t fragmentsize;
-	filetx_t *f;
-	INT32 packetsent, ram, i, j;
+	UINT64 us = t * 1000000 / I_GetPrecisePrecision();
+	return (UINT32)min(us, UINT32_MAX);
+}
 
-	// If someone is taking too long to download, kick them with a timeout
-	// to prevent blocking the rest of the server...
-	if (luafiletransfers)
-	{
-		for (i = 1; i < MAXNETNODES; i++)
-		{
-			luafiletransfernodestatus_t status = luafiletransfers->nodestatus[i];
+static void SV_ClampFileWindow(filetran_t *trans)
+{
+	if (trans->window < FILEMINWINDOW*FRACUNIT)
+		trans->window = FILEMINWINDOW*FRACUNIT;
+	else if (trans->window > FILEMAXWINDOW*FRACUNIT)
+		trans->window = FILEMAXWINDOW*FRACUNIT;
+}
 
-			if (status != LFTNS_NONE && status != LFTNS_WAITING && status != LFTNS_SENT
-				&& I_GetTime() > luafiletransfers->nodetimeouts[i])
-			{
-				Net_ConnectionTimeout(i);
-			}
-		}
+static void SV_StartFileCongestion(filetran_t *trans)
+{
+	trans->ccstarted = true;
+	trans->slowstart = true;
+	trans->window = cv_downloadspeed.value * FRACUNIT;
+	SV_ClampFileWindow(trans);
+	trans->credit = trans->window;
+	trans->inflight = 0;
+	trans->sendseq = trans->highestacked = trans->lossscan = trans->recoveryseq = 0;
+	if (!trans->sent)
+	{
+		trans->sent = malloc(FILESENTRING * sizeof (*trans->sent));
+		if (!trans->sent)
+			I_Error("SV_StartFileCongestion: No more memory\n");
 	}
+	memset(trans->sent, 0, FILESENTRING * sizeof (*trans->sent));
+	trans->srtt = 0;
+	trans->basedelay[0] = trans->basedelay[1] = UINT32_MAX;
+	trans->basedelayperiod = I_GetTime();
+	trans->lastpace = trans->lastprogress = trans->lastack = I_GetPreciseTime();
+}
 
-	if (!filestosend) // No file to send
+// Stops counting a send in flight, if it still was
+static boolean SV_DropFileSend(filetran_t *trans, filesent_t *sent)
+{
+	if (!sent->file)
+		return false;
+
+	sent->file = NULL;
+	trans->inflight -= min(trans->inflight, 1);
+	return true;
+}
+
+// The last send of this fragment, if it is still counted in flight
+static filesent_t *SV_FindFileSend(filetran_t *trans, filetx_t *f, UINT32 fragment)
+{
+	UINT32 seq = f->sentseq[fragment];
+	filesent_t *sent = &trans->sent[seq % FILESENTRING];
+
+	if (sent->file == f && sent->fragment == fragment && sent->seq == seq)
+		return sent;
+	return NULL;
+}
+
+static void SV_CountFileSend(filetran_t *trans, filetx_t *f, UINT32 fragment)
+{
+	UINT32 seq = trans->sendseq++;
+	filesent_t *sent, *previous;
+
+	// Sending it again means the last send was lost, so it is only counted once
+	previous = SV_FindFileSend(trans, f, fragment);
+	if (previous)
+		SV_DropFileSend(trans, previous);
+
+	// A send this old was lost long ago
+	sent = &trans->sent[seq % FILESENTRING];
+	SV_DropFileSend(trans, sent);
+
+	sent->file = f;
+	sent->fragment = fragment;
+	sent->seq = seq;
+	f->sentseq[fragment] = seq;
+	trans->inflight++;
+}
+
+// Forgets about everything in flight for a file that is going away
+static void SV_ForgetFileSends(filetran_t *trans, filetx_t *f)
+{
+	if (!trans->sent)
 		return;
 
-	packetsent = cv_downloadspeed.value;
+	for (INT32 i = 0; i < FILESENTRING; i++)
+		if (trans->sent[i].file == f)
+			SV_DropFileSend(trans, &trans->sent[i]);
+}
 
-	netbuffer->packettype = PT_FILEFRAGMENT;
+// Forgets about everything in flight, after the acks stopped coming
+static void SV_ForgetAllFileSends(filetran_t *trans)
+{
+	for (INT32 i = 0; i < FILESENTRING; i++)
+		trans->sent[i].file = NULL;
+	trans->inflight = 0;
+	trans->lossscan = trans->sendseq;
+}
+
+static void SV_AddFileRoundTrip(filetran_t *trans, UINT32 rtt)
+{
+	if (!trans->srtt)
+		trans->srtt = max(rtt, 1);
+	else
+		trans->srtt = max(trans->srtt - trans->srtt / 8 + rtt / 8, 1);
+
+	// Routes change, so the base delay only remembers the last two periods
+	if (I_GetTime() - trans->basedelayperiod >= FILEBASEDELAYPERIOD)
+	{
+		trans->basedelay[1] = trans->basedelay[0];
+		trans->basedelay[0] = UINT32_MAX;
+		trans->basedelayperiod = I_GetTime();
+	}
+	trans->basedelay[0] = min(trans->basedelay[0], rtt);
+}
+
+// Counts the fragments sent well before the latest one acknowledged as
+// lost, as their acks would have come in by now. The window is halved
+// for the first of them, and not again for losses of the same window.
+static void SV_DetectFileLosses(filetran_t *trans)
+{
+	boolean lost = false;
+
+	if (trans->sendseq - trans->lossscan > FILESENTRING)
+		trans->lossscan = trans->sendseq - FILESENTRING;
+
+	while ((INT32)(trans->highestacked - trans->lossscan) > FILEREORDER)
+	{
+		filesent_t *sent = &trans->sent[trans->lossscan % FILESENTRING];
+
+		if (sent->seq == trans->lossscan && SV_DropFileSend(trans, sent)
+			&& (INT32)(trans->lossscan - trans->recoveryseq) >= 0)
+			lost = true;
+		trans->lossscan++;
+	}
+
+	if (lost)
+	{
+		trans->window /= 2;
+		SV_ClampFileWindow(trans);
+		trans->slowstart = false;
+		trans->recoveryseq = trans->sendseq;
+	}
+}
+
+static void SV_FileFragmentsAcked(filetran_t *trans, UINT32 count)
+{
+	UINT32 base, queueing;
+	fixed_t offtarget;
+
+	SV_DetectFileLosses(trans);
+	trans->lastprogress = I_GetPreciseTime();
+
+	base = min(trans->basedelay[0], trans->basedelay[1]);
+	queueing = (trans->srtt > base) ? trans->srtt - base : 0;
 
-	// (((sendbytes-nowsentbyte)*TICRATE)/(I_GetTime()-starttime)<(UINT32)net_bandwidth)
-	while (packetsent-- && filestosend != 0)
+	if (trans->slowstart)
 	{
-		for (i = currentnode, j = 0; j < MAXNETNODES;
-			i = (i+1) % MAXNETNODES, j++)
+		// Double every round trip until the link starts to queue
+		if (!trans->srtt || queueing < FILETARGETDELAY / 2)
 		{
-			if (transfer[i].txlist)
-				break;
+			trans->window += count * FRACUNIT;
+			SV_ClampFileWindow(trans);
+			return;
 		}
-		// no transfer to do
-		if (j >= MAXNETNODES)
-			I_Error("filestosend=%d but no file to send found\n", filestosend);
+		trans->slowstart = false;
+	}
 
-		currentnode = (i+1) % MAXNETNODES;
-		f = transfer[i].txlist;
-		ram = f->ram;
+	// At most one fragment per round trip either way
+	offtarget = (fixed_t)(((INT64)FILETARGETDELAY - queueing) * FRACUNIT / FILETARGETDELAY);
+	if (offtarget < -FRACUNIT)
+		offtarget = -FRACUNIT;
+	trans->window += (fixed_t)((INT64)offtarget * count * FRACUNIT / trans->window);
+	SV_ClampFileWindow(trans);
+}
 
-		// Open the file if it isn't open yet, or
-		if (!transfer[i].currentfile)
+/** Opens a file request and sets up its progress
+  *
+  * \param f The file request
+  *
+  */
+static void SV_StartFileSend(filetx_t *f)
+{
+	if (!f->ram) // Sending a file
+	{
+		long filesize;
+
+		f->currentfile = fopen(f->id.filename, "rb");
+
+		if (!f->currentfile)
+			I_Error("File %s does not exist",
+				f->id.filename);
+
+		fseek(f->currentfile, 0, SEEK_END);
+		filesize = ftell(f->currentfile);
+
+		// Nobody wants to transfer a file bigger
+		// than 4GB!
+		if (filesize >= LONG_MAX)
+			I_Error("filesize of %s is too large", f->id.filename);
+		if (filesize == -1)
+			I_Error("Error getting filesize of %s", f->id.filename);
+
+		f->size = (UINT32)filesize;
+		fseek(f->currentfile, 0, SEEK_SET);
+	}
+	else // Sending RAM
+		f->currentfile = (FILE *)1; // Set currentfile to a non-null value to indicate that it is open
+
+	f->iteration = 1;
+	f->ackediteration = 0;
+	f->position = 0;
+	f->ackedsize = 0;
+
+	f->ackedfragments = calloc(f->size / FILEFRAGMENTSIZE + 1, sizeof(*f->ackedfragments));
+	f->sentseq = calloc(f->size / FILEFRAGMENTSIZE + 1, sizeof(*f->sentseq));
+	if (!f->ackedfragments || !f->sentseq)
+		I_Error("FileSendTicker: No more memory\n");
+
+	f->dontsenduntil = 0;
+	f->probefragment = UINT32_MAX;
+}
+
+/** Sends the next fragment of a file that hasn't been acknowledged yet
+  *
+  * \param node The destination
+  * \param f The file request
+  * \return True if the packet was sent
+  *
+  */
+static boolean SV_SendFileFragment(INT32 node, filetx_t *f)
+{
+	filetx_pak *p = &netbuffer->u.filetxpak;
+	size_t fragmentsize;
+	UINT32 fragment;
+
+	// Find the first non-acknowledged fragment
+	while (f->ackedfragments[f->position / FILEFRAGMENTSIZE])
+	{
+		f->position += FILEFRAGMENTSIZE;
+		if (f->position >= f->size)
 		{
-			if (!ram) // Sending a file
-			{
-				long filesize;
+			if (f->ackediteration < f->iteration)
+				f->dontsenduntil = I_GetTime() + TICRATE / 2;
 
-				transfer[i].currentfile =
-					fopen(f->id.filename, "rb");
+			f->position = 0;
+			f->iteration++;
+			f->probefragment = UINT32_MAX; // Could time a resend
+		}
+	}
 
-				if (!transfer[i].currentfile)
-					I_Error("File %s does not exist",
-						f->id.filename);
+	// Build a packet containing a file fragment
+	fragmentsize = FILEFRAGMENTSIZE;
+	if (f->size-f->position < fragmentsize)
+		fragmentsize = f->size-f->position;
+	if (f->ram)
+		M_Memcpy(p->data, &f->id.ram[f->position], fragmentsize);
+	else
+	{
+		fseek(f->currentfile, f->position, SEEK_SET);
 
-				fseek(transfer[i].currentfile, 0, SEEK_END);
-				filesize = ftell(transfer[i].currentfile);
+		if (fread(p->data, 1, fragmentsize, f->currentfile) != fragmentsize)
+			I_Error("FileSendTicker: can't read %s byte on %s at %d because %s", sizeu1(fragmentsize), f->id.filename, f->position, M_FileError(f->currentfile));
+	}
+	netbuffer->packettype = PT_FILEFRAGMENT;
+	p->iteration = f->iteration;
+	p->position = LONG(f->position);
+	p->fileid = f->fileid;
+	p->filesize = LONG(f->size);
+	p->size = SHORT((UINT16)FILEFRAGMENTSIZE);
 
-				// Nobody wants to transfer a file bigger
-				// than 4GB!
-				if (filesize >= LONG_MAX)
-					I_Error("filesize of %s is too large", f->id.filename);
-				if (filesize == -1)
-					I_Error("Error getting filesize of %s", f->id.filename);
+	// Send the packet
+	if (!HSendPacket(node, false, 0, FILETXHEADER + fragmentsize)) // Don't use the default acknowledgement system
+		return false; // Not sent for some odd reason, retry at next call
 
-				f->size = (UINT32)filesize;
-				fseek(transfer[i].currentfile, 0, SEEK_SET);
-			}
-			else // Sending RAM
-				transfer[i].currentfile = (FILE *)1; // Set currentfile to a non-null value to indicate that it is open
+	fragment = f->position / FILEFRAGMENTSIZE;
+	SV_CountFileSend(&transfer[node], f, fragment);
 
-			transfer[i].iteration = 1;
-			transfer[i].ackediteration = 0;
-			transfer[i].position = 0;
-			transfer[i].ackedsize = 0;
+	// Time the first send of a fragment when nothing else is being timed
+	if (f->probefragment == UINT32_MAX && f->iteration == 1)
+	{
+		f->probefragment = fragment;
+		f->probetime = I_GetPreciseTime();
+	}
+	else if (f->probefragment != UINT32_MAX
+		&& PreciseToMicros(I_GetPreciseTime() - f->probetime) > FILEPROBETIMEOUT)
+		f->probefragment = UINT32_MAX; // Lost, pick another one next time
 
-			transfer[i].ackedfragments = calloc(f->size / FILEFRAGMENTSIZE + 1, sizeof(*transfer[i].ackedfragments));
-			if (!transfer[i].ackedfragments)
-				I_Error("FileSendTicker: No more memory\n");
+	f->position = (UINT32)(f->position + fragmentsize);
+	if (f->position >= f->size)
+	{
+		if (f->ackediteration < f->iteration)
+			f->dontsenduntil = I_GetTime() + TICRATE / 2;
+
+		f->position = 0;
+		f->iteration++;
+		f->probefragment = UINT32_MAX;
+	}
+	return true;
+}
+
+/** Sends as many fragments to a node as its window and pacing allow,
+  * taking turns between the files in flight
+  *
+  * \param node The destination
+  *
+  */
+static void SV_SendFilesToNode(INT32 node)
+{
+	filetran_t *trans = &transfer[node];
+	filetx_t *inflight[FILESINFLIGHT];
+	INT32 numinflight = 0, budget, idle;
+	precise_t now = I_GetPreciseTime();
+	UINT32 rto, tick;
 
-			transfer[i].dontsenduntil = 0;
+	for (filetx_t *f = trans->txlist; f && numinflight < FILESINFLIGHT; f = f->next)
+	{
+		if (!f->currentfile)
+			SV_StartFileSend(f);
+		inflight[numinflight++] = f;
+	}
+
+	if (!trans->ccstarted)
+		SV_StartFileCongestion(trans);
+
+	// Nothing acknowledged for too long, so whatever is in flight was lost.
+	// Only back off if the acks themselves stopped; if they still come in,
+	// the link is up and the sends they don't mention just have to go again.
+	rto = max(2 * trans->srtt, FILEMINRTO);
+	if (trans->inflight && PreciseToMicros(now - trans->lastprogress) > rto)
+	{
+		if (PreciseToMicros(now - trans->lastack) > rto)
+		{
+			trans->window /= 2;
+			SV_ClampFileWindow(trans);
+			trans->slowstart = false;
 		}
+		SV_ForgetAllFileSends(trans);
+		trans->lastprogress = now;
+	}
+
+	// Spread a window's worth of fragments over each round trip,
+	// or send it all at once while the round trip is unknown or tiny
+	tick = 1000000 / TICRATE;
+	trans->credit += (fixed_t)((INT64)trans->window * PreciseToMicros(now - trans->lastpace)
+		/ max(trans->srtt, tick));
+	trans->credit = min(trans->credit, trans->window);
+	trans->lastpace = now;
+
+	budget = trans->credit / FRACUNIT;
+	if ((UINT32)(trans->window / FRACUNIT) <= trans->inflight)
+		return;
+	budget = min(budget, (INT32)(trans->window / FRACUNIT - trans->inflight));
+
+	for (idle = 0; budget > 0 && idle < numinflight;)
+	{
+		filetx_t *f = inflight[trans->nextfile++ % numinflight];
 
 		// If the client hasn't acknowledged any fragment from the previous iteration,
 		// it is most likely because their acks haven't had enough time to reach the server
 		// yet, due to latency. In that case, we wait a little to avoid useless resend.
-		if (I_GetTime() < transfer[i].dontsenduntil)
+		if (I_GetTime() < f->dontsenduntil)
+		{
+			idle++;
 			continue;
+		}
 
-		// Find the first non-acknowledged fragment
-		while (transfer[i].ackedfragments[transfer[i].position / FILEFRAGMENTSIZE])
-		{
-			transfer[i].position += FILEFRAGMENTSIZE;
-			if (transfer[i].position >= f->size)
-			{
-				if (transfer[i].ackediteration < transfer[i].iteration)
-					transfer[i].dontsenduntil = I_GetTime() + TICRATE / 2;
+		if (!SV_SendFileFragment(node, f))
+			break; // can't send this one so why should i send the next?
 
-				transfer[i].position = 0;
-				transfer[i].iteration++;
-			}
-		}
+		idle = 0;
+		budget--;
+		trans->credit -= FRACUNIT;
+	}
+}
 
-		// Build a packet containing a file fragment
-		p = &netbuffer->u.filetxpak;
-		fragmentsize = FILEFRAGMENTSIZE;
-		if (f->size-transfer[i].position < fragmentsize)
-			fragmentsize = f->size-transfer[i].position;
-		if (ram)
-			M_Memcpy(p->data, &f->id.ram[transfer[i].position], fragmentsize);
-		else
+/** Handles file transmission
+  *
+  */
+void FileSendTicker(void)
+{
+	INT32 i;
+
+	// If someone is taking too long to download, kick them with a timeout
+	// to prevent blocking the rest of the server...
+	if (luafiletransfers)
+	{
+		for (i = 1; i < MAXNETNODES; i++)
 		{
-			fseek(transfer[i].currentfile, transfer[i].position, SEEK_SET);
+			luafiletransfernodestatus_t status = luafiletransfers->nodestatus[i];
 
-			if (fread(p->data, 1, fragmentsize, transfer[i].currentfile) != fragmentsize)
-				I_Error("FileSendTicker: can't read %s byte on %s at %d because %s", sizeu1(fragmentsize), f->id.filename, transfer[i].position, M_FileError(transfer[i].currentfile));
-		}
-		p->iteration = transfer[i].iteration;
-		p->position = LONG(transfer[i].position);
-		p->fileid = f->fileid;
-		p->filesize = LONG(f->size);
-		p->size = SHORT((UINT16)FILEFRAGMENTSIZE);
-
-		// Send the packet
-		if (HSendPacket(i, false, 0, FILETXHEADER + fragmentsize)) // Don't use the default acknowledgement system
-		{ // Success
-			transfer[i].position = (UINT32)(transfer[i].position + fragmentsize);
-			if (transfer[i].position >= f->size)
+			if (status != LFTNS_NONE && status != LFTNS_WAITING && status != LFTNS_SENT
+				&& I_GetTime() > luafiletransfers->nodetimeouts[i])
 			{
-				if (transfer[i].ackediteration < transfer[i].iteration)
-					transfer[i].dontsenduntil = I_GetTime() + TICRATE / 2;
-
-				transfer[i].position = 0;
-				transfer[i].iteration++;
+				Net_ConnectionTimeout(i);
 			}
 		}
-		else
-		{ // Not sent for some odd reason, retry at next call
-			// Exit the while (can't send this one so why should i send the next?)
-			break;
-		}
 	}
+
+	if (!filestosend) // No file to send
+		return;
+
+	for (i = 0; i < MAXNETNODES; i++)
+		if (transfer[i].txlist)
+			SV_SendFilesToNode(i);
 }
 
 void PT_FileAck(SINT8 node)
 {
 	fileack_pak *packet = &netbuffer->u.fileack;
 	filetran_t *trans = &transfer[node];
+	filetx_t *f = trans->txlist;
+	UINT32 newlyacked = 0;
 
 	if (client)
 		return;
 
+	// Find the file in flight this is about
+	for (INT32 n = 0; f && n < FILESINFLIGHT; f = f->next, n++)
+		if (f->currentfile && f->fileid == packet->fileid)
+			break;
+
 	// Wrong file id? Ignore it, it's probably a late packet
-	if (!(trans->txlist && packet->fileid == trans->txlist->fileid))
+	if (!(f && f->currentfile && f->fileid == packet->fileid))
 		return;
 
 	if (packet->numsegments * sizeof(*packet->segments) != doomcom->datalength - BASEPACKETSIZE - sizeof(*packet))
@@ -1157,11 +1503,13 @@ void PT_FileAck(SINT8 node)
 		return;
 	}
 
-	if (packet->iteration > trans->ackediteration)
+	trans->lastack = I_GetPreciseTime();
+
+	if (packet->iteration > f->ackediteration)
 	{
-		trans->ackediteration = packet->iteration;
-		if (trans->ackediteration >= trans->iteration - 1)
-			trans->dontsenduntil = 0;
+		f->ackediteration = packet->iteration;
+		if (f->ackediteration >= f->iteration - 1)
+			f->dontsenduntil = 0;
 	}
 
 	for (INT32 i = 0; i < packet->numsegments; i++)
@@ -1171,34 +1519,63 @@ void PT_FileAck(SINT8 node)
 		for (INT32 j = 0; j < 32; j++)
 			if (LONG(segment->acks) & (1 << j))
 			{
-				if (LONG(segment->start) * FILEFRAGMENTSIZE >= trans->txlist->size)
+				UINT32 fragment = LONG(segment->start) + j;
+
+				if ((UINT64)fragment * FILEFRAGMENTSIZE >= f->size)
 				{
 					Net_CloseConnection(node);
 					return;
 				}
 
-				if (!trans->ackedfragments[LONG(segment->start) + j])
+				if (!f->ackedfragments[fragment])
 				{
-					trans->ackedfragments[LONG(segment->start) + j] = true;
-					trans->ackedsize += FILEFRAGMENTSIZE;
+					filesent_t *sent = SV_FindFileSend(trans, f, fragment);
+
+					if (sent)
+					{
+						if ((INT32)(sent->seq - trans->highestacked) > 0)
+							trans->highestacked = sent->seq;
+						SV_DropFileSend(trans, sent);
+					}
+
+					f->ackedfragments[fragment] = true;
+					f->ackedsize += FILEFRAGMENTSIZE;
+					newlyacked++;
+
+					if (fragment == f->probefragment)
+					{
+						SV_AddFileRoundTrip(trans, PreciseToMicros(I_GetPreciseTime() - f->probetime));
+						f->probefragment = UINT32_MAX;
+					}
 
 					// If the last missing fragment was acked, finish!
-					if (trans->ackedsize == trans->txlist->size)
+					if (f->ackedsize == f->size)
 					{
-						SV_EndFileSend(node);
+						SV_FileFragmentsAcked(trans, newlyacked);
+						SV_EndFileSend(node, f);
 						return;
 					}
 				}
 			}
 	}
+
+	if (newlyacked)
+		SV_FileFragmentsAcked(trans, newlyacked);
 }
 
 void PT_FileReceived(SINT8 node)
 {
-	filetx_t *trans = transfer[node].txlist;
+	filetx_t *trans;
+
+	if (!server)
+		return;
 
-	if (server && trans && netbuffer->u.filereceived == trans->fileid)
-		SV_EndFileSend(node);
+	for (trans = transfer[node].txlist; trans; trans = trans->next)
+		if (netbuffer->u.filereceived == trans->fileid)
+		{
+			SV_EndFileSend(node, trans);
+			break;
+		}
 }
 
 static void SendAckPacket(fileack_pak *packet, UINT8 fileid)
@@ -1345,7 +1722,13 @@ void PT_FileFragment(SINT8 node, INT32 netconsole)
 		if (!file->ackpacket)
 			I_Error("FileSendTicker: No more memory\n");
 
-		if (CL_CanResumeDownload(file))
+		pauseddownload_t **resume = CL_FindPausedDownload(filename);
+
+		// Another file was paused under this name, it can't be resumed
+		if (*resume && !CL_CanResumeDownload(*resume, file))
+			CL_FreePausedDownload(resume, true);
+
+		if (*resume)
 		{
 			file->file = fopen(filename, "r+b");
 			if (!file->file)
@@ -1353,17 +1736,15 @@ void PT_FileFragment(SINT8 node, INT32 netconsole)
 			CONS_Printf("\r%s...\n", filename);
 
 			CONS_Printf("Resuming download...\n");
-			file->currentsize = pauseddownload->currentsize;
-			file->receivedfragments = pauseddownload->receivedfragments;
+			file->currentsize = (*resume)->currentsize;
+			file->receivedfragments = (*resume)->receivedfragments;
 			file->ackresendposition = 0;
 
-			free(pauseddownload);
-			pauseddownload = NULL;
+			(*resume)->receivedfragments = NULL;
+			CL_FreePausedDownload(resume, false);
 		}
 		else
 		{
-			CL_AbortDownloadResume();
-
 			file->file = fopen(filename, "wb");
 			if (!file->file)
 				I_Error("Can't create file %s: %s", filename, strerror(errno));
@@ -1481,7 +1862,7 @@ boolean SendingFile(INT32 node)
 void SV_AbortSendFiles(INT32 node)
 {
 	while (transfer[node].txlist)
-		SV_EndFileSend(node);
+		SV_EndFileSend(node, transfer[node].txlist);
 }
 
 void CloseNetFile(void)
@@ -1499,8 +1880,15 @@ void CloseNetFile(void)
 				fclose(fileneeded[i].file);
 				free(fileneeded[i].ackpacket);
 
-				if (!pauseddownload && (fileneeded[i].type == FILENEEDED_WAD || i != 0)) // 0 is the gamestate...
+				if (fileneeded[i].type == FILENEEDED_WAD || i != 0) // 0 is the gamestate...
 				{
+					pauseddownload_t **resume = CL_FindPausedDownload(fileneeded[i].filename);
+					pauseddownload_t *pauseddownload;
+
+					// Anything paused under this name was overwritten by now
+					if (*resume)
+						CL_FreePausedDownload(resume, false);
+
 					// Don't remove the file, save it for later in case we resume the download
 					pauseddownload = malloc(sizeof(*pauseddownload));
 					if (!pauseddownload)
@@ -1511,6 +1899,8 @@ void CloseNetFile(void)
 					pauseddownload->currentsize = fileneeded[i].currentsize;
 					pauseddownload->receivedfragments = fileneeded[i].receivedfragments;
 					pauseddownload->fragmentsize = fileneeded[i].fragmentsize;
+					pauseddownload->next = pauseddownloads;
+					pauseddownloads = pauseddownload;
 				}
 				else
 				{
@@ -1527,14 +1917,18 @@ void CloseNetFile(void)
 void Command_Downloads_f(void)
 {
 	for (INT32 node = 0; node < MAXNETNODES; node++)
-		if (transfer[node].txlist
-		&& transfer[node].txlist->ram == SF_FILE) // Node is downloading a file?
+		for (filetx_t *f = transfer[node].txlist; f && f->currentfile; f = f->next)
 		{
-			const char *name = transfer[node].txlist->id.filename;
-			UINT32 position = transfer[node].ackedsize;
-			UINT32 size = transfer[node].txlist->size;
+			const char *name;
+			UINT32 position = f->ackedsize;
+			UINT32 size = f->size;
 			char ratecolor;
 
+			if (f->ram != SF_FILE) // Node is downloading a file?
+				continue;
+
+			name = f->id.filename;
+
 			// Avoid division by zero errors
 			if (!size)
 				size = 1;
@@ -1590,23 +1984,261 @@ size_t nameonlylength(const char *s)
 #define O_BINARY 0
 #endif
 
+#ifndef NOMD5
+// Addon index
+// Remembers the MD5 of every file hashed, along with its size and
+// modification time, in srb2home so unchanged files are never hashed
+// twice, even across runs. Looking entries up by MD5 also lets a file
+// be used for a download under whatever name it was saved with.
+#define ADDONINDEXFILE "addonindex.txt"
+#define ADDONINDEXHASHSIZE 1024
+
+typedef struct addonindexentry_s
+{
+	char *path;
+	UINT64 size;
+	INT64 mtime;
+	UINT8 md5sum[16];
+	struct addonindexentry_s *nextbypath;
+	struct addonindexentry_s *nextbymd5;
+} addonindexentry_t;
+
+static addonindexentry_t *addonindexbypath[ADDONINDEXHASHSIZE];
+static addonindexentry_t *addonindexbymd5[ADDONINDEXHASHSIZE];
+static boolean addonindexloaded = false;
+static boolean addonindexdirty = false;
+
+static UINT32 hashaddonpath(const char *path)
+{
+	UINT32 hash = 2166136261u;
+	while (*path)
+		hash = (hash ^ (UINT8)*path++) * 16777619u;
+	return hash % ADDONINDEXHASHSIZE;
+}
+
+static UINT32 hashaddonmd5(const UINT8 *md5sum)
+{
+	return (md5sum[0] | (md5sum[1] << 8)) % ADDONINDEXHASHSIZE;
+}
+
+static boolean statfile(const char *path, UINT64 *size, INT64 *mtime)
+{
+	struct stat st;
+
+	if (stat(path, &st) != 0)
+		return false;
+
+	*size = (UINT64)st.st_size;
+	*mtime = (INT64)st.st_mtime;
+	return true;
+}
+
+static void addtoaddonindex(const char *path, UINT64 size, INT64 mtime, const UINT8 *md5sum)
+{
+	UINT32 hash = hashaddonpath(path);
+	addonindexentry_t *entry, **q;
+
+	for (entry = addonindexbypath[hash]; entry; entry = entry->nextbypath)
+		if (!strcmp(entry->path, path))
+			break;
+
+	if (entry)
+	{
+		// Changed since it was indexed, so unlink it from its old MD5
+		for (q = &addonindexbymd5[hashaddonmd5(entry->md5sum)]; *q != entry; q = &(*q)->nextbymd5)
+			;
+		*q = entry->nextbymd5;
+	}
+	else
+	{
+		entry = malloc(sizeof(*entry));
+		if (!entry)
+			I_Error("addtoaddonindex: No more memory\n");
+		entry->path = strdup(path);
+		if (!entry->path)
+			I_Error("addtoaddonindex: No more memory\n");
+		entry->nextbypath = addonindexbypath[hash];
+		addonindexbypath[hash] = entry;
+	}
+
+	entry->size = size;
+	entry->mtime = mtime;
+	memcpy(entry->md5sum, md5sum, 16);
+
+	hash = hashaddonmd5(md5sum);
+	entry->nextbymd5 = addonindexbymd5[hash];
+	addonindexbymd5[hash] = entry;
+}
+
+/** Writes the addon index out if anything was added to it
+  *
+  */
+void saveaddonindex(void)
+{
+	FILE *f;
+
+	if (!addonindexdirty)
+		return;
+
+	f = fopen(va("%s"PATHSEP"%s", srb2home, ADDONINDEXFILE), "w");
+	if (!f)
+	{
+		CONS_Alert(CONS_WARNING, M_GetText("Couldn't save the addon index: %s\n"), strerror(errno));
+		return;
+	}
+
+	for (INT32 i = 0; i < ADDONINDEXHASHSIZE; i++)
+		for (addonindexentry_t *entry = addonindexbypath[i]; entry; entry = entry->nextbypath)
+		{
+			UINT64 size;
+			INT64 mtime;
+
+			// Forget files that were deleted or changed since
+			if (!statfile(entry->path, &size, &mtime) || size != entry->size || mtime != entry->mtime)
+				continue;
+
+			for (INT32 j = 0; j < 16; j++)
+				fprintf(f, "%02x", entry->md5sum[j]);
+			fprintf(f, " %llu %lld %s\n", (unsigned long long)entry->size, (long long)entry->mtime, entry->path);
+		}
+
+	fclose(f);
+	addonindexdirty = false;
+}
+
+static void loadaddonindex(void)
+{
+	char line[64 + MAX_WADPATH];
+	FILE *f;
+
+	addonindexloaded = true;
+	I_AddExitFunc(saveaddonindex);
+
+	f = fopen(va("%s"PATHSEP"%s", srb2home, ADDONINDEXFILE), "r");
+	if (!f)
+		return;
+
+	while (fgets(line, sizeof line, f))
+	{
+		UINT8 md5sum[16];
+		char *p = line, *end;
+		unsigned long long size;
+		long long mtime;
+		INT32 i;
+
+		for (i = 0; i < 16; i++, p += 2)
+		{
+			unsigned int byte;
+			if (sscanf(p, "%2x", &byte) != 1)
+				break;
+			md5sum[i] = (UINT8)byte;
+		}
+		if (i < 16)
+			continue;
+
+		size = strtoull(p, &end, 10);
+		if (end == p)
+			continue;
+		p = end;
+		mtime = strtoll(p, &end, 10);
+		if (end == p || *end != ' ')
+			continue;
+		p = end + 1;
+
+		p[strcspn(p, "\r\n")] = '\0';
+		if (*p)
+			addtoaddonindex(p, size, mtime, md5sum);
+	}
+
+	fclose(f);
+}
+
+/** Gets the MD5 of a file, from the addon index if it hasn't changed
+  * since it was last hashed
+  *
+  * \param filename The file to hash
+  * \param md5sum Where to put the MD5
+  * \return False if the file couldn't be read
+  *
+  */
+boolean getfilemd5(const char *filename, UINT8 *md5sum)
+{
+	FILE *fhandle;
+	UINT64 size;
+	INT64 mtime;
+	boolean known;
+
+	if (!addonindexloaded)
+		loadaddonindex();
+
+	known = statfile(filename, &size, &mtime);
+	if (known)
+	{
+		for (addonindexentry_t *entry = addonindexbypath[hashaddonpath(filename)]; entry; entry = entry->nextbypath)
+			if (!strcmp(entry->path, filename))
+			{
+				if (entry->size == size && entry->mtime == mtime)
+				{
+					memcpy(md5sum, entry->md5sum, 16);
+					return true;
+				}
+				break;
+			}
+	}
+
+	fhandle = fopen(filename, "rb");
+	if (!fhandle)
+		return false;
+
+	if (md5_stream(fhandle, md5sum) == 1)
+	{
+		fclose(fhandle);
+		return false;
+	}
+	fclose(fhandle);
+
+	if (known)
+	{
+		addtoaddonindex(filename, size, mtime, md5sum);
+		addonindexdirty = true;
+	}
+	return true;
+}
+
+// Finds an indexed file with this MD5 that is still the same on disk
+static const char *findfilebymd5(const UINT8 *md5sum)
+{
+	if (!addonindexloaded)
+		loadaddonindex();
+
+	for (addonindexentry_t *entry = addonindexbymd5[hashaddonmd5(md5sum)]; entry; entry = entry->nextbymd5)
+	{
+		UINT64 size;
+		INT64 mtime;
+
+		if (!memcmp(entry->md5sum, md5sum, 16)
+			&& statfile(entry->path, &size, &mtime)
+			&& size == entry->size && mtime == entry->mtime)
+			return entry->path;
+	}
+
+	return NULL;
+}
+#endif
+
 filestatus_t checkfilemd5(char *filename, const UINT8 *wantedmd5sum)
 {
 #if defined (NOMD5)
 	(void)wantedmd5sum;
 	(void)filename;
 #else
-	FILE *fhandle;
 	UINT8 md5sum[16];
 
 	if (!wantedmd5sum)
 		return FS_FOUND;
 
-	fhandle = fopen(filename, "rb");
-	if (fhandle)
+	if (getfilemd5(filename, md5sum))
 	{
-		md5_stream(fhandle,md5sum);
-		fclose(fhandle);
 		if (!memcmp(wantedmd5sum, md5sum, 16))
 			return FS_FOUND;
 		return FS_MD5SUMBAD;
@@ -1620,7 +2252,7 @@ filestatus_t checkfilemd5(char *filename, const UINT8 *wantedmd5sum)
 // Rewritten by Monster Iestyn to be less stupid
 // Note: if completepath is true, "filename" is modified, but only if FS_FOUND is going to be returned
 // (Don't worry about WinCE's version of filesearch, nobody cares about that OS anymore)
-filestatus_t findfile(char *filename, const UINT8 *wantedmd5sum, boolean completepath)
+static filestatus_t searchfile(char *filename, const UINT8 *wantedmd5sum, boolean completepath)
 {
 	filestatus_t homecheck; // store result of last file search
 	boolean badmd5 = false; // store whether md5 was bad from either of the first two searches (if nothing was found in the third)
@@ -1652,6 +2284,27 @@ filestatus_t findfile(char *filename, const UINT8 *wantedmd5sum, boolean complet
 	return (badmd5 ? FS_MD5SUMBAD : FS_NOTFOUND); // md5 sum bad or file not found
 }
 
+filestatus_t findfile(char *filename, size_t filenamesize, const UINT8 *wantedmd5sum, boolean completepath)
+{
+#ifdef NOMD5
+	(void)filenamesize;
+#else
+	// A file we already know has these contents will do, whatever its name,
+	// as long as its path fits where the caller wants it
+	if (wantedmd5sum && completepath)
+	{
+		const char *known = findfilebymd5(wantedmd5sum);
+		if (known && strlen(known) < filenamesize)
+		{
+			strcpy(filename, known);
+			return FS_FOUND;
+		}
+	}
+#endif
+
+	return searchfile(filename, wantedmd5sum, completepath);
+}
+
 // Searches for a folder.
 // This can be used with a full path, or an incomplete path.
 // In the latter case, the function will try to find folders in
@@ -149,10 +149,16 @@ void Command_Downloads_f(void);
 boolean fileexist(char *filename, time_t ptime);
 
 // Search a file in the wadpath, return FS_FOUND when found
-filestatus_t findfile(char *filename, const UINT8 *wantedmd5sum,
+filestatus_t findfile(char *filename, size_t filenamesize, const UINT8 *wantedmd5sum,
 	boolean completepath);
 filestatus_t checkfilemd5(char *filename, const UINT8 *wantedmd5sum);
 
+#ifndef NOMD5
+// MD5 of a file, taken from the addon index when the file hasn't changed
+boolean getfilemd5(const char *filename, UINT8 *md5sum);
+void saveaddonindex(void);
+#endif
+
 // Searches for a folder
 filestatus_t findfolder(const char *path);
 
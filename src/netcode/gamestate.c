@@ -25,6 +25,7 @@
 #include "../f_finale.h"
 #include "../g_demo.h"
 #include "../g_game.h"
+#include "../i_system.h"
 #include "../i_time.h"
 #include "../lua_script.h"
 #include "../lzf.h"
@@ -37,12 +38,342 @@
 #if defined (__GNUC__) || defined (__unix__)
 #include <unistd.h>
 #endif
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
 
 #define SAVEGAMESIZE (768*1024)
 
+// The leading word of a sent gamestate holds its uncompressed length, or
+// 0 if it isn't compressed, along with the codec and whether it is a delta
+// against the last gamestate the node was sent rather than a full one.
+#define GAMESTATE_LENGTHMASK 0x00FFFFFF
+#define GAMESTATE_CODECSHIFT 24
+#define GAMESTATE_CODECMASK  0x0F
+#define GAMESTATE_DELTA      0x80000000
+
 UINT8 hu_redownloadinggamestate = 0;
 boolean cl_redownloadinggamestate = false;
 
+static CV_PossibleValue_t gamestatecodec_cons_t[] = {
+	{GAMESTATE_CODEC_LZF, "LZF"},
+#ifdef HAVE_ZLIB
+	{GAMESTATE_CODEC_DEFLATE, "Deflate"},
+#endif
+	{0, NULL}};
+#ifdef HAVE_ZLIB
+consvar_t cv_gamestatecodec = CVAR_INIT ("gamestatecodec", "Deflate", CV_SAVE, gamestatecodec_cons_t, NULL);
+#else
+consvar_t cv_gamestatecodec = CVAR_INIT ("gamestatecodec", "LZF", CV_SAVE, gamestatecodec_cons_t, NULL);
+#endif
+
+static CV_PossibleValue_t gamestatelevel_cons_t[] = {{1, "MIN"}, {9, "MAX"}, {0, NULL}};
+consvar_t cv_gamestatelevel = CVAR_INIT ("gamestatelevel", "6", CV_SAVE, gamestatelevel_cons_t, NULL);
+
+//
+// Gamestate codecs
+//
+// Both functions return the output length, or 0 if the output
+// didn't fit or the input was bad.
+//
+typedef struct
+{
+	const char *name;
+	size_t (*compress)(const UINT8 *in, size_t inlength, UINT8 *out, size_t outlength, INT32 level);
+	size_t (*decompress)(const UINT8 *in, size_t inlength, UINT8 *out, size_t outlength);
+} gamestatecodec_t;
+
+static size_t LZF_Compress(const UINT8 *in, size_t inlength, UINT8 *out, size_t outlength, INT32 level)
+{
+	(void)level;
+	return lzf_compress(in, inlength, out, outlength);
+}
+
+static size_t LZF_Decompress(const UINT8 *in, size_t inlength, UINT8 *out, size_t outlength)
+{
+	return lzf_decompress(in, inlength, out, outlength);
+}
+
+#ifdef HAVE_ZLIB
+static size_t Deflate_Compress(const UINT8 *in, size_t inlength, UINT8 *out, size_t outlength, INT32 level)
+{
+	uLongf length = outlength;
+
+	if (compress2(out, &length, in, inlength, level) != Z_OK)
+		return 0;
+
+	return length;
+}
+
+static size_t Deflate_Decompress(const UINT8 *in, size_t inlength, UINT8 *out, size_t outlength)
+{
+	uLongf length = outlength;
+
+	if (uncompress(out, &length, in, inlength) != Z_OK)
+		return 0;
+
+	return length;
+}
+#endif
+
+static const gamestatecodec_t gamestatecodecs[NUMGAMESTATECODECS] = {
+	{"LZF", LZF_Compress, LZF_Decompress},
+#ifdef HAVE_ZLIB
+	{"Deflate", Deflate_Compress, Deflate_Decompress},
+#else
+	{"Deflate", NULL, NULL},
+#endif
+};
+
+UINT8 CL_GamestateCodecs(void)
+{
+	UINT8 codecs = 0;
+
+	for (INT32 i = 0; i < NUMGAMESTATECODECS; i++)
+		if (gamestatecodecs[i].decompress)
+			codecs |= 1 << i;
+
+	return codecs;
+}
+
+// The last gamestate each node confirmed loading, or received from the
+// server. A resync can then be sent as the difference from it, since both
+// ends hold the same bytes. What was sent only becomes the reference once
+// the client says it has it, so a lost or dropped one is never built on.
+typedef struct
+{
+	UINT8 *data;
+	size_t length;
+	UINT32 checksum;
+} gamestateref_t;
+
+static gamestateref_t svreferences[MAXNETNODES];
+static gamestateref_t svpendingreferences[MAXNETNODES];
+static gamestateref_t clreference;
+
+static UINT32 GamestateChecksum(const UINT8 *data, size_t length)
+{
+	UINT32 hash = 2166136261u; // FNV-1a
+
+	while (length--)
+		hash = (hash ^ *data++) * 16777619u;
+
+	return hash;
+}
+
+static void SetGamestateReference(gamestateref_t *ref, const UINT8 *data, size_t length)
+{
+	free(ref->data);
+	ref->data = malloc(length);
+	ref->length = ref->data ? length : 0;
+
+	if (ref->data)
+	{
+		memcpy(ref->data, data, length);
+		ref->checksum = GamestateChecksum(data, length);
+	}
+}
+
+static void ClearGamestateReference(gamestateref_t *ref)
+{
+	free(ref->data);
+	memset(ref, 0, sizeof (*ref));
+}
+
+void SV_ClearGamestateReference(INT32 node)
+{
+	ClearGamestateReference(&svreferences[node]);
+	ClearGamestateReference(&svpendingreferences[node]);
+}
+
+//
+// Gamestate deltas
+//
+// A delta is a header followed by a list of operations that rebuild the
+// new gamestate out of the reference one: either copy a run of bytes
+// from the reference, or insert bytes that aren't in it. Inserted thinkers
+// shift everything after them around, so matches are found by hashing
+// rather than by comparing at the same offsets.
+//
+#define DELTA_MINMATCH 16
+#define DELTA_HASHBITS 16
+
+enum
+{
+	DELTA_COPY = 1,
+	DELTA_LITERAL
+};
+
+static inline UINT32 DeltaHash(const UINT8 *p)
+{
+	UINT32 a, b;
+
+	memcpy(&a, p, 4);
+	memcpy(&b, p + 4, 4);
+
+	return ((a * 2654435761u) ^ (b * 2246822519u)) >> (32 - DELTA_HASHBITS);
+}
+
+static UINT8 *WriteDeltaLiteral(UINT8 *p, const UINT8 *data, size_t length)
+{
+	if (!length)
+		return p;
+
+	WRITEUINT8(p, DELTA_LITERAL);
+	WRITEUINT32(p, length);
+	WRITEMEM(p, data, length);
+
+	return p;
+}
+
+// Returns a malloced delta, with room for the length word in front, or
+// NULL if there's no reference or the delta isn't any smaller.
+static UINT8 *MakeGamestateDelta(const gamestateref_t *ref, const UINT8 *data, size_t length, size_t *deltalength)
+{
+	const UINT8 *refdata = ref->data;
+	const size_t reflength = ref->length;
+	UINT32 *heads;
+	UINT8 *delta, *p;
+	size_t pos, literal, i;
+
+	if (!refdata || reflength < DELTA_MINMATCH || length < DELTA_MINMATCH)
+		return NULL;
+
+	heads = calloc(1 << DELTA_HASHBITS, sizeof (*heads));
+	// Each operation is at most 9 bytes, and there's at most one literal
+	// per copy, and a copy eats at least DELTA_MINMATCH bytes
+	delta = malloc(sizeof (UINT32) + 12 + length + (length / DELTA_MINMATCH + 1) * 2 * 9);
+	if (!heads || !delta)
+	{
+		free(heads);
+		free(delta);
+		return NULL;
+	}
+
+	// Index the reference; offsets are stored plus one so zero is empty
+	for (i = 0; i + DELTA_MINMATCH <= reflength; i += 8)
+		heads[DeltaHash(refdata + i)] = (UINT32)i + 1;
+
+	p = delta + sizeof (UINT32);
+	WRITEUINT32(p, reflength);
+	WRITEUINT32(p, ref->checksum);
+	WRITEUINT32(p, length);
+
+	pos = literal = 0;
+	while (pos + DELTA_MINMATCH <= length)
+	{
+		const UINT32 head = heads[DeltaHash(data + pos)];
+		size_t from, matchlength;
+
+		if (!head || memcmp(refdata + head - 1, data + pos, DELTA_MINMATCH))
+		{
+			pos++;
+			continue;
+		}
+
+		from = head - 1;
+		matchlength = DELTA_MINMATCH;
+
+		// Grow the match both ways, taking back what we'd have sent as literal
+		while (from + matchlength < reflength && pos + matchlength < length
+			&& refdata[from + matchlength] == data[pos + matchlength])
+			matchlength++;
+		while (from > 0 && pos > literal && refdata[from - 1] == data[pos - 1])
+		{
+			from--;
+			pos--;
+			matchlength++;
+		}
+
+		p = WriteDeltaLiteral(p, data + literal, pos - literal);
+		WRITEUINT8(p, DELTA_COPY);
+		WRITEUINT32(p, from);
+		WRITEUINT32(p, matchlength);
+
+		pos += matchlength;
+		literal = pos;
+	}
+
+	p = WriteDeltaLiteral(p, data + literal, length - literal);
+	free(heads);
+
+	*deltalength = p - (delta + sizeof (UINT32));
+	if (*deltalength >= length)
+	{
+		free(delta);
+		return NULL;
+	}
+
+	return delta;
+}
+
+// Rebuilds a gamestate from a delta against the client's reference, or
+// returns NULL if it can't, in which case a full one has to be asked for
+static UINT8 *ApplyGamestateDelta(UINT8 *delta, size_t deltalength, size_t *length)
+{
+	UINT8 *p = delta, *end = delta + deltalength;
+	UINT32 reflength, checksum;
+	UINT8 *data;
+	size_t pos = 0;
+
+	if (deltalength < 12)
+	{
+		CONS_Alert(CONS_WARNING, M_GetText("Gamestate delta is truncated\n"));
+		return NULL;
+	}
+
+	reflength = READUINT32(p);
+	checksum = READUINT32(p);
+	*length = READUINT32(p);
+
+	if (!clreference.data || reflength != clreference.length || checksum != clreference.checksum)
+	{
+		CONS_Alert(CONS_WARNING, M_GetText("Received a gamestate delta against a gamestate we don't have\n"));
+		return NULL;
+	}
+
+	data = Z_Malloc(*length, PU_STATIC, NULL);
+
+	while (p < end)
+	{
+		UINT8 op = READUINT8(p);
+		UINT32 from = 0, count;
+
+		if (op == DELTA_COPY)
+		{
+			if (end - p < 8)
+				break;
+			from = READUINT32(p);
+			count = READUINT32(p);
+			if (from > reflength || count > reflength - from || count > *length - pos)
+				break;
+			memcpy(data + pos, clreference.data + from, count);
+		}
+		else if (op == DELTA_LITERAL)
+		{
+			if (end - p < 4)
+				break;
+			count = READUINT32(p);
+			if (count > (size_t)(end - p) || count > *length - pos)
+				break;
+			READMEM(p, data + pos, count);
+		}
+		else
+			break;
+
+		pos += count;
+	}
+
+	if (p != end || pos != *length)
+	{
+		CONS_Alert(CONS_WARNING, M_GetText("Gamestate delta is corrupt\n"));
+		Z_Free(data);
+		return NULL;
+	}
+
+	return data;
+}
+
 boolean SV_ResendingSavegameToAnyone(void)
 {
 	for (INT32 i = 0; i < MAXNETNODES; i++)
@@ -57,6 +388,10 @@ void SV_SendSaveGame(INT32 node, boolean resending)
 	UINT8 *savebuffer;
 	UINT8 *compressedsave;
 	UINT8 *buffertosend;
+	UINT32 flags = 0;
+	const gamestatecodec_t *codec;
+	precise_t encodetime = I_GetPreciseTime();
+	size_t rawlength;
 
 	// first save it in a malloced buffer
 	savebuffer = (UINT8 *)malloc(SAVEGAMESIZE);
@@ -79,6 +414,40 @@ void SV_SendSaveGame(INT32 node, boolean resending)
 		I_Error("Savegame buffer overrun");
 	}
 
+	rawlength = length - sizeof(UINT32);
+
+	if (cv_deltaresync.value)
+	{
+		// The client still has the last gamestate they confirmed, so on a
+		// resync only send what has changed since
+		SetGamestateReference(&svpendingreferences[node], savebuffer + sizeof(UINT32), length - sizeof(UINT32));
+
+		if (resending)
+		{
+			size_t deltalength;
+			UINT8 *delta = MakeGamestateDelta(&svreferences[node], savebuffer + sizeof(UINT32), length - sizeof(UINT32), &deltalength);
+
+			if (delta)
+			{
+				free(savebuffer);
+				savebuffer = delta;
+				length = deltalength + sizeof(UINT32);
+				flags = GAMESTATE_DELTA;
+			}
+		}
+	}
+	else
+		SV_ClearGamestateReference(node);
+
+	// Use the codec asked for if the client has it, or else LZF, which
+	// everyone has
+	codec = &gamestatecodecs[GAMESTATE_CODEC_LZF];
+	if (netnodes[node].gamestatecodecs & (1 << cv_gamestatecodec.value))
+	{
+		codec = &gamestatecodecs[cv_gamestatecodec.value];
+		flags |= (UINT32)cv_gamestatecodec.value << GAMESTATE_CODECSHIFT;
+	}
+
 	// Allocate space for compressed save: one byte fewer than for the
 	// uncompressed data to ensure that the compression is worthwhile.
 	compressedsave = malloc(length - 1);
@@ -89,7 +458,7 @@ void SV_SendSaveGame(INT32 node, boolean resending)
 	}
 
 	// Attempt to compress it.
-	if((compressedlen = lzf_compress(savebuffer + sizeof(UINT32), length - sizeof(UINT32), compressedsave + sizeof(UINT32), length - sizeof(UINT32) - 1)))
+	if((compressedlen = codec->compress(savebuffer + sizeof(UINT32), length - sizeof(UINT32), compressedsave + sizeof(UINT32), length - sizeof(UINT32) - 1, cv_gamestatelevel.value)))
 	{
 		// Compressing succeeded; send compressed data
 
@@ -97,7 +466,7 @@ void SV_SendSaveGame(INT32 node, boolean resending)
 
 		// State that we're compressed.
 		buffertosend = compressedsave;
-		WRITEUINT32(compressedsave, length - sizeof(UINT32));
+		WRITEUINT32(compressedsave, (length - sizeof(UINT32)) | flags);
 		length = compressedlen + sizeof(UINT32);
 	}
 	else
@@ -108,9 +477,15 @@ void SV_SendSaveGame(INT32 node, boolean resending)
 
 		// State that we're not compressed
 		buffertosend = savebuffer;
-		WRITEUINT32(savebuffer, 0);
+		WRITEUINT32(savebuffer, flags);
 	}
 
+	encodetime = I_GetPreciseTime() - encodetime;
+	CONS_Printf(M_GetText("Game state for node %d: %s bytes, %s sent (%s%s), encoded in %.2f ms\n"),
+		node, sizeu1(rawlength), sizeu2(length),
+		(buffertosend == compressedsave) ? codec->name : "uncompressed", (flags & GAMESTATE_DELTA) ? ", delta" : "",
+		(double)encodetime * 1000.0 / I_GetPrecisePrecision());
+
 	AddRamToSendQueue(node, buffertosend, length, SF_RAM, 0);
 	save_p = NULL;
 
@@ -165,10 +540,11 @@ void SV_SavedGame(void)
 #define TMPSAVENAME "$$$.sav"
 
 
-void CL_LoadReceivedSavegame(boolean reloading)
+boolean CL_LoadReceivedSavegame(boolean reloading)
 {
 	UINT8 *savebuffer = NULL;
 	size_t length, decompressedlen;
+	UINT32 flags, codec;
 	char tmpsave[256];
 
 	FreeFileNeeded();
@@ -181,19 +557,59 @@ void CL_LoadReceivedSavegame(boolean reloading)
 	if (!length)
 	{
 		I_Error("Can't read savegame sent");
-		return;
+		return false;
 	}
 
 	save_p = savebuffer;
 
 	// Decompress saved game if necessary.
-	decompressedlen = READUINT32(save_p);
+	flags = READUINT32(save_p);
+	decompressedlen = flags & GAMESTATE_LENGTHMASK;
+	codec = (flags >> GAMESTATE_CODECSHIFT) & GAMESTATE_CODECMASK;
+	length -= sizeof(UINT32);
 	if(decompressedlen > 0)
 	{
-		UINT8 *decompressedbuffer = Z_Malloc(decompressedlen, PU_STATIC, NULL);
-		lzf_decompress(save_p, length - sizeof(UINT32), decompressedbuffer, decompressedlen);
+		UINT8 *decompressedbuffer;
+
+		if (codec >= NUMGAMESTATECODECS || !gamestatecodecs[codec].decompress)
+			I_Error("Savegame was compressed with a codec this build doesn't have");
+
+		decompressedbuffer = Z_Malloc(decompressedlen, PU_STATIC, NULL);
+		if (gamestatecodecs[codec].decompress(save_p, length, decompressedbuffer, decompressedlen) != decompressedlen)
+			I_Error("Can't decompress savegame sent");
 		Z_Free(savebuffer);
 		save_p = savebuffer = decompressedbuffer;
+		length = decompressedlen;
+	}
+
+	if (flags & GAMESTATE_DELTA)
+	{
+		UINT8 *rebuiltbuffer = ApplyGamestateDelta(save_p, length, &length);
+		Z_Free(savebuffer);
+		save_p = NULL;
+
+		// Drop it, the caller will ask for the whole thing instead
+		if (!rebuiltbuffer)
+		{
+			ClearGamestateReference(&clreference);
+			if (unlink(tmpsave) == -1)
+				CONS_Alert(CONS_ERROR, M_GetText("Can't delete %s\n"), tmpsave);
+			return false;
+		}
+
+		save_p = savebuffer = rebuiltbuffer;
+	}
+
+	// Keep it for the server to send the next resync against
+	SetGamestateReference(&clreference, save_p, length);
+
+	if (reloading)
+	{
+		for (INT32 i = 0; i < MAXPLAYERS; i++)
+		{
+			LUA_InvalidatePlayer(&players[i]);
+			sprintf(player_names[i], "Player %d", i + 1);
+		}
 	}
 
 	paused = false;
@@ -230,17 +646,25 @@ void CL_LoadReceivedSavegame(boolean reloading)
 	// so they know they can resume the game
 	netbuffer->packettype = PT_RECEIVEDGAMESTATE;
 	HSendPacket(servernode, true, 0, 0);
+	return true;
 }
 
 void CL_ReloadReceivedSavegame(void)
 {
-	for (INT32 i = 0; i < MAXPLAYERS; i++)
+	if (!CL_LoadReceivedSavegame(true))
 	{
-		LUA_InvalidatePlayer(&players[i]);
-		sprintf(player_names[i], "Player %d", i + 1);
-	}
+		char tmpsave[256];
+
+		// The delta couldn't be applied, so have the server send it all
+		netbuffer->packettype = PT_ASKFULLGAMESTATE;
+		HSendPacket(servernode, true, 0, 0);
+
+		CONS_Printf(M_GetText("Asking for the full game state...\n"));
 
-	CL_LoadReceivedSavegame(true);
+		sprintf(tmpsave, "%s" PATHSEP TMPSAVENAME, srb2home);
+		CL_PrepareDownloadSaveGame(tmpsave);
+		return;
+	}
 
 	neededtic = max(neededtic, gametic);
 	maketic = neededtic;
@@ -300,8 +724,30 @@ void PT_CanReceiveGamestate(SINT8 node)
 	netnodes[node].resendingsavegame = true;
 }
 
+void PT_AskFullGamestate(SINT8 node)
+{
+	if (client || !netnodes[node].resendingsavegame)
+		return;
+
+	CONS_Printf(M_GetText("Resending full game state to %s...\n"), player_names[netnodes[node].player]);
+
+	// Whatever the delta was against is no good
+	SV_ClearGamestateReference(node);
+	SV_SendSaveGame(node, true);
+}
+
 void PT_ReceivedGamestate(SINT8 node)
 {
+	gamestateref_t *pending = &svpendingreferences[node];
+
+	// Now we know the client has it, later resyncs can build on it
+	if (pending->data)
+	{
+		ClearGamestateReference(&svreferences[node]);
+		svreferences[node] = *pending;
+		memset(pending, 0, sizeof (*pending));
+	}
+
 	netnodes[node].sendingsavegame = false;
 	netnodes[node].resendingsavegame = false;
 	netnodes[node].savegameresendcooldown = I_GetTime() + 5 * TICRATE;
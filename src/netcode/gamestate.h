@@ -14,17 +14,32 @@
 #define __GAMESTATE__
 
 #include "../doomtype.h"
+#include "../command.h"
+
+// Compression codecs for sent gamestates, as bits in the join request
+enum
+{
+	GAMESTATE_CODEC_LZF,
+	GAMESTATE_CODEC_DEFLATE,
+	NUMGAMESTATECODECS
+};
 
 extern UINT8 hu_redownloadinggamestate;
 extern boolean cl_redownloadinggamestate;
 
+extern consvar_t cv_gamestatecodec, cv_gamestatelevel;
+
+UINT8 CL_GamestateCodecs(void);
+
 boolean SV_ResendingSavegameToAnyone(void);
 void SV_SendSaveGame(INT32 node, boolean resending);
+void SV_ClearGamestateReference(INT32 node);
 void SV_SavedGame(void);
-void CL_LoadReceivedSavegame(boolean reloading);
+boolean CL_LoadReceivedSavegame(boolean reloading);
 void CL_ReloadReceivedSavegame(void);
 void Command_ResendGamestate(void);
 void PT_CanReceiveGamestate(SINT8 node);
+void PT_AskFullGamestate(SINT8 node);
 void PT_ReceivedGamestate(SINT8 node);
 void PT_WillResendGamestate(SINT8 node);
 
@@ -95,6 +95,10 @@ extern boolean (*I_NetCanGet)(void);
 */
 extern void (*I_NetSend)(void);
 
+/**	\brief send any packets the driver is still holding back, may be NULL
+*/
+extern void (*I_NetFlush)(void);
+
 /**	\brief ask to driver if all is ok to send data now
 */
 extern boolean (*I_NetCanSend)(void);
@@ -12,6 +12,15 @@
 ///        This is not really OS-dependent because all OSes have the same socket API.
 ///        Just use ifdef for OS-dependent parts.
 
+// sendmmsg and recvmmsg let one syscall move a whole batch of datagrams.
+// Define NO_MMSG to fall back to one sendto/recvfrom per packet.
+#if defined (__linux__) && !defined (NO_MMSG)
+	#ifndef _GNU_SOURCE
+		#define _GNU_SOURCE
+	#endif
+	#define HAVE_MMSG
+#endif
+
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -173,6 +182,36 @@ static size_t numbans = 0;
 static boolean SOCK_bannednode[MAXNETNODES+1]; /// \note do we really need the +1?
 static boolean init_tcp_driver = false;
 
+#ifdef HAVE_MMSG
+#define MMSG_BATCH 64
+
+// Datagrams waiting for SOCK_Flush, in the order they were sent
+typedef struct
+{
+	SOCKET_TYPE socket;
+	INT16 node; // for error reports, -1 if errors are not reported
+	mysockaddr_t address;
+	socklen_t addrlen;
+	size_t length;
+	char data[MAXPACKETLENGTH];
+} outpacket_t;
+
+// Datagrams read by the last recvmmsg, not yet handed to SOCK_Get
+typedef struct
+{
+	SOCKET_TYPE socket;
+	mysockaddr_t address;
+	socklen_t addrlen;
+	size_t length;
+	char data[MAXPACKETLENGTH];
+} inpacket_t;
+
+static outpacket_t sendqueue[MMSG_BATCH];
+static size_t sendqueuelen = 0;
+static inpacket_t recvring[MMSG_BATCH];
+static size_t recvhead = 0, recvcount = 0;
+#endif
+
 static const char *serverport_name = DEFAULTPORT;
 static const char *clientport_name;/* any port */
 
@@ -501,14 +540,128 @@ void Command_Numnodes(void)
 }
 #endif
 
-// Returns true if a packet was received from a new node, false in all other cases
-static boolean SOCK_Get(void)
+// Maps a packet already copied into doomcom to its node.
+// Returns -1 if it must be dropped, 1 if it came from a new node, 0 otherwise.
+static int SOCK_HandlePacket(SOCKET_TYPE socket, mysockaddr_t *fromaddress, socklen_t fromlen, ssize_t c)
 {
 	size_t i;
 	int j;
+
+	// find remote node number
+	for (j = 1; j <= MAXNETNODES; j++) //include LAN
+	{
+		if (SOCK_cmpaddr(fromaddress, &clientaddress[j], 0))
+		{
+			doomcom->remotenode = (INT16)j; // good packet from a game player
+			doomcom->datalength = (INT16)c;
+			nodesocket[j] = socket;
+			return 0;
+		}
+	}
+	// not found
+
+	// find a free slot
+	j = getfreenode();
+	if (j > 0)
+	{
+		M_Memcpy(&clientaddress[j], fromaddress, fromlen);
+		nodesocket[j] = socket;
+		DEBFILE(va("New node detected: node:%d address:%s\n", j,
+				SOCK_GetNodeAddress(j)));
+		doomcom->remotenode = (INT16)j; // good packet from a game player
+		doomcom->datalength = (INT16)c;
+
+		// check if it's a banned dude so we can send a refusal later
+		for (i = 0; i < numbans; i++)
+		{
+			if (SOCK_cmpaddr(fromaddress, &banned[i], bannedmask[i]))
+			{
+				SOCK_bannednode[j] = true;
+				DEBFILE("This dude has been banned\n");
+				break;
+			}
+		}
+		if (i == numbans)
+			SOCK_bannednode[j] = false;
+		return 1;
+	}
+
+	DEBFILE("New node detected: No more free slots\n");
+	return -1;
+}
+
+#ifdef HAVE_MMSG
+static void SOCK_Flush(void);
+
+// Reads as many waiting datagrams as fit in the ring, one recvmmsg per socket
+static void SOCK_FillRing(void)
+{
+	struct mmsghdr msgs[MMSG_BATCH];
+	struct iovec iovs[MMSG_BATCH];
+
+	recvhead = recvcount = 0;
+
+	for (size_t n = 0; n < mysocketses && recvcount < MMSG_BATCH; n++)
+	{
+		size_t room = MMSG_BATCH - recvcount;
+		int got;
+
+		memset(msgs, 0, room * sizeof (*msgs));
+		for (size_t i = 0; i < room; i++)
+		{
+			inpacket_t *in = &recvring[recvcount + i];
+			iovs[i].iov_base = in->data;
+			iovs[i].iov_len = MAXPACKETLENGTH;
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+			msgs[i].msg_hdr.msg_name = &in->address;
+			msgs[i].msg_hdr.msg_namelen = (socklen_t)sizeof (in->address);
+		}
+
+		got = recvmmsg(mysockets[n], msgs, (unsigned int)room, MSG_DONTWAIT, NULL);
+		if (got <= 0)
+			continue;
+
+		for (int i = 0; i < got; i++)
+		{
+			inpacket_t *in = &recvring[recvcount + i];
+			in->socket = mysockets[n];
+			in->addrlen = msgs[i].msg_hdr.msg_namelen;
+			in->length = msgs[i].msg_len;
+		}
+		recvcount += (size_t)got;
+	}
+}
+#endif
+
+// Returns true if a packet was received from a new node, false in all other cases
+static boolean SOCK_Get(void)
+{
+#ifdef HAVE_MMSG
+	if (!recvcount)
+	{
+		// Nothing buffered, so we are about to wait on the sockets;
+		// whatever was queued for sending should not sit behind that.
+		SOCK_Flush();
+		SOCK_FillRing();
+	}
+
+	while (recvcount)
+	{
+		inpacket_t *in = &recvring[recvhead++];
+		int result;
+
+		recvcount--;
+		M_Memcpy(&doomcom->data, in->data, in->length);
+		result = SOCK_HandlePacket(in->socket, &in->address, in->addrlen, (ssize_t)in->length);
+		if (result != -1)
+			return (result == 1);
+	}
+#else
 	ssize_t c;
 	mysockaddr_t fromaddress;
 	socklen_t fromlen;
+	int result;
 
 	for (size_t n = 0; n < mysocketses; n++)
 	{
@@ -517,48 +670,12 @@ static boolean SOCK_Get(void)
 			(void *)&fromaddress, &fromlen);
 		if (c != ERRSOCKET)
 		{
-			// find remote node number
-			for (j = 1; j <= MAXNETNODES; j++) //include LAN
-			{
-				if (SOCK_cmpaddr(&fromaddress, &clientaddress[j], 0))
-				{
-					doomcom->remotenode = (INT16)j; // good packet from a game player
-					doomcom->datalength = (INT16)c;
-					nodesocket[j] = mysockets[n];
-					return false;
-				}
-			}
-			// not found
-
-			// find a free slot
-			j = getfreenode();
-			if (j > 0)
-			{
-				M_Memcpy(&clientaddress[j], &fromaddress, fromlen);
-				nodesocket[j] = mysockets[n];
-				DEBFILE(va("New node detected: node:%d address:%s\n", j,
-						SOCK_GetNodeAddress(j)));
-				doomcom->remotenode = (INT16)j; // good packet from a game player
-				doomcom->datalength = (INT16)c;
-
-				// check if it's a banned dude so we can send a refusal later
-				for (i = 0; i < numbans; i++)
-				{
-					if (SOCK_cmpaddr(&fromaddress, &banned[i], bannedmask[i]))
-					{
-						SOCK_bannednode[j] = true;
-						DEBFILE("This dude has been banned\n");
-						break;
-					}
-				}
-				if (i == numbans)
-					SOCK_bannednode[j] = false;
-				return true;
-			}
-			else
-				DEBFILE("New node detected: No more free slots\n");
+			result = SOCK_HandlePacket(mysockets[n], &fromaddress, fromlen, c);
+			if (result != -1)
+				return (result == 1);
 		}
 	}
+#endif
 
 	doomcom->remotenode = -1; // no packet
 	return false;
@@ -614,26 +731,98 @@ static boolean SOCK_CanGet(void)
 }
 #endif
 
-static inline ssize_t SOCK_SendToAddr(SOCKET_TYPE socket, mysockaddr_t *sockaddr)
+static inline socklen_t SOCK_AddrLen(mysockaddr_t *sockaddr)
 {
-	socklen_t d4 = (socklen_t)sizeof(struct sockaddr_in);
-#ifdef HAVE_IPV6
-	socklen_t d6 = (socklen_t)sizeof(struct sockaddr_in6);
-#endif
-	socklen_t d, da = (socklen_t)sizeof(mysockaddr_t);
-
 	switch (sockaddr->any.sa_family)
 	{
-		case AF_INET:  d = d4; break;
+		case AF_INET:  return (socklen_t)sizeof(struct sockaddr_in);
 #ifdef HAVE_IPV6
-		case AF_INET6: d = d6; break;
+		case AF_INET6: return (socklen_t)sizeof(struct sockaddr_in6);
 #endif
-		default:       d = da; break;
+		default:       return (socklen_t)sizeof(mysockaddr_t);
 	}
+}
 
-	return sendto(socket, (char *)&doomcom->data, doomcom->datalength, 0, &sockaddr->any, d);
+static void SOCK_SendError(INT32 node)
+{
+	int e = errno; // save error code so it can't be modified later
+	if (e != ECONNREFUSED && e != EWOULDBLOCK)
+		I_Error("SOCK_Send, error sending to node %d (%s) #%u: %s", node,
+			SOCK_GetNodeAddress(node), e, strerror(e));
 }
 
+#ifdef HAVE_MMSG
+// Sends everything queued, with one sendmmsg per run of packets
+// going out through the same socket
+static void SOCK_Flush(void)
+{
+	struct mmsghdr msgs[MMSG_BATCH];
+	struct iovec iovs[MMSG_BATCH];
+	size_t start = 0;
+
+	if (!sendqueuelen)
+		return;
+
+	memset(msgs, 0, sendqueuelen * sizeof (*msgs));
+	for (size_t i = 0; i < sendqueuelen; i++)
+	{
+		outpacket_t *out = &sendqueue[i];
+		iovs[i].iov_base = out->data;
+		iovs[i].iov_len = out->length;
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		msgs[i].msg_hdr.msg_name = &out->address;
+		msgs[i].msg_hdr.msg_namelen = out->addrlen;
+	}
+
+	while (start < sendqueuelen)
+	{
+		size_t end = start + 1;
+		int sent;
+
+		while (end < sendqueuelen && sendqueue[end].socket == sendqueue[start].socket)
+			end++;
+
+		sent = sendmmsg(sendqueue[start].socket, &msgs[start], (unsigned int)(end - start), 0);
+		if (sent > 0)
+			start += (size_t)sent;
+		else
+		{
+			// The first packet of the run failed; report it as sendto would
+			// have, then carry on with the rest.
+			if (sendqueue[start].node != -1)
+				SOCK_SendError(sendqueue[start].node);
+			start++;
+		}
+	}
+
+	sendqueuelen = 0;
+}
+
+static ssize_t SOCK_SendToAddr(SOCKET_TYPE socket, mysockaddr_t *sockaddr, INT16 node)
+{
+	outpacket_t *out;
+
+	if (sendqueuelen == MMSG_BATCH)
+		SOCK_Flush();
+
+	out = &sendqueue[sendqueuelen++];
+	out->socket = socket;
+	out->node = node;
+	out->address = *sockaddr;
+	out->addrlen = SOCK_AddrLen(sockaddr);
+	out->length = (size_t)doomcom->datalength;
+	M_Memcpy(out->data, &doomcom->data, out->length);
+	return doomcom->datalength;
+}
+#else
+static inline ssize_t SOCK_SendToAddr(SOCKET_TYPE socket, mysockaddr_t *sockaddr, INT16 node)
+{
+	(void)node;
+	return sendto(socket, (char *)&doomcom->data, doomcom->datalength, 0, &sockaddr->any, SOCK_AddrLen(sockaddr));
+}
+#endif
+
 static void SOCK_Send(void)
 {
 	ssize_t c = ERRSOCKET;
@@ -648,7 +837,7 @@ static void SOCK_Send(void)
 			for (size_t j = 0; j < broadcastaddresses; j++)
 			{
 				if (myfamily[i] == broadcastaddress[j].any.sa_family)
-					SOCK_SendToAddr(mysockets[i], &broadcastaddress[j]);
+					SOCK_SendToAddr(mysockets[i], &broadcastaddress[j], -1);
 			}
 		}
 		return;
@@ -658,22 +847,17 @@ static void SOCK_Send(void)
 		for (size_t i = 0; i < mysocketses; i++)
 		{
 			if (myfamily[i] == clientaddress[doomcom->remotenode].any.sa_family)
-				SOCK_SendToAddr(mysockets[i], &clientaddress[doomcom->remotenode]);
+				SOCK_SendToAddr(mysockets[i], &clientaddress[doomcom->remotenode], -1);
 		}
 		return;
 	}
 	else
 	{
-		c = SOCK_SendToAddr(nodesocket[doomcom->remotenode], &clientaddress[doomcom->remotenode]);
+		c = SOCK_SendToAddr(nodesocket[doomcom->remotenode], &clientaddress[doomcom->remotenode], doomcom->remotenode);
 	}
 
 	if (c == ERRSOCKET)
-	{
-		int e = errno; // save error code so it can't be modified later
-		if (e != ECONNREFUSED && e != EWOULDBLOCK)
-			I_Error("SOCK_Send, error sending to node %d (%s) #%u: %s", doomcom->remotenode,
-				SOCK_GetNodeAddress(doomcom->remotenode), e, strerror(e));
-	}
+		SOCK_SendError(doomcom->remotenode);
 }
 
 static void SOCK_FreeNodenum(INT32 numnode)
@@ -1092,6 +1276,12 @@ boolean I_InitTcpDriver(void)
 
 static void SOCK_CloseSocket(void)
 {
+#ifdef HAVE_MMSG
+	// Get out whatever was queued before the sockets go away
+	SOCK_Flush();
+	recvhead = recvcount = 0;
+#endif
+
 	for (size_t i=0; i < MAXNETNODES+1; i++)
 	{
 		if (mysockets[i] != (SOCKET_TYPE)ERRSOCKET
@@ -1186,6 +1376,9 @@ static boolean SOCK_OpenSocket(void)
 	I_NetCloseSocket = SOCK_CloseSocket;
 	I_NetFreeNodenum = SOCK_FreeNodenum;
 	I_NetMakeNodewPort = SOCK_NetMakeNodewPort;
+#ifdef HAVE_MMSG
+	I_NetFlush = SOCK_Flush;
+#endif
 
 #ifdef SELECTTEST
 	// seem like not work with libsocket : (
@@ -422,6 +422,7 @@ void PT_ClientJoin(SINT8 node)
 {
 	char names[MAXSPLITSCREENPLAYERS][MAXPLAYERNAME + 1];
 	INT32 numplayers = netbuffer->u.clientcfg.localplayers;
+	UINT8 gamestatecodecs = netbuffer->u.clientcfg.gamestatecodecs;
 	INT32 rejoinernum;
 
 	// Ignore duplicate packets
@@ -448,6 +449,7 @@ void PT_ClientJoin(SINT8 node)
 	}
 
 	SV_AddNode(node);
+	netnodes[node].gamestatecodecs = gamestatecodecs;
 
 	if (!SV_SendServerConfig(node))
 	{
@@ -3615,6 +3615,8 @@ boolean P_DamageMobj(mobj_t *target, mobj_t *inflictor, mobj_t *source, INT32 da
 	if (objectplacing)
 		return false;
 
+	P_WakeMobj(target);
+
 	if (target->health <= 0)
 		return false;
 
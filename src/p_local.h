@@ -296,6 +296,9 @@ void P_RunShields(void);
 void P_RunOverlays(void);
 void P_HandleMinecartSegments(mobj_t *mobj);
 void P_MobjThinker(mobj_t *mobj);
+void P_DormantMobjThinker(mobj_t *mobj);
+void P_WakeDormantMobjs(void);
+void P_WakeMobj(mobj_t *mobj);
 boolean P_RailThinker(mobj_t *mobj);
 void P_PushableThinker(mobj_t *mobj);
 void P_SceneryThinker(mobj_t *mobj);
@@ -4245,6 +4245,9 @@ static boolean PIT_ChangeSector(mobj_t *thing, boolean realcrush, boolean crunch
 	//If a thing is both pushable and vulnerable, it doesn't block the crusher because it gets killed.
 	boolean immunepushable = ((thing->flags & (MF_PUSHABLE | MF_SHOOTABLE)) == MF_PUSHABLE);
 
+	// Whatever the sector does next may concern it
+	P_WakeMobj(thing);
+
 	if (P_ThingHeightClip(thing))
 	{
 		//thing fits, check next thing
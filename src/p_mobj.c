@@ -38,6 +38,8 @@
 #include "m_cond.h"
 #include "netcode/net_command.h"
 
+boolean LUA_ActionOverridden(enum actionnum actionnum);
+
 static CV_PossibleValue_t CV_BobSpeed[] = {{0, "MIN"}, {4*FRACUNIT, "MAX"}, {0, NULL}};
 consvar_t cv_movebob = CVAR_INIT ("movebob", "1.0", CV_FLOAT|CV_SAVE, CV_BobSpeed, NULL);
 
@@ -4126,6 +4128,162 @@ static void P_RingThinker(mobj_t *mobj)
 	P_CycleMobjState(mobj);
 }
 
+//
+// Dormant mobjs
+//
+// A ring sitting still with nobody around does nothing in its thinker but
+// advance its animation. Such mobjs are marked dormant and skip the rest of
+// the think until a player comes close or something disturbs them. They
+// stay in the thinker list, so the order everything thinks in is the same
+// as always; the dormant flag itself is saved with the mobj for joiners.
+//
+
+// How close a player may get before nearby dormant mobjs are woken up.
+// Covers the attraction shield's range plus however far the player may
+// travel before the mobj next thinks.
+static fixed_t P_DormantWakeDist(mobj_t *pmo)
+{
+	return FixedMul(RING_DIST, pmo->scale) + MAPBLOCKSIZE + abs(pmo->momx) + abs(pmo->momy);
+}
+
+// Things that would make the mobj's next think do more than animate.
+static boolean P_MobjMayBeDormant(mobj_t *mobj)
+{
+	if (mobj->momx || mobj->momy || mobj->momz || mobj->tics != -1 || mobj->fuse || mobj->health <= 0)
+		return false;
+
+	if (mobj->scale != mobj->destscale)
+		return false;
+
+	if (mobj->target || mobj->tracer || mobj->hnext || mobj->hprev)
+		return false;
+
+	// Rings pick a random player to look at the first time they think
+	if (mobj->lastlook < 0 && mobj->type != MT_BOMBSPHERE)
+		return false;
+
+	if ((mobj->flags & (MF_NOTHINK|MF_NOBLOCKMAP))
+	|| (mobj->flags2 & (MF2_NIGHTSPULL|MF2_DONTDRAW))
+	|| (mobj->eflags & (MFE_PUSHED|MFE_SPRUNG)))
+		return false;
+
+	if (!mobj->subsector || (mobj->subsector->sector->flags & MSF_TRIGGERLINE_MOBJ))
+		return false;
+
+	if (LUA_MobjHookAvailable(mobj, MOBJ_HOOK(MobjThinker)))
+		return false;
+
+	// A Lua A_AttractChase may do anything at all, so it has to keep running
+	return !LUA_ActionOverridden(A_ATTRACTCHASE);
+}
+
+//
+// P_MobjTryDormant
+//
+// Called at the end of a ring's think. The box test here is a little wider
+// than the area P_WakeDormantMobjs scans, so a mobj it just woke does not
+// go straight back to sleep.
+//
+static void P_MobjTryDormant(mobj_t *mobj)
+{
+	INT32 i;
+
+	if (!P_MobjMayBeDormant(mobj))
+		return;
+
+	for (i = 0; i < MAXPLAYERS; i++)
+	{
+		mobj_t *pmo;
+		fixed_t dist;
+
+		if (!playeringame[i] || !players[i].mo || P_MobjWasRemoved(players[i].mo))
+			continue;
+
+		pmo = players[i].mo;
+		dist = P_DormantWakeDist(pmo) + MAPBLOCKSIZE;
+
+		if (abs(mobj->x - pmo->x) <= dist && abs(mobj->y - pmo->y) <= dist)
+			return;
+	}
+
+	mobj->dormant = true;
+}
+
+void P_WakeMobj(mobj_t *mobj)
+{
+	mobj->dormant = false;
+}
+
+//
+// P_WakeDormantMobjs
+//
+// Wakes every dormant mobj in the blockmap cells around each player.
+// Called once per tic, before the mobj thinkers run.
+//
+void P_WakeDormantMobjs(void)
+{
+	INT32 i, bx, by, xl, xh, yl, yh;
+	mobj_t *mo;
+
+	if (!blocklinks)
+		return;
+
+	for (i = 0; i < MAXPLAYERS; i++)
+	{
+		mobj_t *pmo;
+		fixed_t dist;
+
+		if (!playeringame[i] || !players[i].mo || P_MobjWasRemoved(players[i].mo))
+			continue;
+
+		pmo = players[i].mo;
+		dist = P_DormantWakeDist(pmo);
+
+		xl = (unsigned)(pmo->x - dist - bmaporgx)>>MAPBLOCKSHIFT;
+		xh = (unsigned)(pmo->x + dist - bmaporgx)>>MAPBLOCKSHIFT;
+		yl = (unsigned)(pmo->y - dist - bmaporgy)>>MAPBLOCKSHIFT;
+		yh = (unsigned)(pmo->y + dist - bmaporgy)>>MAPBLOCKSHIFT;
+
+		BMBOUNDFIX(xl, xh, yl, yh);
+
+		if (xh >= bmapwidth)
+			xh = bmapwidth - 1;
+		if (yh >= bmapheight)
+			yh = bmapheight - 1;
+
+		for (by = yl; by <= yh; by++)
+			for (bx = xl; bx <= xh; bx++)
+				for (mo = blocklinks[by*bmapwidth + bx]; mo; mo = mo->bnext)
+					mo->dormant = false;
+	}
+}
+
+//
+// P_DormantMobjThinker
+//
+// Stands in for P_MobjThinker while a mobj is dormant. If anything has
+// touched the mobj since it went to sleep, it wakes and thinks normally.
+//
+void P_DormantMobjThinker(mobj_t *mobj)
+{
+	if (!P_MobjMayBeDormant(mobj))
+	{
+		mobj->dormant = false;
+		P_MobjThinker(mobj);
+		return;
+	}
+
+	// Lava can rise up to a ring that isn't doing anything
+	if (mobj->type == MT_RING || mobj->type == MT_REDTEAMRING || mobj->type == MT_BLUETEAMRING)
+	{
+		P_KillRingsInLava(mobj);
+		if (P_MobjWasRemoved(mobj))
+			return;
+	}
+
+	P_CycleStateAnimation(mobj);
+}
+
 //
 // P_BossTargetPlayer
 // If closest is true, find the closest player.
@@ -9737,6 +9895,8 @@ static boolean P_MobjRegularThink(mobj_t *mobj)
 			P_NightsItemChase(mobj);
 		else if (mobj->type != MT_BOMBSPHERE) // prevent shields from attracting bomb spheres
 			A_AttractChase(mobj);
+		if (!P_MobjWasRemoved(mobj))
+			P_MobjTryDormant(mobj);
 		return false;
 		// Flung items
 	case MT_FLINGRING:
@@ -364,6 +364,7 @@ typedef struct mobj_s
 	INT32 threshold; // If >0, the target will be chased no matter what.
 
 	SINT8 hybridtics; // Tics spent in hyrbid thinker state
+	boolean dormant; // Only animating until a player comes near, see P_WakeDormantMobjs
 
 	// Additional info record for player avatars only.
 	// Only valid if type == MT_PLAYER
@@ -402,6 +403,8 @@ typedef struct mobj_s
 	struct pslope_s *standingslope; // The slope that the object is standing on (shouldn't need synced in savegames, right?)
 
 	boolean resetinterp; // if true, some fields should not be interpolated (see R_InterpolateMobjState implementation)
+	UINT32 snapshotgen; // renderer only: interpolation snapshot this mobj was last published in, 0 if none
+	size_t snapshotslot; // renderer only: index of this mobj in that snapshot
 	boolean colorized; // Whether the mobj uses the rainbow colormap
 	boolean mirrored; // The object's rotations will be mirrored left to right, e.g., see frame AL from the right and AR from the left
 	fixed_t shadowscale; // If this object casts a shadow, and the size relative to radius
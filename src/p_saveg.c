@@ -1583,7 +1583,8 @@ typedef enum
 	MD2_DISPOFFSET          = 1<<23,
 	MD2_DRAWONLYFORPLAYER   = 1<<24,
 	MD2_DONTDRAWFORVIEWMOBJ = 1<<25,
-	MD2_HYBRIDTICS  = 1<<26
+	MD2_HYBRIDTICS  = 1<<26,
+	MD2_DORMANT     = 1<<27
 } mobj_diff2_t;
 
 typedef enum
@@ -1827,6 +1828,8 @@ static void SaveMobjThinker(const thinker_t *th, const UINT8 type)
 
 	if (mobj->hybridtics)
 		diff2 |= MD2_HYBRIDTICS;
+	if (mobj->dormant)
+		diff2 |= MD2_DORMANT;
 
 	if (diff2 != 0)
 		diff |= MD_MORE;
@@ -3076,6 +3079,7 @@ static thinker_t* LoadMobjThinker(actionf_p1 thinker)
 
 	if (diff2 & MD2_HYBRIDTICS)
 		mobj->hybridtics = READSINT8(save_p);
+	mobj->dormant = ((diff2 & MD2_DORMANT) != 0);
 
 	if (diff & MD_REDFLAG)
 	{
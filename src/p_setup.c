@@ -7803,8 +7803,9 @@ boolean P_LoadLevel(boolean fromnetsave, boolean reloadinggamestate)
 		Z_Free(ss->attachedsolid);
 	}
 
-	// Clear pointers that would be left dangling by the purge
-	R_FlushTranslationColormapCache();
+	// Nothing holds on to translation colormaps across the purge, so this
+	// is the one place unused ones can be let go of
+	R_TrimTranslationColormapCache();
 
 #ifdef HWRENDER
 	// Free GPU textures before freeing patches.
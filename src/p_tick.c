@@ -416,12 +416,59 @@ mobj_t *P_SetTarget2(mobj_t **mop, mobj_t *targ
 // Rewritten to delete nodes implicitly, by making currentthinker
 // external and using P_RemoveThinkerDelayed() implicitly.
 //
-static inline void P_RunThinkers(void)
+// The mobj list is by far the longest, and almost everything on it runs
+// P_MobjThinker, so call that directly instead of through the pointer.
+// Mobjs are scattered around memory, so start fetching the next one while
+// the current one thinks. The order thinkers run in is left alone, as
+// netgames and demos depend on it.
+static inline void P_RunMobjThinkers(void)
+{
+	thinker_t *list = &thlist[THINK_MOBJ];
+
+	P_WakeDormantMobjs();
+
+	for (currentthinker = list->next; currentthinker != list; currentthinker = currentthinker->next)
+	{
+		PREFETCH(currentthinker->next);
+		PREFETCH((UINT8 *)currentthinker->next + 64);
+#ifdef PARANOIA
+		I_Assert(currentthinker->function.acp1 != NULL);
+#endif
+		if (currentthinker->function.acp1 == (actionf_p1)P_MobjThinker)
+		{
+			if (((mobj_t *)currentthinker)->dormant)
+				P_DormantMobjThinker((mobj_t *)currentthinker);
+			else
+				P_MobjThinker((mobj_t *)currentthinker);
+		}
+		else
+			currentthinker->function.acp1(currentthinker);
+	}
+}
+
+// Span names for perftrace, one per thinker list
+static const char *const thlist_tracenames[NUM_THINKERLISTS] = {
+	"thlist polyobj",
+	"thlist main",
+	"thlist mobj",
+	"thlist dynslope",
+	"thlist precip"
+};
+
+static void P_RunThinkers(void)
 {
 	size_t i;
 	for (i = 0; i < NUM_THINKERLISTS; i++)
 	{
+		PS_TRACE_BEGIN(thlist_tracenames[i]);
 		PS_START_TIMING(ps_thlist_times[i]);
+		if (i == THINK_MOBJ)
+		{
+			P_RunMobjThinkers();
+			PS_STOP_TIMING(ps_thlist_times[i]);
+			PS_TRACE_END();
+			continue;
+		}
 		for (currentthinker = thlist[i].next; currentthinker != &thlist[i]; currentthinker = currentthinker->next)
 		{
 #ifdef PARANOIA
@@ -430,6 +477,7 @@ static inline void P_RunThinkers(void)
 			currentthinker->function.acp1(currentthinker);
 		}
 		PS_STOP_TIMING(ps_thlist_times[i]);
+		PS_TRACE_END();
 	}
 
 }
@@ -760,11 +808,13 @@ void P_Ticker(boolean run)
 
 		LUA_HOOK(PreThinkFrame);
 
+		PS_TRACE_BEGIN("P_PlayerThink");
 		PS_START_TIMING(ps_playerthink_time);
 		for (i = 0; i < MAXPLAYERS; i++)
 			if (playeringame[i] && players[i].mo && !P_MobjWasRemoved(players[i].mo))
 				P_PlayerThink(&players[i]);
 		PS_STOP_TIMING(ps_playerthink_time);
+		PS_TRACE_END();
 	}
 
 	// Keep track of how long they've been playing!
@@ -782,20 +832,28 @@ void P_Ticker(boolean run)
 
 	if (run)
 	{
+		PS_TRACE_BEGIN("P_RunThinkers");
 		PS_START_TIMING(ps_thinkertime);
 		P_RunThinkers();
 		PS_STOP_TIMING(ps_thinkertime);
+		PS_TRACE_END();
 
 		// Run any "after all the other thinkers" stuff
+		PS_TRACE_BEGIN("P_PlayerAfterThink");
 		for (i = 0; i < MAXPLAYERS; i++)
 			if (playeringame[i] && players[i].mo && !P_MobjWasRemoved(players[i].mo))
 				P_PlayerAfterThink(&players[i]);
+		PS_TRACE_END();
 
+		PS_TRACE_BEGIN("LUA_HookThinkFrame");
 		PS_START_TIMING(ps_lua_thinkframe_time);
 		LUA_HookThinkFrame();
 		PS_STOP_TIMING(ps_lua_thinkframe_time);
+		PS_TRACE_END();
 	}
 
+	PS_TRACE_BEGIN("P_UpdateSpecials");
+
 	// Run shield positioning
 	P_RunShields();
 	P_RunOverlays();
@@ -806,6 +864,8 @@ void P_Ticker(boolean run)
 	// Lightning, rain sounds, etc.
 	P_PrecipitationEffects();
 
+	PS_TRACE_END();
+
 	if (run)
 		leveltime++;
 	timeinmap++;
@@ -872,6 +932,7 @@ void P_Ticker(boolean run)
 	{
 		R_UpdateLevelInterpolators();
 		R_UpdateViewInterpolation();
+		R_PublishMobjSnapshot();
 
 		// Hack: ensure newview is assigned every tic.
 		// Ensures view interpolation is T-1 to T in poor network conditions
@@ -967,6 +1028,7 @@ void P_PreTicker(INT32 frames)
 		R_UpdateLevelInterpolators();
 		R_UpdateViewInterpolation();
 		R_ResetViewInterpolation(0);
+		R_PublishMobjSnapshot();
 
 		P_MapEnd();
 	}
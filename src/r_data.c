@@ -1278,16 +1278,9 @@ void R_PrecacheLevel(void)
 	texturepresent[skytexture] = 1;
 
 	texturememory = 0;
-	for (j = 0; j < (unsigned)numtextures; j++)
-	{
-		if (!texturepresent[j])
-			continue;
-
-		if (!texturecache[j])
-			R_GenerateTexture(j);
-		// pre-caching individual patches that compose textures became obsolete,
-		// since we cache entire composite textures
-	}
+	// pre-caching individual patches that compose textures became obsolete,
+	// since we cache entire composite textures
+	R_PregenerateTextures(texturepresent);
 	free(texturepresent);
 
 	//
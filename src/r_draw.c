@@ -27,6 +27,12 @@
 #include "console.h" // Until buffering gets finished
 #include "libdivide.h" // used by NPO2 tilted span functions
 
+#if defined (HAVE_X86_DRAWERS)
+#include <immintrin.h>
+#elif defined (HAVE_NEON_DRAWERS)
+#include <arm_neon.h>
+#endif
+
 #ifdef HWRENDER
 #include "hardware/hw_main.h"
 #endif
@@ -41,7 +47,7 @@ INT32 viewwidth, scaledviewwidth, viewheight, viewwindowx, viewwindowy;
 
 /**	\brief pointer to the start of each line of the screen,
 */
-UINT8 *ylookup[MAXVIDHEIGHT*4];
+R_THREADLOCAL UINT8 *ylookup[MAXVIDHEIGHT*4];
 
 /**	\brief pointer to the start of each line of the screen, for view1 (splitscreen)
 */
@@ -62,13 +68,13 @@ UINT8 *topleft;
 //                      COLUMN DRAWING CODE STUFF
 // =========================================================================
 
-lighttable_t *dc_colormap;
-INT32 dc_x = 0, dc_yl = 0, dc_yh = 0;
+R_THREADLOCAL lighttable_t *dc_colormap;
+R_THREADLOCAL INT32 dc_x = 0, dc_yl = 0, dc_yh = 0;
 
-fixed_t dc_iscale, dc_texturemid;
-UINT8 dc_hires; // under MSVC boolean is a byte, while on other systems, it a bit,
+R_THREADLOCAL fixed_t dc_iscale, dc_texturemid;
+R_THREADLOCAL UINT8 dc_hires; // under MSVC boolean is a byte, while on other systems, it a bit,
                // soo lets make it a byte on all system for the ASM code
-UINT8 *dc_source;
+R_THREADLOCAL UINT8 *dc_source;
 
 // -----------------------
 // translucency stuff here
@@ -80,7 +86,7 @@ UINT8 *blendtables[NUMBLENDMAPS];
 
 /**	\brief R_DrawTransColumn uses this
 */
-UINT8 *dc_transmap; // one of the translucency tables
+R_THREADLOCAL UINT8 *dc_transmap; // one of the translucency tables
 
 // ----------------------
 // translation stuff here
@@ -89,87 +95,76 @@ UINT8 *dc_transmap; // one of the translucency tables
 
 /**	\brief R_DrawTranslatedColumn uses this
 */
-UINT8 *dc_translation;
+R_THREADLOCAL UINT8 *dc_translation;
 
 struct r_lightlist_s *dc_lightlist = NULL;
-INT32 dc_numlights = 0, dc_maxlights, dc_texheight;
+INT32 dc_numlights = 0, dc_maxlights;
+R_THREADLOCAL INT32 dc_texheight;
 
 // =========================================================================
 //                      SPAN DRAWING CODE STUFF
 // =========================================================================
 
-INT32 ds_y, ds_x1, ds_x2;
-lighttable_t *ds_colormap;
-lighttable_t *ds_translation; // Lactozilla: Sprite splat drawer
+R_THREADLOCAL INT32 ds_y, ds_x1, ds_x2;
+R_THREADLOCAL lighttable_t *ds_colormap;
+R_THREADLOCAL lighttable_t *ds_translation; // Lactozilla: Sprite splat drawer
 
-fixed_t ds_xfrac, ds_yfrac, ds_xstep, ds_ystep;
-INT32 ds_waterofs, ds_bgofs;
+R_THREADLOCAL fixed_t ds_xfrac, ds_yfrac, ds_xstep, ds_ystep;
+R_THREADLOCAL INT32 ds_waterofs, ds_bgofs;
 
-UINT16 ds_flatwidth, ds_flatheight;
-boolean ds_powersoftwo, ds_solidcolor;
+R_THREADLOCAL UINT16 ds_flatwidth, ds_flatheight;
+R_THREADLOCAL boolean ds_powersoftwo, ds_solidcolor;
 
-UINT8 *ds_source; // points to the start of a flat
-UINT8 *ds_transmap; // one of the translucency tables
+R_THREADLOCAL UINT8 *ds_source; // points to the start of a flat
+R_THREADLOCAL UINT8 *ds_transmap; // one of the translucency tables
 
 // Vectors for Software's tilted slope drawers
 floatv3_t *ds_su, *ds_sv, *ds_sz;
-floatv3_t *ds_sup, *ds_svp, *ds_szp;
-float focallengthf, zeroheight;
+R_THREADLOCAL floatv3_t *ds_sup, *ds_svp, *ds_szp;
+float focallengthf;
+R_THREADLOCAL float zeroheight;
 
 /**	\brief Variable flat sizes
 */
 
-UINT32 nflatxshift, nflatyshift, nflatshiftup, nflatmask;
+R_THREADLOCAL UINT32 nflatxshift, nflatyshift, nflatshiftup, nflatmask;
 
 // =========================================================================
 //                   TRANSLATION COLORMAP CODE
 // =========================================================================
 
-#define DEFAULT_TT_CACHE_INDEX MAXSKINS
-#define BOSS_TT_CACHE_INDEX (MAXSKINS + 1)
-#define METALSONIC_TT_CACHE_INDEX (MAXSKINS + 2)
-#define ALLWHITE_TT_CACHE_INDEX (MAXSKINS + 3)
-#define RAINBOW_TT_CACHE_INDEX (MAXSKINS + 4)
-#define BLINK_TT_CACHE_INDEX (MAXSKINS + 5)
-#define DASHMODE_TT_CACHE_INDEX (MAXSKINS + 6)
 #define DEFAULT_STARTTRANSCOLOR 96
 #define NUM_PALETTE_ENTRIES 256
 
-static UINT8 **translationtablecache[MAXSKINS + 7] = {NULL};
-UINT8 skincolor_modified[MAXSKINCOLORS];
+// Cached translation colormaps, hashed on skin number and color. Callers
+// keep the pointers they get back for as long as they like, so nothing is
+// ever freed while a level is running. Instead, every entry remembers the
+// last level it was looked up in, and R_TrimTranslationColormapCache drops
+// the stale ones when the level changes and everything gets looked up again.
+#define TT_CACHE_HASHSIZE 1024
+#define TT_CACHE_MAXENTRIES 2048
 
-static INT32 SkinToCacheIndex(INT32 skinnum)
+typedef struct ttcacheentry_s
 {
-	switch (skinnum)
-	{
-		case TC_DEFAULT:    return DEFAULT_TT_CACHE_INDEX;
-		case TC_BOSS:       return BOSS_TT_CACHE_INDEX;
-		case TC_METALSONIC: return METALSONIC_TT_CACHE_INDEX;
-		case TC_ALLWHITE:   return ALLWHITE_TT_CACHE_INDEX;
-		case TC_RAINBOW:    return RAINBOW_TT_CACHE_INDEX;
-		case TC_BLINK:      return BLINK_TT_CACHE_INDEX;
-		case TC_DASHMODE:   return DASHMODE_TT_CACHE_INDEX;
-		     default:       break;
-	}
+	UINT8 *colormap;
+	INT32 skinnum; // may be a TC_ value
+	UINT16 color;
+	UINT32 lastused; // ttcachelevel when last looked up
+	struct ttcacheentry_s *next; // hash chain
+	struct ttcacheentry_s *colornext; // all entries of the same color
+} ttcacheentry_t;
+
+static ttcacheentry_t *ttcache[TT_CACHE_HASHSIZE];
+static ttcacheentry_t *ttcachebycolor[MAXSKINCOLORS];
+static size_t ttcacheentries = 0;
+static UINT32 ttcachelevel = 0;
 
-	return skinnum;
-}
+UINT8 skincolor_modified[MAXSKINCOLORS];
 
-static INT32 CacheIndexToSkin(INT32 ttc)
+static inline UINT32 R_TranslationCacheHash(INT32 skinnum, UINT16 color)
 {
-	switch (ttc)
-	{
-		case DEFAULT_TT_CACHE_INDEX:    return TC_DEFAULT;
-		case BOSS_TT_CACHE_INDEX:       return TC_BOSS;
-		case METALSONIC_TT_CACHE_INDEX: return TC_METALSONIC;
-		case ALLWHITE_TT_CACHE_INDEX:   return TC_ALLWHITE;
-		case RAINBOW_TT_CACHE_INDEX:    return TC_RAINBOW;
-		case BLINK_TT_CACHE_INDEX:      return TC_BLINK;
-		case DASHMODE_TT_CACHE_INDEX:   return TC_DASHMODE;
-		     default:                   break;
-	}
-
-	return ttc;
+	UINT32 h = ((UINT32)skinnum * 0x9E3779B1u) ^ ((UINT32)color * 0x85EBCA77u);
+	return (h ^ (h >> 15)) & (TT_CACHE_HASHSIZE - 1);
 }
 
 CV_PossibleValue_t Color_cons_t[MAXSKINCOLORS+1];
@@ -574,6 +569,54 @@ static void R_GenerateTranslationColormap(UINT8 *dest_colormap, INT32 skinnum, U
 }
 
 
+/**	\brief	Regenerates every cached colormap of a color whose ramp changed.
+
+	The colormaps are rebuilt in place, so pointers that callers are still
+	holding pick up the new ramp.
+
+	\param	color	translation color
+*/
+static void R_RefreshTranslationColor(UINT16 color)
+{
+	ttcacheentry_t *entry;
+
+	for (entry = ttcachebycolor[color]; entry; entry = entry->colornext)
+		R_GenerateTranslationColormap(entry->colormap, entry->skinnum, color);
+
+	skincolor_modified[color] = false;
+}
+
+static ttcacheentry_t *R_FindTranslationCacheEntry(INT32 skinnum, UINT16 color)
+{
+	ttcacheentry_t *entry;
+
+	for (entry = ttcache[R_TranslationCacheHash(skinnum, color)]; entry; entry = entry->next)
+		if (entry->skinnum == skinnum && entry->color == color)
+			return entry;
+
+	return NULL;
+}
+
+static ttcacheentry_t *R_AddTranslationCacheEntry(INT32 skinnum, UINT16 color)
+{
+	UINT32 hash = R_TranslationCacheHash(skinnum, color);
+	ttcacheentry_t *entry = Z_Malloc(sizeof (*entry), PU_STATIC, NULL);
+
+	entry->colormap = Z_MallocAlign(NUM_PALETTE_ENTRIES, PU_STATIC, NULL, 8);
+	entry->skinnum = skinnum;
+	entry->color = color;
+	entry->lastused = ttcachelevel;
+	R_GenerateTranslationColormap(entry->colormap, skinnum, color);
+
+	entry->next = ttcache[hash];
+	ttcache[hash] = entry;
+	entry->colornext = ttcachebycolor[color];
+	ttcachebycolor[color] = entry;
+	ttcacheentries++;
+
+	return entry;
+}
+
 /**	\brief	Retrieves a translation colormap from the cache.
 
 	\param	skinnum	number of skin, TC_DEFAULT or TC_BOSS
@@ -584,60 +627,138 @@ static void R_GenerateTranslationColormap(UINT8 *dest_colormap, INT32 skinnum, U
 */
 UINT8* R_GetTranslationColormap(INT32 skinnum, skincolornum_t color, UINT8 flags)
 {
+	ttcacheentry_t *entry;
 	UINT8* ret;
-	INT32 skintableindex = SkinToCacheIndex(skinnum); // Adjust if we want the default colormap
-	INT32 i;
 
-	if (flags & GTC_CACHE)
+	if (!(flags & GTC_CACHE))
 	{
-		// Allocate table for skin if necessary
-		if (!translationtablecache[skintableindex])
-			translationtablecache[skintableindex] = Z_Calloc(MAXSKINCOLORS * sizeof(UINT8**), PU_STATIC, NULL);
+		ret = Z_MallocAlign(NUM_PALETTE_ENTRIES, PU_STATIC, NULL, 8);
+		R_GenerateTranslationColormap(ret, skinnum, color);
+		return ret;
+	}
 
-		// Get colormap
-		ret = translationtablecache[skintableindex][color];
+	// Rebuild the cache if necessary
+	if (skincolor_modified[color])
+		R_RefreshTranslationColor(color);
 
-		// Rebuild the cache if necessary
-		if (skincolor_modified[color])
-		{
-			for (i = 0; i < (INT32)(sizeof(translationtablecache) / sizeof(translationtablecache[0])); i++)
-				if (translationtablecache[i] && translationtablecache[i][color])
-					R_GenerateTranslationColormap(translationtablecache[i][color], CacheIndexToSkin(i), color);
+	entry = R_FindTranslationCacheEntry(skinnum, color);
+	if (entry)
+		entry->lastused = ttcachelevel;
+	else
+		entry = R_AddTranslationCacheEntry(skinnum, color);
 
-			skincolor_modified[color] = false;
-		}
-	}
-	else ret = NULL;
+	return entry->colormap;
+}
 
-	// Generate the colormap if necessary
-	if (!ret)
-	{
-		ret = Z_MallocAlign(NUM_PALETTE_ENTRIES, (flags & GTC_CACHE) ? PU_LEVEL : PU_STATIC, NULL, 8);
-		R_GenerateTranslationColormap(ret, skinnum, color);
+/**	\brief	Generates the colormaps a player is likely to need up front.
+
+	Called when a player joins or changes skin or color, so the colormaps
+	are built together there instead of one at a time on the frames they
+	are first drawn. Besides the player's own color, this covers the skin's
+	preferred color and, for skins that can turn super, its flashing ramp.
+
+	\param	skinnum	number of skin
+	\param	color	player's color
+*/
+void R_PrecacheTranslationColormaps(INT32 skinnum, UINT16 color)
+{
+	skin_t *skin;
+	UINT16 supercolor;
+
+	if (skinnum < 0 || skinnum >= numskins)
+		return;
+
+	skin = &skins[skinnum];
 
-		// Cache the colormap if desired
-		if (flags & GTC_CACHE)
-			translationtablecache[skintableindex][color] = ret;
+	if (color > SKINCOLOR_NONE && color < numskincolors)
+		R_GetTranslationColormap(skinnum, color, GTC_CACHE);
+	if (skin->prefcolor > SKINCOLOR_NONE && skin->prefcolor < numskincolors)
+		R_GetTranslationColormap(skinnum, skin->prefcolor, GTC_CACHE);
+
+	if (skin->flags & SF_SUPER)
+	{
+		for (supercolor = skin->supercolor; supercolor < skin->supercolor + 5 && supercolor < numskincolors; supercolor++)
+			R_GetTranslationColormap(skinnum, supercolor, GTC_CACHE);
 	}
+}
+
+/**	\brief	Rebuilds the cached colormaps of a skin.
+
+	Used when a skin's fields change, so that only that skin's colormaps
+	are regenerated. They are rebuilt in place, like in
+	R_RefreshTranslationColor.
+
+	\param	skinnum	number of skin
+*/
+void R_InvalidateSkinTranslationColormaps(INT32 skinnum)
+{
+	ttcacheentry_t *entry;
+	UINT32 i;
 
-	return ret;
+	for (i = 0; i < TT_CACHE_HASHSIZE; i++)
+		for (entry = ttcache[i]; entry; entry = entry->next)
+			if (entry->skinnum == skinnum)
+				R_GenerateTranslationColormap(entry->colormap, skinnum, entry->color);
 }
 
-/**	\brief	Flushes cache of translation colormaps.
+/**	\brief	Drops translation colormaps that have gone unused.
 
-	Flushes cache of translation colormaps, but doesn't actually free the
-	colormaps themselves. These are freed when PU_LEVEL blocks are purged,
-	at or before which point, this function should be called.
+	Must only be called where no pointer from R_GetTranslationColormap is
+	being held onto, which in practice means at level load. Colormaps that
+	weren't looked up during the last level are freed until the cache is
+	back under TT_CACHE_MAXENTRIES, oldest first; anything used during the
+	last level is kept regardless, since the next one likely needs it too.
 
 	\return	void
 */
-void R_FlushTranslationColormapCache(void)
+void R_TrimTranslationColormapCache(void)
 {
-	INT32 i;
+	ttcacheentry_t *entry, **link;
+	UINT32 oldest, i;
+
+	while (ttcacheentries > TT_CACHE_MAXENTRIES)
+	{
+		// Find the oldest level anything was last used in
+		oldest = ttcachelevel;
+		for (i = 0; i < TT_CACHE_HASHSIZE; i++)
+			for (entry = ttcache[i]; entry; entry = entry->next)
+				if (entry->lastused < oldest)
+					oldest = entry->lastused;
+
+		if (oldest == ttcachelevel)
+			break;
+
+		// Unlink everything from that level
+		for (i = 0; i < MAXSKINCOLORS; i++)
+		{
+			for (link = &ttcachebycolor[i]; *link;)
+			{
+				if ((*link)->lastused == oldest)
+					*link = (*link)->colornext;
+				else
+					link = &(*link)->colornext;
+			}
+		}
+
+		for (i = 0; i < TT_CACHE_HASHSIZE; i++)
+		{
+			for (link = &ttcache[i]; *link;)
+			{
+				entry = *link;
+				if (entry->lastused == oldest)
+				{
+					*link = entry->next;
+					Z_Free(entry->colormap);
+					Z_Free(entry);
+					ttcacheentries--;
+				}
+				else
+					link = &entry->next;
+			}
+		}
+	}
 
-	for (i = 0; i < (INT32)(sizeof(translationtablecache) / sizeof(translationtablecache[0])); i++)
-		if (translationtablecache[i])
-			memset(translationtablecache[i], 0, MAXSKINCOLORS * sizeof(UINT8**));
+	ttcachelevel++;
 }
 
 UINT16 R_GetColorByName(const char *name)
@@ -886,7 +1007,7 @@ void R_DrawViewBorder(void)
 
 // R_CalcTiltedLighting
 // Exactly what it says on the tin. I wish I wasn't too lazy to explain things properly.
-static INT32 tiltlighting[MAXVIDWIDTH];
+static R_THREADLOCAL INT32 tiltlighting[MAXVIDWIDTH];
 
 static void R_CalcTiltedLighting(fixed_t start, fixed_t end)
 {
@@ -923,6 +1044,7 @@ static void R_CalcTiltedLighting(fixed_t start, fixed_t end)
 
 #include "r_draw8.c"
 #include "r_draw8_npo2.c"
+#include "r_draw8_simd.c"
 
 // ==========================================================================
 //                   INCLUDE 16bpp DRAWING CODE HERE
@@ -15,11 +15,12 @@
 #define __R_DRAW__
 
 #include "r_defs.h"
+#include "r_threads.h"
 
 // -------------------------------
 // COMMON STUFF FOR 8bpp AND 16bpp
 // -------------------------------
-extern UINT8 *ylookup[MAXVIDHEIGHT*4];
+extern R_THREADLOCAL UINT8 *ylookup[MAXVIDHEIGHT*4];
 extern UINT8 *ylookup1[MAXVIDHEIGHT*4];
 extern UINT8 *ylookup2[MAXVIDHEIGHT*4];
 extern INT32 columnofs[MAXVIDWIDTH*4];
@@ -29,42 +30,42 @@ extern UINT8 *topleft;
 // COLUMN DRAWING CODE STUFF
 // -------------------------
 
-extern lighttable_t *dc_colormap;
-extern INT32 dc_x, dc_yl, dc_yh;
-extern fixed_t dc_iscale, dc_texturemid;
-extern UINT8 dc_hires;
+extern R_THREADLOCAL lighttable_t *dc_colormap;
+extern R_THREADLOCAL INT32 dc_x, dc_yl, dc_yh;
+extern R_THREADLOCAL fixed_t dc_iscale, dc_texturemid;
+extern R_THREADLOCAL UINT8 dc_hires;
 
-extern UINT8 *dc_source; // first pixel in a column
+extern R_THREADLOCAL UINT8 *dc_source; // first pixel in a column
 
 // translucency stuff here
-extern UINT8 *dc_transmap;
+extern R_THREADLOCAL UINT8 *dc_transmap;
 
 // translation stuff here
 
-extern UINT8 *dc_translation;
+extern R_THREADLOCAL UINT8 *dc_translation;
 
 extern struct r_lightlist_s *dc_lightlist;
 extern INT32 dc_numlights, dc_maxlights;
 
 //Fix TUTIFRUTI
-extern INT32 dc_texheight;
+extern R_THREADLOCAL INT32 dc_texheight;
 
 // -----------------------
 // SPAN DRAWING CODE STUFF
 // -----------------------
 
-extern INT32 ds_y, ds_x1, ds_x2;
-extern lighttable_t *ds_colormap;
-extern lighttable_t *ds_translation;
+extern R_THREADLOCAL INT32 ds_y, ds_x1, ds_x2;
+extern R_THREADLOCAL lighttable_t *ds_colormap;
+extern R_THREADLOCAL lighttable_t *ds_translation;
 
-extern fixed_t ds_xfrac, ds_yfrac, ds_xstep, ds_ystep;
-extern INT32 ds_waterofs, ds_bgofs;
+extern R_THREADLOCAL fixed_t ds_xfrac, ds_yfrac, ds_xstep, ds_ystep;
+extern R_THREADLOCAL INT32 ds_waterofs, ds_bgofs;
 
-extern UINT16 ds_flatwidth, ds_flatheight;
-extern boolean ds_powersoftwo, ds_solidcolor;
+extern R_THREADLOCAL UINT16 ds_flatwidth, ds_flatheight;
+extern R_THREADLOCAL boolean ds_powersoftwo, ds_solidcolor;
 
-extern UINT8 *ds_source;
-extern UINT8 *ds_transmap;
+extern R_THREADLOCAL UINT8 *ds_source;
+extern R_THREADLOCAL UINT8 *ds_transmap;
 
 typedef struct {
 	float x, y, z;
@@ -72,14 +73,15 @@ typedef struct {
 
 // Vectors for Software's tilted slope drawers
 extern floatv3_t *ds_su, *ds_sv, *ds_sz;
-extern floatv3_t *ds_sup, *ds_svp, *ds_szp;
-extern float focallengthf, zeroheight;
+extern R_THREADLOCAL floatv3_t *ds_sup, *ds_svp, *ds_szp;
+extern float focallengthf;
+extern R_THREADLOCAL float zeroheight;
 
 // Variable flat sizes
-extern UINT32 nflatxshift;
-extern UINT32 nflatyshift;
-extern UINT32 nflatshiftup;
-extern UINT32 nflatmask;
+extern R_THREADLOCAL UINT32 nflatxshift;
+extern R_THREADLOCAL UINT32 nflatyshift;
+extern R_THREADLOCAL UINT32 nflatshiftup;
+extern R_THREADLOCAL UINT32 nflatmask;
 
 /// \brief Top border
 #define BRDR_T 0
@@ -121,7 +123,9 @@ enum
 // Custom player skin translation
 // Initialize color translation tables, for player rendering etc.
 UINT8* R_GetTranslationColormap(INT32 skinnum, skincolornum_t color, UINT8 flags);
-void R_FlushTranslationColormapCache(void);
+void R_PrecacheTranslationColormaps(INT32 skinnum, UINT16 color);
+void R_InvalidateSkinTranslationColormaps(INT32 skinnum);
+void R_TrimTranslationColormapCache(void);
 UINT16 R_GetColorByName(const char *name);
 UINT16 R_GetSuperColorByName(const char *name);
 
@@ -225,6 +229,22 @@ void R_DrawTiltedTransSolidColorSpan_8(void);
 void R_DrawWaterSolidColorSpan_8(void);
 void R_DrawTiltedWaterSolidColorSpan_8(void);
 
+// SIMD versions of the above, picked by SCR_SetDrawFuncs when the CPU has them
+#if ((defined (__i386__) || defined (__x86_64__)) && (defined (__clang__) || (__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) \
+	|| defined (_M_IX86) || defined (_M_X64)
+#define HAVE_X86_DRAWERS
+void R_DrawColumn_8_AVX2(void);
+void R_DrawTranslucentColumn_8_AVX2(void);
+void R_DrawSpan_8_SSE2(void);
+void R_DrawSpan_8_AVX2(void);
+void R_DrawTranslucentSpan_8_SSE2(void);
+void R_DrawTranslucentSpan_8_AVX2(void);
+#elif defined (__aarch64__)
+#define HAVE_NEON_DRAWERS
+void R_DrawSpan_8_NEON(void);
+void R_DrawTranslucentSpan_8_NEON(void);
+#endif
+
 // ------------------
 // 16bpp DRAWING CODE
 // ------------------
@@ -0,0 +1,622 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 1999-2023 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  r_draw8_simd.c
+/// \brief SSE2, AVX2 and NEON versions of the most used 8bpp drawers
+/// \note  no includes because this is included as part of r_draw.c
+///
+///	Each of these has to draw exactly what its scalar original in r_draw8.c
+///	does, odd corners included: same early returns, same eight-pixel blocks
+///	followed by a bounds-checked tail, and the same wrapping arithmetic on
+///	texture coordinates. Only the lookups are done several at a time.
+
+#ifdef HAVE_X86_DRAWERS
+
+// ==========================================================================
+// SSE2
+// ==========================================================================
+// No gathers, so this only works out eight texel offsets at once and looks
+// them up one by one. It is still a good bit fewer instructions per pixel.
+
+#define SPANSETUP_SSE2 \
+	const __m128i xshift = _mm_cvtsi32_si128((int)nflatxshift); \
+	const __m128i yshift = _mm_cvtsi32_si128((int)nflatyshift); \
+	const __m128i mask = _mm_set1_epi32((int)nflatmask); \
+	const __m128i xinc = _mm_set1_epi32((int)(xstep*8)); \
+	const __m128i yinc = _mm_set1_epi32((int)(ystep*8)); \
+	__m128i xpos0 = _mm_setr_epi32((int)xposition, (int)(xposition + xstep), (int)(xposition + xstep*2), (int)(xposition + xstep*3)); \
+	__m128i ypos0 = _mm_setr_epi32((int)yposition, (int)(yposition + ystep), (int)(yposition + ystep*2), (int)(yposition + ystep*3)); \
+	__m128i xpos1 = _mm_add_epi32(xpos0, _mm_set1_epi32((int)(xstep*4))); \
+	__m128i ypos1 = _mm_add_epi32(ypos0, _mm_set1_epi32((int)(ystep*4))); \
+	UINT32 spot[8];
+
+#define SPANSPOTS_SSE2 \
+	_mm_storeu_si128((__m128i *)&spot[0], _mm_or_si128(_mm_and_si128(_mm_srl_epi32(ypos0, yshift), mask), _mm_srl_epi32(xpos0, xshift))); \
+	_mm_storeu_si128((__m128i *)&spot[4], _mm_or_si128(_mm_and_si128(_mm_srl_epi32(ypos1, yshift), mask), _mm_srl_epi32(xpos1, xshift))); \
+	xpos0 = _mm_add_epi32(xpos0, xinc); xpos1 = _mm_add_epi32(xpos1, xinc); \
+	ypos0 = _mm_add_epi32(ypos0, yinc); ypos1 = _mm_add_epi32(ypos1, yinc); \
+	xposition += xstep*8; \
+	yposition += ystep*8;
+
+/**	\brief The R_DrawSpan_8_SSE2 function
+	R_DrawSpan_8 with the texel offsets worked out eight at a time.
+*/
+FUNCTARGET("sse2") void R_DrawSpan_8_SSE2(void)
+{
+	UINT32 xposition = (UINT32)ds_xfrac << nflatshiftup;
+	UINT32 yposition = (UINT32)ds_yfrac << nflatshiftup;
+	UINT32 xstep = (UINT32)ds_xstep << nflatshiftup;
+	UINT32 ystep = (UINT32)ds_ystep << nflatshiftup;
+
+	const UINT8 *source = ds_source;
+	const UINT8 *colormap = ds_colormap;
+	UINT8 *dest = ylookup[ds_y] + columnofs[ds_x1];
+	const UINT8 *deststop = screens[0] + vid.rowbytes * vid.height;
+
+	size_t count = (ds_x2 - ds_x1 + 1);
+
+	if (dest+8 > deststop)
+		return;
+
+	if (count >= 8)
+	{
+		SPANSETUP_SSE2
+
+		do
+		{
+			SPANSPOTS_SSE2
+
+			dest[0] = colormap[source[spot[0]]];
+			dest[1] = colormap[source[spot[1]]];
+			dest[2] = colormap[source[spot[2]]];
+			dest[3] = colormap[source[spot[3]]];
+			dest[4] = colormap[source[spot[4]]];
+			dest[5] = colormap[source[spot[5]]];
+			dest[6] = colormap[source[spot[6]]];
+			dest[7] = colormap[source[spot[7]]];
+
+			dest += 8;
+			count -= 8;
+		} while (count >= 8);
+	}
+
+	while (count-- && dest <= deststop)
+	{
+		*dest++ = colormap[source[((yposition >> nflatyshift) & nflatmask) | (xposition >> nflatxshift)]];
+		xposition += xstep;
+		yposition += ystep;
+	}
+}
+
+/**	\brief The R_DrawTranslucentSpan_8_SSE2 function
+	R_DrawTranslucentSpan_8 with the texel offsets worked out eight at a time.
+*/
+FUNCTARGET("sse2") void R_DrawTranslucentSpan_8_SSE2(void)
+{
+	UINT32 xposition = (UINT32)ds_xfrac << nflatshiftup;
+	UINT32 yposition = (UINT32)ds_yfrac << nflatshiftup;
+	UINT32 xstep = (UINT32)ds_xstep << nflatshiftup;
+	UINT32 ystep = (UINT32)ds_ystep << nflatshiftup;
+
+	const UINT8 *source = ds_source;
+	const UINT8 *colormap = ds_colormap;
+	const UINT8 *transmap = ds_transmap;
+	UINT8 *dest = ylookup[ds_y] + columnofs[ds_x1];
+	const UINT8 *deststop = screens[0] + vid.rowbytes * vid.height;
+
+	size_t count = (ds_x2 - ds_x1 + 1);
+
+	if (count >= 8)
+	{
+		SPANSETUP_SSE2
+
+		do
+		{
+			SPANSPOTS_SSE2
+
+			dest[0] = *(transmap + (colormap[source[spot[0]]] << 8) + dest[0]);
+			dest[1] = *(transmap + (colormap[source[spot[1]]] << 8) + dest[1]);
+			dest[2] = *(transmap + (colormap[source[spot[2]]] << 8) + dest[2]);
+			dest[3] = *(transmap + (colormap[source[spot[3]]] << 8) + dest[3]);
+			dest[4] = *(transmap + (colormap[source[spot[4]]] << 8) + dest[4]);
+			dest[5] = *(transmap + (colormap[source[spot[5]]] << 8) + dest[5]);
+			dest[6] = *(transmap + (colormap[source[spot[6]]] << 8) + dest[6]);
+			dest[7] = *(transmap + (colormap[source[spot[7]]] << 8) + dest[7]);
+
+			dest += 8;
+			count -= 8;
+		} while (count >= 8);
+	}
+
+	while (count-- && dest <= deststop)
+	{
+		*dest = *(transmap + (colormap[source[((yposition >> nflatyshift) & nflatmask) | (xposition >> nflatxshift)]] << 8) + *dest);
+		dest++;
+		xposition += xstep;
+		yposition += ystep;
+	}
+}
+
+#undef SPANSETUP_SSE2
+#undef SPANSPOTS_SSE2
+
+// ==========================================================================
+// AVX2
+// ==========================================================================
+
+// Fetches base[index] for eight indices. Gathers read whole dwords, so
+// each byte is read as part of the aligned dword it sits in: that never
+// strays into a page the byte itself isn't on, unlike base+index+3 would.
+static FUNCTARGET("avx2") inline __m256i R_GatherBytes_AVX2(const UINT8 *base, __m256i index)
+{
+	const __m256i three = _mm256_set1_epi32(3);
+	const int misalign = (int)((size_t)base & 3);
+	__m256i ofs = _mm256_add_epi32(index, _mm256_set1_epi32(misalign));
+	__m256i dwords = _mm256_i32gather_epi32((const int *)(const void *)(base - misalign), _mm256_andnot_si256(three, ofs), 1);
+	__m256i shift = _mm256_slli_epi32(_mm256_and_si256(ofs, three), 3);
+	return _mm256_and_si256(_mm256_srlv_epi32(dwords, shift), _mm256_set1_epi32(0xFF));
+}
+
+// Narrows eight dwords holding bytes down to eight bytes in the low half
+static FUNCTARGET("avx2") inline __m128i R_PackBytes_AVX2(__m256i v)
+{
+	__m128i words = _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+	return _mm_packus_epi16(words, words);
+}
+
+#define SPANSETUP_AVX2 \
+	const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7); \
+	const __m128i xshift = _mm_cvtsi32_si128((int)nflatxshift); \
+	const __m128i yshift = _mm_cvtsi32_si128((int)nflatyshift); \
+	const __m256i mask = _mm256_set1_epi32((int)nflatmask); \
+	const __m256i xinc = _mm256_set1_epi32((int)(xstep*8)); \
+	const __m256i yinc = _mm256_set1_epi32((int)(ystep*8)); \
+	__m256i xpos = _mm256_add_epi32(_mm256_set1_epi32((int)xposition), _mm256_mullo_epi32(lane, _mm256_set1_epi32((int)xstep))); \
+	__m256i ypos = _mm256_add_epi32(_mm256_set1_epi32((int)yposition), _mm256_mullo_epi32(lane, _mm256_set1_epi32((int)ystep))); \
+	__m256i spot;
+
+#define SPANSPOT_AVX2 \
+	spot = _mm256_or_si256(_mm256_and_si256(_mm256_srl_epi32(ypos, yshift), mask), _mm256_srl_epi32(xpos, xshift)); \
+	xpos = _mm256_add_epi32(xpos, xinc); \
+	ypos = _mm256_add_epi32(ypos, yinc); \
+	xposition += xstep*8; \
+	yposition += ystep*8;
+
+/**	\brief The R_DrawSpan_8_AVX2 function
+	R_DrawSpan_8, eight pixels at a time with gathered lookups.
+*/
+FUNCTARGET("avx2") void R_DrawSpan_8_AVX2(void)
+{
+	UINT32 xposition = (UINT32)ds_xfrac << nflatshiftup;
+	UINT32 yposition = (UINT32)ds_yfrac << nflatshiftup;
+	UINT32 xstep = (UINT32)ds_xstep << nflatshiftup;
+	UINT32 ystep = (UINT32)ds_ystep << nflatshiftup;
+
+	const UINT8 *source = ds_source;
+	const UINT8 *colormap = ds_colormap;
+	UINT8 *dest = ylookup[ds_y] + columnofs[ds_x1];
+	const UINT8 *deststop = screens[0] + vid.rowbytes * vid.height;
+
+	size_t count = (ds_x2 - ds_x1 + 1);
+
+	if (dest+8 > deststop)
+		return;
+
+	if (count >= 8)
+	{
+		SPANSETUP_AVX2
+
+		do
+		{
+			SPANSPOT_AVX2
+			_mm_storel_epi64((__m128i *)(void *)dest,
+				R_PackBytes_AVX2(R_GatherBytes_AVX2(colormap, R_GatherBytes_AVX2(source, spot))));
+
+			dest += 8;
+			count -= 8;
+		} while (count >= 8);
+	}
+
+	while (count-- && dest <= deststop)
+	{
+		*dest++ = colormap[source[((yposition >> nflatyshift) & nflatmask) | (xposition >> nflatxshift)]];
+		xposition += xstep;
+		yposition += ystep;
+	}
+}
+
+/**	\brief The R_DrawTranslucentSpan_8_AVX2 function
+	R_DrawTranslucentSpan_8, eight pixels at a time with gathered lookups.
+*/
+FUNCTARGET("avx2") void R_DrawTranslucentSpan_8_AVX2(void)
+{
+	UINT32 xposition = (UINT32)ds_xfrac << nflatshiftup;
+	UINT32 yposition = (UINT32)ds_yfrac << nflatshiftup;
+	UINT32 xstep = (UINT32)ds_xstep << nflatshiftup;
+	UINT32 ystep = (UINT32)ds_ystep << nflatshiftup;
+
+	const UINT8 *source = ds_source;
+	const UINT8 *colormap = ds_colormap;
+	const UINT8 *transmap = ds_transmap;
+	UINT8 *dest = ylookup[ds_y] + columnofs[ds_x1];
+	const UINT8 *deststop = screens[0] + vid.rowbytes * vid.height;
+
+	size_t count = (ds_x2 - ds_x1 + 1);
+
+	if (count >= 8)
+	{
+		SPANSETUP_AVX2
+
+		do
+		{
+			__m256i color, under;
+
+			SPANSPOT_AVX2
+			color = R_GatherBytes_AVX2(colormap, R_GatherBytes_AVX2(source, spot));
+			under = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(const void *)dest));
+			_mm_storel_epi64((__m128i *)(void *)dest,
+				R_PackBytes_AVX2(R_GatherBytes_AVX2(transmap, _mm256_or_si256(_mm256_slli_epi32(color, 8), under))));
+
+			dest += 8;
+			count -= 8;
+		} while (count >= 8);
+	}
+
+	while (count-- && dest <= deststop)
+	{
+		*dest = *(transmap + (colormap[source[((yposition >> nflatyshift) & nflatmask) | (xposition >> nflatxshift)]] << 8) + *dest);
+		dest++;
+		xposition += xstep;
+		yposition += ystep;
+	}
+}
+
+#undef SPANSETUP_AVX2
+#undef SPANSPOT_AVX2
+
+// Columns step down the screen, so the results are written out one byte
+// at a time; the lookups are still done eight at once. Textures that
+// aren't a power of two tall keep their wrapping loop in the originals.
+
+/**	\brief The R_DrawColumn_8_AVX2 function
+	R_DrawColumn_8, eight pixels at a time with gathered lookups.
+*/
+FUNCTARGET("avx2") void R_DrawColumn_8_AVX2(void)
+{
+	INT32 count, heightmask;
+	UINT8 *dest;
+	fixed_t frac, fracstep;
+	const UINT8 *source;
+	const lighttable_t *colormap;
+
+	count = dc_yh - dc_yl;
+
+	if (count < 0) // Zero length, column does not exceed a pixel.
+		return;
+
+#ifdef RANGECHECK
+	if ((unsigned)dc_x >= (unsigned)vid.width || dc_yl < 0 || dc_yh >= vid.height)
+		return;
+#endif
+
+	heightmask = dc_texheight-1;
+	if (dc_texheight & heightmask)
+	{
+		R_DrawColumn_8();
+		return;
+	}
+
+	dest = &topleft[dc_yl*vid.width + dc_x];
+	count++;
+
+	fracstep = dc_iscale;
+	frac = (dc_texturemid + FixedMul((dc_yl << FRACBITS) - centeryfrac, fracstep))*(!dc_hires);
+
+	source = dc_source;
+	colormap = dc_colormap;
+
+	if (count >= 8)
+	{
+		const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		const __m256i mask = _mm256_set1_epi32(heightmask);
+		const __m256i fracinc = _mm256_set1_epi32((INT32)((UINT32)fracstep*8));
+		__m256i fracs = _mm256_add_epi32(_mm256_set1_epi32(frac), _mm256_mullo_epi32(lane, _mm256_set1_epi32(fracstep)));
+		const INT32 width = vid.width;
+		UINT8 pixels[16];
+
+		do
+		{
+			__m256i spot = _mm256_and_si256(_mm256_srai_epi32(fracs, FRACBITS), mask);
+			_mm_storeu_si128((__m128i *)(void *)pixels,
+				R_PackBytes_AVX2(R_GatherBytes_AVX2(colormap, R_GatherBytes_AVX2(source, spot))));
+
+			dest[0]       = pixels[0];
+			dest[width]   = pixels[1];
+			dest[width*2] = pixels[2];
+			dest[width*3] = pixels[3];
+			dest[width*4] = pixels[4];
+			dest[width*5] = pixels[5];
+			dest[width*6] = pixels[6];
+			dest[width*7] = pixels[7];
+
+			fracs = _mm256_add_epi32(fracs, fracinc);
+			frac = (fixed_t)((UINT32)frac + (UINT32)fracstep*8);
+			dest += width*8;
+			count -= 8;
+		} while (count >= 8);
+	}
+
+	while (count--)
+	{
+		*dest = colormap[source[(frac>>FRACBITS) & heightmask]];
+		dest += vid.width;
+		frac = (fixed_t)((UINT32)frac + (UINT32)fracstep);
+	}
+}
+
+/**	\brief The R_DrawTranslucentColumn_8_AVX2 function
+	R_DrawTranslucentColumn_8, eight pixels at a time with gathered lookups.
+*/
+FUNCTARGET("avx2") void R_DrawTranslucentColumn_8_AVX2(void)
+{
+	INT32 count, heightmask;
+	UINT8 *dest;
+	fixed_t frac, fracstep;
+	const UINT8 *source, *transmap;
+	const lighttable_t *colormap;
+
+	count = dc_yh - dc_yl + 1;
+
+	if (count <= 0) // Zero length, column does not exceed a pixel.
+		return;
+
+#ifdef RANGECHECK
+	if ((unsigned)dc_x >= (unsigned)vid.width || dc_yl < 0 || dc_yh >= vid.height)
+		I_Error("R_DrawTranslucentColumn_8_AVX2: %d to %d at %d", dc_yl, dc_yh, dc_x);
+#endif
+
+	heightmask = dc_texheight-1;
+	if (dc_texheight & heightmask)
+	{
+		R_DrawTranslucentColumn_8();
+		return;
+	}
+
+	dest = &topleft[dc_yl*vid.width + dc_x];
+
+	fracstep = dc_iscale;
+	frac = (dc_texturemid + FixedMul((dc_yl << FRACBITS) - centeryfrac, fracstep))*(!dc_hires);
+
+	source = dc_source;
+	transmap = dc_transmap;
+	colormap = dc_colormap;
+
+	if (count >= 8)
+	{
+		const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		const __m256i mask = _mm256_set1_epi32(heightmask);
+		const __m256i fracinc = _mm256_set1_epi32((INT32)((UINT32)fracstep*8));
+		const INT32 width = vid.width;
+		const __m256i rows = _mm256_mullo_epi32(lane, _mm256_set1_epi32(width));
+		__m256i fracs = _mm256_add_epi32(_mm256_set1_epi32(frac), _mm256_mullo_epi32(lane, _mm256_set1_epi32(fracstep)));
+		UINT8 pixels[16];
+
+		do
+		{
+			__m256i spot = _mm256_and_si256(_mm256_srai_epi32(fracs, FRACBITS), mask);
+			__m256i color = R_GatherBytes_AVX2(colormap, R_GatherBytes_AVX2(source, spot));
+			__m256i under = R_GatherBytes_AVX2(dest, rows);
+			_mm_storeu_si128((__m128i *)(void *)pixels,
+				R_PackBytes_AVX2(R_GatherBytes_AVX2(transmap, _mm256_or_si256(_mm256_slli_epi32(color, 8), under))));
+
+			dest[0]       = pixels[0];
+			dest[width]   = pixels[1];
+			dest[width*2] = pixels[2];
+			dest[width*3] = pixels[3];
+			dest[width*4] = pixels[4];
+			dest[width*5] = pixels[5];
+			dest[width*6] = pixels[6];
+			dest[width*7] = pixels[7];
+
+			fracs = _mm256_add_epi32(fracs, fracinc);
+			frac = (fixed_t)((UINT32)frac + (UINT32)fracstep*8);
+			dest += width*8;
+			count -= 8;
+		} while (count >= 8);
+	}
+
+	while (count--)
+	{
+		*dest = *(transmap + (colormap[source[(frac>>FRACBITS) & heightmask]]<<8) + (*dest));
+		dest += vid.width;
+		frac = (fixed_t)((UINT32)frac + (UINT32)fracstep);
+	}
+}
+
+#endif // HAVE_X86_DRAWERS
+
+#ifdef HAVE_NEON_DRAWERS
+
+// ==========================================================================
+// NEON
+// ==========================================================================
+// The texel offsets are worked out eight at a time, and for solid spans,
+// a whole 256-byte colormap is held in registers and looked up sixteen
+// pixels at a time with table lookups.
+
+#define SPANSETUP_NEON \
+	const int32x4_t xshift = vdupq_n_s32(-(INT32)nflatxshift); \
+	const int32x4_t yshift = vdupq_n_s32(-(INT32)nflatyshift); \
+	const uint32x4_t mask = vdupq_n_u32(nflatmask); \
+	const uint32x4_t xinc = vdupq_n_u32(xstep*8); \
+	const uint32x4_t yinc = vdupq_n_u32(ystep*8); \
+	const UINT32 xstart[4] = {xposition, xposition + xstep, xposition + xstep*2, xposition + xstep*3}; \
+	const UINT32 ystart[4] = {yposition, yposition + ystep, yposition + ystep*2, yposition + ystep*3}; \
+	uint32x4_t xpos0 = vld1q_u32(xstart); \
+	uint32x4_t ypos0 = vld1q_u32(ystart); \
+	uint32x4_t xpos1 = vaddq_u32(xpos0, vdupq_n_u32(xstep*4)); \
+	uint32x4_t ypos1 = vaddq_u32(ypos0, vdupq_n_u32(ystep*4)); \
+	UINT32 spot[8];
+
+#define SPANSPOTS_NEON \
+	vst1q_u32(&spot[0], vorrq_u32(vandq_u32(vshlq_u32(ypos0, yshift), mask), vshlq_u32(xpos0, xshift))); \
+	vst1q_u32(&spot[4], vorrq_u32(vandq_u32(vshlq_u32(ypos1, yshift), mask), vshlq_u32(xpos1, xshift))); \
+	xpos0 = vaddq_u32(xpos0, xinc); xpos1 = vaddq_u32(xpos1, xinc); \
+	ypos0 = vaddq_u32(ypos0, yinc); ypos1 = vaddq_u32(ypos1, yinc); \
+	xposition += xstep*8; \
+	yposition += ystep*8;
+
+// Looks sixteen bytes up in a 256-byte table held as four 64-byte quarters.
+// Out of range indices give zero, so exactly one quarter answers each one.
+static inline uint8x16_t R_Lookup256_NEON(const uint8x16x4_t *table, uint8x16_t index)
+{
+	uint8x16_t r = vqtbl4q_u8(table[0], index);
+	r = vorrq_u8(r, vqtbl4q_u8(table[1], vsubq_u8(index, vdupq_n_u8(64))));
+	r = vorrq_u8(r, vqtbl4q_u8(table[2], vsubq_u8(index, vdupq_n_u8(128))));
+	return vorrq_u8(r, vqtbl4q_u8(table[3], vsubq_u8(index, vdupq_n_u8(192))));
+}
+
+/**	\brief The R_DrawSpan_8_NEON function
+	R_DrawSpan_8 with the texel offsets worked out eight at a time.
+*/
+void R_DrawSpan_8_NEON(void)
+{
+	UINT32 xposition = (UINT32)ds_xfrac << nflatshiftup;
+	UINT32 yposition = (UINT32)ds_yfrac << nflatshiftup;
+	UINT32 xstep = (UINT32)ds_xstep << nflatshiftup;
+	UINT32 ystep = (UINT32)ds_ystep << nflatshiftup;
+
+	const UINT8 *source = ds_source;
+	const UINT8 *colormap = ds_colormap;
+	UINT8 *dest = ylookup[ds_y] + columnofs[ds_x1];
+	const UINT8 *deststop = screens[0] + vid.rowbytes * vid.height;
+
+	size_t count = (ds_x2 - ds_x1 + 1);
+
+	if (dest+8 > deststop)
+		return;
+
+	if (count >= 8)
+	{
+		SPANSETUP_NEON
+
+		if (count >= 32)
+		{
+			uint8x16x4_t table[4];
+			UINT8 texels[16];
+			INT32 i;
+
+			for (i = 0; i < 4; i++)
+			{
+				table[i].val[0] = vld1q_u8(colormap + i*64);
+				table[i].val[1] = vld1q_u8(colormap + i*64 + 16);
+				table[i].val[2] = vld1q_u8(colormap + i*64 + 32);
+				table[i].val[3] = vld1q_u8(colormap + i*64 + 48);
+			}
+
+			do
+			{
+				for (i = 0; i < 16; i += 8)
+				{
+					SPANSPOTS_NEON
+
+					texels[i]   = source[spot[0]];
+					texels[i+1] = source[spot[1]];
+					texels[i+2] = source[spot[2]];
+					texels[i+3] = source[spot[3]];
+					texels[i+4] = source[spot[4]];
+					texels[i+5] = source[spot[5]];
+					texels[i+6] = source[spot[6]];
+					texels[i+7] = source[spot[7]];
+				}
+				vst1q_u8(dest, R_Lookup256_NEON(table, vld1q_u8(texels)));
+
+				dest += 16;
+				count -= 16;
+			} while (count >= 16);
+		}
+
+		while (count >= 8)
+		{
+			SPANSPOTS_NEON
+
+			dest[0] = colormap[source[spot[0]]];
+			dest[1] = colormap[source[spot[1]]];
+			dest[2] = colormap[source[spot[2]]];
+			dest[3] = colormap[source[spot[3]]];
+			dest[4] = colormap[source[spot[4]]];
+			dest[5] = colormap[source[spot[5]]];
+			dest[6] = colormap[source[spot[6]]];
+			dest[7] = colormap[source[spot[7]]];
+
+			dest += 8;
+			count -= 8;
+		}
+	}
+
+	while (count-- && dest <= deststop)
+	{
+		*dest++ = colormap[source[((yposition >> nflatyshift) & nflatmask) | (xposition >> nflatxshift)]];
+		xposition += xstep;
+		yposition += ystep;
+	}
+}
+
+/**	\brief The R_DrawTranslucentSpan_8_NEON function
+	R_DrawTranslucentSpan_8 with the texel offsets worked out eight at a time.
+*/
+void R_DrawTranslucentSpan_8_NEON(void)
+{
+	UINT32 xposition = (UINT32)ds_xfrac << nflatshiftup;
+	UINT32 yposition = (UINT32)ds_yfrac << nflatshiftup;
+	UINT32 xstep = (UINT32)ds_xstep << nflatshiftup;
+	UINT32 ystep = (UINT32)ds_ystep << nflatshiftup;
+
+	const UINT8 *source = ds_source;
+	const UINT8 *colormap = ds_colormap;
+	const UINT8 *transmap = ds_transmap;
+	UINT8 *dest = ylookup[ds_y] + columnofs[ds_x1];
+	const UINT8 *deststop = screens[0] + vid.rowbytes * vid.height;
+
+	size_t count = (ds_x2 - ds_x1 + 1);
+
+	if (count >= 8)
+	{
+		SPANSETUP_NEON
+
+		do
+		{
+			SPANSPOTS_NEON
+
+			dest[0] = *(transmap + (colormap[source[spot[0]]] << 8) + dest[0]);
+			dest[1] = *(transmap + (colormap[source[spot[1]]] << 8) + dest[1]);
+			dest[2] = *(transmap + (colormap[source[spot[2]]] << 8) + dest[2]);
+			dest[3] = *(transmap + (colormap[source[spot[3]]] << 8) + dest[3]);
+			dest[4] = *(transmap + (colormap[source[spot[4]]] << 8) + dest[4]);
+			dest[5] = *(transmap + (colormap[source[spot[5]]] << 8) + dest[5]);
+			dest[6] = *(transmap + (colormap[source[spot[6]]] << 8) + dest[6]);
+			dest[7] = *(transmap + (colormap[source[spot[7]]] << 8) + dest[7]);
+
+			dest += 8;
+			count -= 8;
+		} while (count >= 8);
+	}
+
+	while (count-- && dest <= deststop)
+	{
+		*dest = *(transmap + (colormap[source[((yposition >> nflatyshift) & nflatmask) | (xposition >> nflatxshift)]] << 8) + *dest);
+		dest++;
+		xposition += xstep;
+		yposition += ystep;
+	}
+}
+
+#undef SPANSETUP_NEON
+#undef SPANSPOTS_NEON
+
+#endif // HAVE_NEON_DRAWERS
@@ -40,6 +40,7 @@ static CV_PossibleValue_t fpscap_cons_t[] = {
 	{0, NULL}
 };
 consvar_t cv_fpscap = CVAR_INIT ("fpscap", "Match refresh rate", CV_SAVE, fpscap_cons_t, NULL);
+consvar_t cv_interpsnapshot = CVAR_INIT ("interpsnapshot", "Off", CV_SAVE, CV_OnOff, NULL);
 
 ps_metric_t ps_interp_frac = {0};
 ps_metric_t ps_interp_lag = {0};
@@ -284,8 +285,73 @@ angle_t R_InterpolateAngle(angle_t from, angle_t to)
 	return (R_LerpAngle(from, to, rendertimefrac));
 }
 
+// Both ends of a mobj's interpolation, as they were at the end of the last tic.
+// Fields that the live path doesn't interpolate have from == to.
+typedef struct {
+	interpmobjstate_t from;
+	interpmobjstate_t to;
+} mobjsnapshot_t;
+
+// Double-buffered: the back buffer is filled at the end of a tic,
+// then swapped to the front for the renderer to read.
+static mobjsnapshot_t *mobjsnapshots[2] = {NULL, NULL};
+static size_t mobjsnapshots_capacity[2] = {0, 0};
+static UINT8 mobjsnapshot_front = 0;
+static UINT32 mobjsnapshot_gen = 0;
+
+static void R_LerpMobjSnapshot(const mobjsnapshot_t *snap, fixed_t frac, interpmobjstate_t *out)
+{
+	const interpmobjstate_t *from = &snap->from;
+	const interpmobjstate_t *to = &snap->to;
+
+	if (frac == FRACUNIT)
+	{
+		*out = *to;
+		return;
+	}
+
+	out->x = R_LerpFixed(from->x, to->x, frac);
+	out->y = R_LerpFixed(from->y, to->y, frac);
+	out->z = R_LerpFixed(from->z, to->z, frac);
+	out->spritexscale = R_LerpFixed(from->spritexscale, to->spritexscale, frac);
+	out->spriteyscale = R_LerpFixed(from->spriteyscale, to->spriteyscale, frac);
+
+	if (from->scale == to->scale)
+	{
+		out->scale = to->scale;
+		out->radius = to->radius;
+		out->height = to->height;
+	}
+	else
+	{
+		out->scale = R_LerpFixed(from->scale, to->scale, frac);
+		out->radius = FixedMul(to->radius, FixedDiv(out->scale, to->scale));
+		out->height = FixedMul(to->height, FixedDiv(out->scale, to->scale));
+	}
+
+	out->spritexoffset = to->spritexoffset;
+	out->spriteyoffset = to->spriteyoffset;
+
+	// Most mobjs don't move in a given tic, so skip the BSP walk for those
+	if (from->x == to->x && from->y == to->y)
+		out->subsector = to->subsector;
+	else
+		out->subsector = R_PointInSubsector(out->x, out->y);
+
+	out->angle = R_LerpAngle(from->angle, to->angle, frac);
+	out->pitch = R_LerpAngle(from->pitch, to->pitch, frac);
+	out->roll = R_LerpAngle(from->roll, to->roll, frac);
+	out->spriteroll = R_LerpAngle(from->spriteroll, to->spriteroll, frac);
+}
+
 void R_InterpolateMobjState(mobj_t *mobj, fixed_t frac, interpmobjstate_t *out)
 {
+	if (cv_interpsnapshot.value && mobj->snapshotgen != 0 && mobj->snapshotgen == mobjsnapshot_gen)
+	{
+		R_LerpMobjSnapshot(&mobjsnapshots[mobjsnapshot_front][mobj->snapshotslot], frac, out);
+		return;
+	}
+
 	if (frac == FRACUNIT)
 	{
 		out->x = mobj->x;
@@ -771,6 +837,11 @@ void R_InitMobjInterpolators(void)
 	interpolated_mobjs = NULL;
 	interpolated_mobjs_len = 0;
 	interpolated_mobjs_capacity = 0;
+
+	// The snapshots are PU_LEVEL too
+	mobjsnapshots[0] = mobjsnapshots[1] = NULL;
+	mobjsnapshots_capacity[0] = mobjsnapshots_capacity[1] = 0;
+	mobjsnapshot_gen++;
 }
 
 void R_UpdateMobjInterpolators(void)
@@ -784,6 +855,88 @@ void R_UpdateMobjInterpolators(void)
 	}
 }
 
+//
+// R_PublishMobjSnapshot
+//
+// Copy both ends of every interpolated mobj's state into the back
+// snapshot, then make it the one the renderer reads. Anything that
+// changes a mobj after this, up to the next tic, is not drawn until
+// that tic publishes again.
+//
+void R_PublishMobjSnapshot(void)
+{
+	UINT8 back = !mobjsnapshot_front;
+	mobjsnapshot_t *snap;
+	size_t i, len = 0;
+
+	if (!cv_interpsnapshot.value || rendermode == render_none)
+		return;
+
+	if (mobjsnapshots_capacity[back] < interpolated_mobjs_capacity)
+	{
+		mobjsnapshots_capacity[back] = interpolated_mobjs_capacity;
+		mobjsnapshots[back] = Z_Realloc(
+			mobjsnapshots[back],
+			sizeof(mobjsnapshot_t) * mobjsnapshots_capacity[back],
+			PU_LEVEL,
+			NULL
+		);
+	}
+
+	if (++mobjsnapshot_gen == 0) // never hand out 0, it means "not published"
+		mobjsnapshot_gen = 1;
+
+	for (i = 0; i < interpolated_mobjs_len; i++)
+	{
+		mobj_t *mobj = interpolated_mobjs[i];
+		interpmobjstate_t *from, *to;
+
+		if (P_MobjWasRemoved(mobj))
+			continue;
+
+		snap = &mobjsnapshots[back][len];
+		from = &snap->from;
+		to = &snap->to;
+
+		to->x = mobj->x;
+		to->y = mobj->y;
+		to->z = mobj->z;
+		to->subsector = mobj->subsector;
+		to->angle = mobj->player ? mobj->player->drawangle : mobj->angle;
+		to->pitch = mobj->pitch;
+		to->roll = mobj->roll;
+		to->spriteroll = mobj->spriteroll;
+		to->scale = mobj->scale;
+		to->radius = mobj->radius;
+		to->height = mobj->height;
+		to->spritexscale = mobj->spritexscale;
+		to->spriteyscale = mobj->spriteyscale;
+		to->spritexoffset = mobj->spritexoffset;
+		to->spriteyoffset = mobj->spriteyoffset;
+
+		*from = *to;
+		from->x = mobj->old_x;
+		from->y = mobj->old_y;
+		from->z = mobj->old_z;
+		from->scale = mobj->old_scale;
+
+		if (!mobj->resetinterp)
+		{
+			from->angle = mobj->player ? mobj->player->old_drawangle : mobj->old_angle;
+			from->pitch = mobj->old_pitch;
+			from->roll = mobj->old_roll;
+			from->spriteroll = mobj->old_spriteroll;
+			from->spritexscale = mobj->old_spritexscale;
+			from->spriteyscale = mobj->old_spriteyscale;
+		}
+
+		mobj->snapshotgen = mobjsnapshot_gen;
+		mobj->snapshotslot = len++;
+	}
+
+	mobjsnapshot_front = back;
+}
+
 //
 // P_ResetMobjInterpolationState
 //
@@ -823,6 +976,7 @@ void R_ResetMobjInterpolationState(mobj_t *mobj)
 	}
 
 	mobj->resetinterp = false;
+	mobj->snapshotgen = 0; // the published snapshot is stale for this mobj now
 }
 
 //
@@ -20,7 +20,7 @@
 #include "r_state.h"
 #include "m_perfstats.h" // ps_metric_t
 
-extern consvar_t cv_fpscap;
+extern consvar_t cv_fpscap, cv_interpsnapshot;
 
 extern ps_metric_t ps_interp_frac;
 extern ps_metric_t ps_interp_lag;
@@ -163,5 +163,7 @@ void R_RemoveMobjInterpolator(mobj_t *mobj);
 void R_UpdateMobjInterpolators(void);
 void R_ResetMobjInterpolationState(mobj_t *mobj);
 void R_ResetPrecipitationMobjInterpolationState(precipmobj_t *mobj);
+// Publish the interpolation states of every interpolated mobj for the renderer. Call once at the end of each real tic.
+void R_PublishMobjSnapshot(void);
 
 #endif
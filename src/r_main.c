@@ -107,12 +107,25 @@ ps_metric_t ps_sw_spritecliptime = {0};
 ps_metric_t ps_sw_portaltime = {0};
 ps_metric_t ps_sw_planetime = {0};
 ps_metric_t ps_sw_maskedtime = {0};
+ps_metric_t ps_sw_drawqueuetime = {0};
 
 ps_metric_t ps_numbspcalls = {0};
 ps_metric_t ps_numsprites = {0};
 ps_metric_t ps_numdrawnodes = {0};
 ps_metric_t ps_numpolyobjects = {0};
 
+ps_metric_t ps_sw_numvisplanes = {0};
+ps_metric_t ps_sw_planeprobes = {0};
+ps_metric_t ps_sw_maxplaneprobe = {0};
+
+ps_metric_t ps_sw_spritesvisited = {0};
+ps_metric_t ps_sw_spritesculled = {0};
+ps_metric_t ps_sw_spritesprojected = {0};
+
+ps_metric_t ps_sw_numdrawcmds = {0};
+ps_metric_t ps_sw_numdrawtiles = {0};
+ps_metric_t ps_sw_numdrawbinned = {0};
+
 static CV_PossibleValue_t drawdist_cons_t[] = {
 	{256, "256"},	{512, "512"},	{768, "768"},
 	{1024, "1024"},	{1536, "1536"},	{2048, "2048"},
@@ -1450,6 +1463,22 @@ void R_RenderPlayerView(player_t *player)
 			V_DrawFill(0, 0, BASEVIDWIDTH, BASEVIDHEIGHT, 32+(timeinmap&15));
 	}
 
+#ifdef HAVE_RENDERTHREADS
+	if (R_CheckDeferredDraws(player))
+	{
+		free(masks);
+		return;
+	}
+#endif
+
+	PS_TRACE_BEGIN("R_RenderPlayerView");
+
+	R_TrimTextureCache();
+
+#ifdef HAVE_RENDERTHREADS
+	R_BeginThreadedDraws();
+#endif
+
 	R_SetupFrame(player);
 	framecount++;
 	validcount++;
@@ -1483,14 +1512,19 @@ void R_RenderPlayerView(player_t *player)
 	Mask_Pre(&masks[nummasks - 1]);
 	curdrawsegs = ds_p;
 	ps_numbspcalls.value.i = ps_numpolyobjects.value.i = ps_numdrawnodes.value.i = 0;
+	ps_sw_spritesvisited.value.i = ps_sw_spritesculled.value.i = ps_sw_spritesprojected.value.i = 0;
+	PS_TRACE_BEGIN("R_RenderBSPNode");
 	PS_START_TIMING(ps_bsptime);
 	R_RenderBSPNode((INT32)numnodes - 1);
 	PS_STOP_TIMING(ps_bsptime);
+	PS_TRACE_END();
 	Mask_Post(&masks[nummasks - 1]);
 
+	PS_TRACE_BEGIN("R_ClipSprites");
 	PS_START_TIMING(ps_sw_spritecliptime);
 	R_ClipSprites(drawsegs, NULL);
 	PS_STOP_TIMING(ps_sw_spritecliptime);
+	PS_TRACE_END();
 
 	ps_numsprites.value.i = numvisiblesprites;
 
@@ -1499,6 +1533,7 @@ void R_RenderPlayerView(player_t *player)
 		Portal_AddSkyboxPortals();
 
 	// Portal rendering. Hijacks the BSP traversal.
+	PS_TRACE_BEGIN("Portals");
 	PS_START_TIMING(ps_sw_portaltime);
 	if (portal_base)
 	{
@@ -1540,18 +1575,29 @@ void R_RenderPlayerView(player_t *player)
 		}
 	}
 	PS_STOP_TIMING(ps_sw_portaltime);
+	PS_TRACE_END();
 
+	PS_TRACE_BEGIN("R_DrawPlanes");
 	PS_START_TIMING(ps_sw_planetime);
 	R_DrawPlanes();
 	PS_STOP_TIMING(ps_sw_planetime);
+	PS_TRACE_END();
 
 	// draw mid texture and sprite
 	// And now 3D floors/sides!
+	PS_TRACE_BEGIN("R_DrawMasked");
 	PS_START_TIMING(ps_sw_maskedtime);
 	R_DrawMasked(masks, nummasks);
 	PS_STOP_TIMING(ps_sw_maskedtime);
+	PS_TRACE_END();
 
 	free(masks);
+
+#ifdef HAVE_RENDERTHREADS
+	R_EndThreadedDraws();
+#endif
+
+	PS_TRACE_END();
 }
 
 // =========================================================================
@@ -1584,6 +1630,14 @@ void R_RegisterEngineStuff(void)
 	CV_RegisterVar(&cv_skybox);
 	CV_RegisterVar(&cv_ffloorclip);
 	CV_RegisterVar(&cv_spriteclip);
+	CV_RegisterVar(&cv_texturecachesize);
+	CV_RegisterVar(&cv_pngcachesize);
+	COM_AddCommand("texturecache", Command_TextureCache_f, COM_LUA);
+#ifdef HAVE_RENDERTHREADS
+	CV_RegisterVar(&cv_renderthreads);
+	CV_RegisterVar(&cv_deferreddraws);
+	COM_AddCommand("r_checkdeferred", Command_CheckDeferred_f, 0);
+#endif
 
 	CV_RegisterVar(&cv_cam_dist);
 	CV_RegisterVar(&cv_cam_still);
@@ -1624,4 +1678,5 @@ void R_RegisterEngineStuff(void)
 
 	// Frame interpolation/uncapped
 	CV_RegisterVar(&cv_fpscap);
+	CV_RegisterVar(&cv_interpsnapshot);
 }
@@ -98,12 +98,25 @@ extern ps_metric_t ps_sw_spritecliptime;
 extern ps_metric_t ps_sw_portaltime;
 extern ps_metric_t ps_sw_planetime;
 extern ps_metric_t ps_sw_maskedtime;
+extern ps_metric_t ps_sw_drawqueuetime;
 
 extern ps_metric_t ps_numbspcalls;
 extern ps_metric_t ps_numsprites;
 extern ps_metric_t ps_numdrawnodes;
 extern ps_metric_t ps_numpolyobjects;
 
+extern ps_metric_t ps_sw_numvisplanes;
+extern ps_metric_t ps_sw_planeprobes;
+extern ps_metric_t ps_sw_maxplaneprobe;
+
+extern ps_metric_t ps_sw_spritesvisited;
+extern ps_metric_t ps_sw_spritesculled;
+extern ps_metric_t ps_sw_spritesprojected;
+
+extern ps_metric_t ps_sw_numdrawcmds;
+extern ps_metric_t ps_sw_numdrawtiles;
+extern ps_metric_t ps_sw_numdrawbinned;
+
 //
 // REFRESH - the actual rendering functions.
 //
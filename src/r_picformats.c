@@ -24,6 +24,11 @@
 #include "v_video.h"
 #include "z_zone.h"
 #include "w_wad.h"
+#include "d_main.h" // srb2home
+#include "i_system.h" // I_mkdir
+#include "m_argv.h"
+#include "md5.h"
+#include "filesrch.h" // foreachfile
 
 #ifdef HWRENDER
 #include "hardware/hw_glob.h"
@@ -53,6 +58,11 @@
 
 static unsigned char imgbuf[1<<26];
 
+// Converted PNGs kept on disk past this many megabytes are pruned at
+// startup, oldest first
+static CV_PossibleValue_t pngcachesize_cons_t[] = {{0, "MIN"}, {65536, "MAX"}, {0, NULL}};
+consvar_t cv_pngcachesize = CVAR_INIT ("r_pngcachesize", "256", CV_SAVE, pngcachesize_cons_t, NULL);
+
 #ifdef PICTURE_PNG_USELOOKUP
 static colorlookup_t png_colorlookup;
 #endif
@@ -1064,7 +1074,296 @@ static png_bytep *PNG_Read(
 	return row_pointers;
 }
 
+// --------------------------
+// Converted PNG cache
+// --------------------------
+// Every converted picture is saved under srb2home/pngcache, named after
+// the MD5 of its PNG, the palette it was matched against and the output
+// format. The PNG and palette sums are kept in the file too, along with
+// one of the converted data, so a stale or damaged entry is never used.
+// The oldest entries are pruned at startup to keep it in r_pngcachesize.
+
+#ifndef NOMD5
+#define PNGCACHE_DIR "pngcache"
+#define PNGCACHE_MAGIC "SRB2PNGC"
+#define PNGCACHE_VERSION 1
+
+// magic, version, png size, png sum, palette sum, format, flags,
+// width, height, offsets, data size, data sum
+#define PNGCACHE_HEADERSIZE (8 + 4 + 4 + 16 + 16 + 4 + 4 + 4 + 4 + 2 + 2 + 4 + 16)
+
+typedef struct
+{
+	boolean valid;
+	UINT8 pngsum[16];
+	UINT8 palsum[16];
+	UINT32 pngsize;
+	UINT32 format;
+	UINT32 flags;
+	char path[256];
+} pngcachekey_t;
+
+static boolean PNGCache_Enabled(void)
+{
+	static INT32 enabled = -1;
+	if (enabled == -1)
+		enabled = (!M_CheckParm("-nopngcache") && !dedicated);
+	return (boolean)enabled;
+}
+
+static boolean PNGCache_MakeKey(pngcachekey_t *key, const UINT8 *png, size_t insize, pictureformat_t outformat, pictureflags_t flags)
+{
+	RGBA_t palettes[512];
+	UINT8 keydata[16 + 16 + 4 + 4], keysum[16];
+	UINT8 *kp = keydata;
+	char *p;
+	INT32 i;
+
+	key->valid = false;
+
+	// Only formats that don't hold pointers can be written out as they are.
+	if (!PNGCache_Enabled() || Picture_IsInternalPatchFormat(outformat) || insize > UINT32_MAX)
+		return false;
+
+	md5_buffer((const char *)png, insize, key->pngsum);
+
+	// Colors get matched against the master palette, and paletted
+	// PNGs are expanded with the local one for 32-bit output.
+	memset(palettes, 0, sizeof palettes);
+	if (pMasterPalette)
+		M_Memcpy(&palettes[0], pMasterPalette, 256 * sizeof (RGBA_t));
+	if (pLocalPalette)
+		M_Memcpy(&palettes[256], pLocalPalette, 256 * sizeof (RGBA_t));
+	md5_buffer((const char *)palettes, sizeof palettes, key->palsum);
+
+	key->pngsize = (UINT32)insize;
+	key->format = (UINT32)outformat;
+	key->flags = (UINT32)flags;
+
+	WRITEMEM(kp, key->pngsum, 16);
+	WRITEMEM(kp, key->palsum, 16);
+	WRITEUINT32(kp, key->format);
+	WRITEUINT32(kp, key->flags);
+	md5_buffer((const char *)keydata, sizeof keydata, keysum);
+
+	i = snprintf(key->path, sizeof key->path, "%s"PATHSEP PNGCACHE_DIR PATHSEP"%02x"PATHSEP, srb2home, keysum[0]);
+	if (i < 0 || (size_t)i + 33 > sizeof key->path)
+		return false;
+	for (p = &key->path[i], i = 0; i < 16; i++, p += 2)
+		sprintf(p, "%02x", keysum[i]);
+
+	key->valid = true;
+	return true;
+}
+
+static void *PNGCache_Load(pngcachekey_t *key, INT32 *w, INT32 *h, INT16 *topoffset, INT16 *leftoffset, size_t *outsize)
+{
+	UINT8 header[PNGCACHE_HEADERSIZE], sum[16], datasum[16];
+	UINT8 *hp = header + 8;
+	UINT32 datasize;
+	INT32 width, height;
+	INT16 toffs, loffs;
+	UINT8 *data = NULL;
+	FILE *f;
+
+	f = fopen(key->path, "rb");
+	if (!f)
+		return NULL;
+
+	if (fread(header, 1, sizeof header, f) != sizeof header
+	|| memcmp(header, PNGCACHE_MAGIC, 8)
+	|| READUINT32(hp) != PNGCACHE_VERSION
+	|| READUINT32(hp) != key->pngsize)
+		goto fail;
+
+	READMEM(hp, sum, 16);
+	if (memcmp(sum, key->pngsum, 16))
+		goto fail;
+	READMEM(hp, sum, 16);
+	if (memcmp(sum, key->palsum, 16))
+		goto fail;
+	if (READUINT32(hp) != key->format || READUINT32(hp) != key->flags)
+		goto fail;
+
+	width = READINT32(hp);
+	height = READINT32(hp);
+	toffs = READINT16(hp);
+	loffs = READINT16(hp);
+	datasize = READUINT32(hp);
+	READMEM(hp, datasum, 16);
+
+	// The rest of the file has to be exactly the data.
+	if (fseek(f, 0, SEEK_END) || ftell(f) != (long)(PNGCACHE_HEADERSIZE + datasize)
+	|| fseek(f, PNGCACHE_HEADERSIZE, SEEK_SET))
+		goto fail;
+
+	data = Z_Malloc(datasize, PU_STATIC, NULL);
+	if (fread(data, 1, datasize, f) != datasize)
+		goto fail;
+
+	md5_buffer((const char *)data, datasize, sum);
+	if (memcmp(sum, datasum, 16))
+		goto fail;
+
+	fclose(f);
+
+	*w = width;
+	*h = height;
+	*topoffset = toffs;
+	*leftoffset = loffs;
+	*outsize = datasize;
+	return data;
+
+fail:
+	CONS_Debug(DBG_RENDER, "PNGCache_Load: ignoring bad cache entry %s\n", key->path);
+	if (data)
+		Z_Free(data);
+	fclose(f);
+	return NULL;
+}
+
+static void PNGCache_Save(pngcachekey_t *key, const void *data, INT32 w, INT32 h, INT16 topoffset, INT16 leftoffset, size_t size)
+{
+	UINT8 header[PNGCACHE_HEADERSIZE];
+	UINT8 *hp = header;
+	char tmppath[sizeof key->path + 4];
+	UINT8 datasum[16];
+	boolean ok;
+	FILE *f;
+
+	if (size > UINT32_MAX)
+		return;
+
+	md5_buffer((const char *)data, size, datasum);
+
+	WRITEMEM(hp, PNGCACHE_MAGIC, 8);
+	WRITEUINT32(hp, PNGCACHE_VERSION);
+	WRITEUINT32(hp, key->pngsize);
+	WRITEMEM(hp, key->pngsum, 16);
+	WRITEMEM(hp, key->palsum, 16);
+	WRITEUINT32(hp, key->format);
+	WRITEUINT32(hp, key->flags);
+	WRITEINT32(hp, w);
+	WRITEINT32(hp, h);
+	WRITEINT16(hp, topoffset);
+	WRITEINT16(hp, leftoffset);
+	WRITEUINT32(hp, (UINT32)size);
+	WRITEMEM(hp, datasum, 16);
+
+	// Entries are spread over subfolders by the first byte of their name.
+	I_mkdir(va("%s"PATHSEP PNGCACHE_DIR, srb2home), 0755);
+	strcpy(tmppath, key->path);
+	*strrchr(tmppath, PATHSEP[0]) = '\0';
+	I_mkdir(tmppath, 0755);
+
+	// Write to a temporary name first, so another instance never reads half a file.
+	snprintf(tmppath, sizeof tmppath, "%s.tmp", key->path);
+	f = fopen(tmppath, "wb");
+	if (!f)
+		return;
+	ok = (fwrite(header, 1, sizeof header, f) == sizeof header && fwrite(data, 1, size, f) == size);
+	ok = (fclose(f) == 0 && ok);
+
+	if (ok)
+	{
+		remove(key->path);
+		ok = (rename(tmppath, key->path) == 0);
+	}
+	if (!ok)
+		remove(tmppath);
+}
+
+typedef struct
+{
+	char *path;
+	size_t size;
+	time_t mtime;
+} pngcachefile_t;
+
+typedef struct
+{
+	pngcachefile_t *files;
+	size_t numfiles, capacity;
+	size_t total;
+} pngcachelist_t;
+
+static void PNGCache_ListFile(const char *filepath, size_t size, time_t mtime, void *userdata)
+{
+	pngcachelist_t *list = userdata;
+	pngcachefile_t *file;
+
+	if (list->numfiles == list->capacity)
+	{
+		size_t capacity = list->capacity ? list->capacity * 2 : 256;
+		pngcachefile_t *files = realloc(list->files, capacity * sizeof (*files));
+		if (!files)
+			return;
+		list->files = files;
+		list->capacity = capacity;
+	}
+
+	file = &list->files[list->numfiles];
+	file->path = strdup(filepath);
+	if (!file->path)
+		return;
+	file->size = size;
+	file->mtime = mtime;
+
+	list->numfiles++;
+	list->total += size;
+}
+
+static int PNGCache_CompareAge(const void *a, const void *b)
+{
+	const time_t agea = ((const pngcachefile_t *)a)->mtime;
+	const time_t ageb = ((const pngcachefile_t *)b)->mtime;
+	return (agea > ageb) - (agea < ageb);
+}
+
+// Deletes the entries written longest ago until the cache fits in budget
+static void PNGCache_Prune(size_t budget)
+{
+	pngcachelist_t list = {NULL, 0, 0, 0};
+	size_t i, removed = 0, freed = 0;
+
+	if (!budget || !PNGCache_Enabled())
+		return;
+
+	for (i = 0; i < 256; i++)
+		foreachfile(va("%s"PATHSEP PNGCACHE_DIR PATHSEP"%02x", srb2home, (UINT32)i), PNGCache_ListFile, &list);
+
+	if (list.total > budget)
+	{
+		qsort(list.files, list.numfiles, sizeof (*list.files), PNGCache_CompareAge);
+
+		for (i = 0; i < list.numfiles && list.total > budget; i++)
+			if (remove(list.files[i].path) == 0)
+			{
+				list.total -= list.files[i].size;
+				freed += list.files[i].size;
+				removed++;
+			}
+
+		CONS_Printf(M_GetText("Pruned %s pictures (%s KB) from the PNG cache\n"), sizeu1(removed), sizeu2(freed >> 10));
+	}
+
+	for (i = 0; i < list.numfiles; i++)
+		free(list.files[i].path);
+	free(list.files);
+}
+#endif
+
+// Does the actual work for Picture_PNGConvert, without the cache.
+static void *PNG_Convert(
+	const UINT8 *png, pictureformat_t outformat,
+	INT32 *w, INT32 *h,
+	INT16 *topoffset, INT16 *leftoffset,
+	size_t insize, size_t *outsize,
+	pictureflags_t flags);
+
 /** Converts a PNG to a picture.
+  * Results are kept in a cache on disk, so a picture that was converted
+  * before doesn't have to be decoded again.
   *
   * \param png The PNG image.
   * \param outformat The output picture's format.
@@ -1076,6 +1375,7 @@ static png_bytep *PNG_Read(
   * \param outsize A pointer to the output picture's size.
   * \param flags Input picture flags.
   * \return A pointer to the converted picture.
+  * \sa PNGCache_Load, PNGCache_Save
   */
 void *Picture_PNGConvert(
 	const UINT8 *png, pictureformat_t outformat,
@@ -1084,17 +1384,13 @@ void *Picture_PNGConvert(
 	size_t insize, size_t *outsize,
 	pictureflags_t flags)
 {
-	void *flat;
-	INT32 outbpp;
-	size_t flatsize;
-	png_uint_32 x, y;
-	png_bytep row;
-	boolean palette = false;
-	png_bytep *row_pointers = NULL;
-	png_uint_32 width, height;
-
 	INT32 pngwidth, pngheight;
 	INT16 loffs = 0, toffs = 0;
+	size_t size;
+	void *pic;
+#ifndef NOMD5
+	pngcachekey_t key;
+#endif
 
 	if (png == NULL)
 		I_Error("Picture_PNGConvert: picture was NULL!");
@@ -1108,6 +1404,47 @@ void *Picture_PNGConvert(
 	if (leftoffset == NULL)
 		leftoffset = &loffs;
 
+#ifndef NOMD5
+	if (PNGCache_MakeKey(&key, png, insize, outformat, flags))
+	{
+		pic = PNGCache_Load(&key, w, h, topoffset, leftoffset, &size);
+		if (pic)
+		{
+			if (outsize)
+				*outsize = size;
+			return pic;
+		}
+	}
+#endif
+
+	pic = PNG_Convert(png, outformat, w, h, topoffset, leftoffset, insize, &size, flags);
+
+#ifndef NOMD5
+	if (key.valid)
+		PNGCache_Save(&key, pic, *w, *h, *topoffset, *leftoffset, size);
+#endif
+
+	if (outsize)
+		*outsize = size;
+	return pic;
+}
+
+static void *PNG_Convert(
+	const UINT8 *png, pictureformat_t outformat,
+	INT32 *w, INT32 *h,
+	INT16 *topoffset, INT16 *leftoffset,
+	size_t insize, size_t *outsize,
+	pictureflags_t flags)
+{
+	void *flat;
+	INT32 outbpp;
+	size_t flatsize;
+	png_uint_32 x, y;
+	png_bytep row;
+	boolean palette = false;
+	png_bytep *row_pointers = NULL;
+	png_uint_32 width, height;
+
 	row_pointers = PNG_Read(png, w, h, topoffset, leftoffset, &palette, insize);
 	width = *w;
 	height = *h;
@@ -1394,6 +1731,17 @@ boolean Picture_PNGDimensions(UINT8 *png, INT32 *width, INT32 *height, INT16 *to
 #endif
 #endif
 
+/** Deletes the oldest converted PNGs kept on disk until they fit in
+  * r_pngcachesize again. Call this once at startup, after the config
+  * has been loaded.
+  */
+void Picture_PrunePNGCache(void)
+{
+#if !defined (NO_PNG_LUMPS) && defined (HAVE_PNG) && !defined (NOMD5)
+	PNGCache_Prune((size_t)cv_pngcachesize.value << 20);
+#endif
+}
+
 //
 // R_ParseSpriteInfoFrame
 //
@@ -120,6 +120,9 @@ boolean Picture_PNGDimensions(UINT8 *png, INT32 *width, INT32 *height, INT16 *to
 #define PICTURE_PNG_USELOOKUP
 #endif
 
+void Picture_PrunePNGCache(void);
+extern consvar_t cv_pngcachesize;
+
 // SpriteInfo
 extern spriteinfo_t spriteinfo[NUMSPRITES];
 void R_LoadSpriteInfoLumps(UINT16 wadnum, UINT16 numlumps);
@@ -38,9 +38,21 @@
 
 //SoM: 3/23/2000: Use Boom visplane hashing.
 
-visplane_t *visplanes[MAXVISPLANES];
-static visplane_t *freetail;
-static visplane_t **freehead = &freetail;
+visplane_t **visplanes;
+size_t visplanehashsize;
+static size_t numhashedplanes;
+
+// Visplanes only live for a frame, so they come out of blocks that are
+// handed out again from the start every R_ClearPlanes.
+#define VISPLANEBLOCKSIZE 64
+
+static struct
+{
+	visplane_t **blocks;
+	size_t numblocks;
+	size_t used;
+	INT32 width; // how many columns each plane has room for
+} planepool;
 
 visplane_t *floorplane;
 visplane_t *ceilingplane;
@@ -49,9 +61,71 @@ static visplane_t *currentplane;
 visffloor_t ffloor[MAXFFLOORS];
 INT32 numffloors;
 
-//SoM: 3/23/2000: Boom visplane hashing routine.
-#define visplane_hash(picnum,lightlevel,height) \
-  ((unsigned)((picnum)*3+(lightlevel)+(height)*7) & VISPLANEHASHMASK)
+static inline UINT32 R_MixPlaneKey(UINT32 hash, UINT32 key)
+{
+	key *= 0xcc9e2d51;
+	key = (key << 15) | (key >> 17);
+	key *= 0x1b873593;
+	hash ^= key;
+	hash = (hash << 13) | (hash >> 19);
+	return hash*5 + 0xe6546b64;
+}
+
+#define R_MixPlanePointer(hash, ptr) \
+	R_MixPlaneKey(R_MixPlaneKey(hash, (UINT32)(size_t)(ptr)), (UINT32)((UINT64)(size_t)(ptr) >> 32))
+
+// Everything R_FindPlane compares, apart from the viewpoint, which is
+// the same for nearly every plane in a frame.
+static UINT32 R_VisplaneHash(INT32 picnum, INT32 lightlevel, fixed_t height,
+	fixed_t xoff, fixed_t yoff, angle_t plangle, extracolormap_t *planecolormap,
+	polyobj_t *polyobj, pslope_t *slope)
+{
+	UINT32 hash = 0;
+
+	hash = R_MixPlaneKey(hash, (UINT32)picnum);
+	hash = R_MixPlaneKey(hash, (UINT32)lightlevel);
+	hash = R_MixPlaneKey(hash, (UINT32)height);
+	hash = R_MixPlaneKey(hash, (UINT32)xoff);
+	hash = R_MixPlaneKey(hash, (UINT32)yoff);
+	hash = R_MixPlaneKey(hash, plangle);
+	hash = R_MixPlanePointer(hash, planecolormap);
+	hash = R_MixPlanePointer(hash, polyobj);
+	hash = R_MixPlanePointer(hash, slope);
+
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6b;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35;
+	hash ^= hash >> 16;
+	return hash;
+}
+
+// Doubles the hash table, keeping the fof plane list at the end.
+static void R_GrowVisplaneHash(void)
+{
+	size_t newsize = visplanehashsize * 2;
+	visplane_t **newplanes = Z_Calloc((newsize + 1) * sizeof (*newplanes), PU_STATIC, NULL);
+	size_t i;
+
+	for (i = 0; i < visplanehashsize; i++)
+	{
+		visplane_t *pl, *next;
+
+		for (pl = visplanes[i]; pl; pl = next)
+		{
+			size_t bucket = pl->hash & (newsize - 1);
+
+			next = pl->next;
+			pl->next = newplanes[bucket];
+			newplanes[bucket] = pl;
+		}
+	}
+	newplanes[newsize] = visplanes[visplanehashsize];
+
+	Z_Free(visplanes);
+	visplanes = newplanes;
+	visplanehashsize = newsize;
+}
 
 //
 // Clip values are the solid pixel bounding the range.
@@ -70,7 +144,7 @@ static INT32 spanstart[MAXVIDHEIGHT];
 //
 // texture mapping
 //
-lighttable_t **planezlight;
+R_THREADLOCAL lighttable_t **planezlight;
 static fixed_t planeheight;
 
 //added : 10-02-98: yslopetab is what yslope used to be,
@@ -97,7 +171,8 @@ static floatv3_t ds_slope_origin, ds_slope_u, ds_slope_v;
 //
 void R_InitPlanes(void)
 {
-	// FIXME: unused
+	visplanehashsize = 1<<VISPLANEHASHBITS;
+	visplanes = Z_Calloc(NUMVISPLANELISTS * sizeof (*visplanes), PU_STATIC, NULL);
 }
 
 //
@@ -220,7 +295,7 @@ static void R_MapPlane(INT32 y, INT32 x1, INT32 x2)
 	ds_x1 = x1;
 	ds_x2 = x2;
 
-	spanfunc();
+	CALL_SPANFUNC(spanfunc);
 }
 
 static void R_MapTiltedPlane(INT32 y, INT32 x1, INT32 x2)
@@ -259,7 +334,7 @@ static void R_MapTiltedPlane(INT32 y, INT32 x1, INT32 x2)
 	ds_x1 = x1;
 	ds_x2 = x2;
 
-	spanfunc();
+	CALL_SPANFUNC(spanfunc);
 }
 
 static void R_MapFogPlane(INT32 y, INT32 x1, INT32 x2)
@@ -292,7 +367,7 @@ static void R_MapFogPlane(INT32 y, INT32 x1, INT32 x2)
 	ds_x1 = x1;
 	ds_x2 = x2;
 
-	spanfunc();
+	CALL_SPANFUNC(spanfunc);
 }
 
 static void R_MapTiltedFogPlane(INT32 y, INT32 x1, INT32 x2)
@@ -314,7 +389,7 @@ static void R_MapTiltedFogPlane(INT32 y, INT32 x1, INT32 x2)
 	ds_x1 = x1;
 	ds_x2 = x2;
 
-	spanfunc();
+	CALL_SPANFUNC(spanfunc);
 }
 
 void R_ClearFFloorClips (void)
@@ -355,36 +430,91 @@ void R_ClearPlanes(void)
 		}
 	}
 
-	for (i = 0; i < MAXVISPLANES; i++)
-	for (*freehead = visplanes[i], visplanes[i] = NULL;
-		freehead && *freehead ;)
+	memset(visplanes, 0, NUMVISPLANELISTS * sizeof (*visplanes));
+	numhashedplanes = 0;
+
+	// The blocks have to be made again for a new resolution.
+	if (planepool.width != vid.width)
 	{
-		freehead = &(*freehead)->next;
+		for (i = 0; i < (INT32)planepool.numblocks; i++)
+			free(planepool.blocks[i]);
+		free(planepool.blocks);
+		planepool.blocks = NULL;
+		planepool.numblocks = 0;
+		planepool.width = vid.width;
 	}
+	planepool.used = 0;
+
+	ps_sw_numvisplanes.value.i = 0;
+	ps_sw_planeprobes.value.i = 0;
+	ps_sw_maxplaneprobe.value.i = 0;
 
 	// texture calculation
 	memset(cachedheight, 0, sizeof (cachedheight));
 }
 
-static visplane_t *new_visplane(unsigned hash)
+// Each plane's columns come right after the planes in its block.
+static void R_AddVisplaneBlock(void)
 {
-	visplane_t *check = freetail;
-	if (!check)
+	size_t columns = planepool.width + 2;
+	visplane_t *block, **blocks;
+	UINT16 *storage;
+	size_t i;
+
+	blocks = realloc(planepool.blocks, (planepool.numblocks + 1) * sizeof (*blocks));
+	block = malloc(VISPLANEBLOCKSIZE * (sizeof (*block) + 2 * columns * sizeof (*storage)));
+	if (!blocks || !block)
+		I_Error("%s: Out of memory", "R_AddVisplaneBlock");
+
+	storage = (UINT16 *)(block + VISPLANEBLOCKSIZE);
+	for (i = 0; i < VISPLANEBLOCKSIZE; i++, storage += 2 * columns)
 	{
-		check = malloc(sizeof (*check));
-		if (check == NULL) I_Error("%s: Out of memory", "new_visplane"); // FIXME: ugly
+		block[i].top = storage + 1;
+		block[i].bottom = storage + columns + 1;
+	}
+
+	planepool.blocks = blocks;
+	planepool.blocks[planepool.numblocks++] = block;
+}
+
+// Pass NULL as the hash for a fof plane, which goes on the list at the end.
+static visplane_t *new_visplane(const UINT32 *hash)
+{
+	visplane_t *check, **list;
+
+	if (planepool.used == planepool.numblocks * VISPLANEBLOCKSIZE)
+		R_AddVisplaneBlock();
+
+	check = &planepool.blocks[planepool.used / VISPLANEBLOCKSIZE][planepool.used % VISPLANEBLOCKSIZE];
+	planepool.used++;
+	ps_sw_numvisplanes.value.i++;
+
+	if (hash)
+	{
+		// Keep the chains short.
+		if (++numhashedplanes > visplanehashsize * 2)
+			R_GrowVisplaneHash();
+
+		check->hash = *hash;
+		list = &visplanes[*hash & (visplanehashsize - 1)];
 	}
 	else
 	{
-		freetail = freetail->next;
-		if (!freetail)
-			freehead = &freetail;
+		check->hash = 0;
+		list = &visplanes[visplanehashsize];
 	}
-	check->next = visplanes[hash];
-	visplanes[hash] = check;
+
+	check->next = *list;
+	*list = check;
 	return check;
 }
 
+static void R_ClearPlaneColumns(visplane_t *pl)
+{
+	memset(pl->top, 0xff, planepool.width * sizeof (*pl->top));
+	memset(pl->bottom, 0x00, planepool.width * sizeof (*pl->bottom));
+}
+
 //
 // R_FindPlane: Seek a visplane having the identical values:
 //              Same height, same flattexture, same lightlevel.
@@ -395,7 +525,7 @@ visplane_t *R_FindPlane(fixed_t height, INT32 picnum, INT32 lightlevel,
 	ffloor_t *pfloor, polyobj_t *polyobj, pslope_t *slope)
 {
 	visplane_t *check;
-	unsigned hash;
+	UINT32 hash = 0;
 
 	if (!slope) // Don't mess with this right now if a slope is involved
 	{
@@ -438,10 +568,13 @@ visplane_t *R_FindPlane(fixed_t height, INT32 picnum, INT32 lightlevel,
 
 	if (!pfloor)
 	{
-		hash = visplane_hash(picnum, lightlevel, height);
-		for (check = visplanes[hash]; check; check = check->next)
+		INT32 probes = 0;
+
+		hash = R_VisplaneHash(picnum, lightlevel, height, xoff, yoff, plangle, planecolormap, polyobj, slope);
+		for (check = visplanes[hash & (visplanehashsize - 1)]; check; check = check->next)
 		{
-			if (polyobj != check->polyobj)
+			probes++;
+			if (hash != check->hash || polyobj != check->polyobj)
 				continue;
 			if (height == check->height && picnum == check->picnum
 				&& lightlevel == check->lightlevel
@@ -452,16 +585,19 @@ visplane_t *R_FindPlane(fixed_t height, INT32 picnum, INT32 lightlevel,
 				&& check->plangle == plangle
 				&& check->slope == slope)
 			{
-				return check;
+				break;
 			}
 		}
-	}
-	else
-	{
-		hash = MAXVISPLANES - 1;
+
+		ps_sw_planeprobes.value.i += probes;
+		if (probes > ps_sw_maxplaneprobe.value.i)
+			ps_sw_maxplaneprobe.value.i = probes;
+
+		if (check)
+			return check;
 	}
 
-	check = new_visplane(hash);
+	check = new_visplane(pfloor ? NULL : &hash);
 
 	check->height = height;
 	check->picnum = picnum;
@@ -480,8 +616,7 @@ visplane_t *R_FindPlane(fixed_t height, INT32 picnum, INT32 lightlevel,
 	check->polyobj = polyobj;
 	check->slope = slope;
 
-	memset(check->top, 0xff, sizeof (check->top));
-	memset(check->bottom, 0x00, sizeof (check->bottom));
+	R_ClearPlaneColumns(check);
 
 	return check;
 }
@@ -529,17 +664,7 @@ visplane_t *R_CheckPlane(visplane_t *pl, INT32 start, INT32 stop)
 	}
 	else /* Cannot use existing plane; create a new one */
 	{
-		visplane_t *new_pl;
-		if (pl->ffloor)
-		{
-			new_pl = new_visplane(MAXVISPLANES - 1);
-		}
-		else
-		{
-			unsigned hash =
-				visplane_hash(pl->picnum, pl->lightlevel, pl->height);
-			new_pl = new_visplane(hash);
-		}
+		visplane_t *new_pl = new_visplane(pl->ffloor ? NULL : &pl->hash);
 
 		new_pl->height = pl->height;
 		new_pl->picnum = pl->picnum;
@@ -558,8 +683,7 @@ visplane_t *R_CheckPlane(visplane_t *pl, INT32 start, INT32 stop)
 		pl = new_pl;
 		pl->minx = start;
 		pl->maxx = stop;
-		memset(pl->top, 0xff, sizeof pl->top);
-		memset(pl->bottom, 0x00, sizeof pl->bottom);
+		R_ClearPlaneColumns(pl);
 	}
 	return pl;
 }
@@ -616,7 +740,7 @@ void R_DrawPlanes(void)
 
 	R_UpdatePlaneRipple();
 
-	for (i = 0; i < MAXVISPLANES; i++, pl++)
+	for (i = 0; i < (INT32)NUMVISPLANELISTS; i++, pl++)
 	{
 		for (pl = visplanes[i]; pl; pl = pl->next)
 		{
@@ -666,7 +790,7 @@ static void R_DrawSkyPlane(visplane_t *pl)
 			dc_source =
 				R_GetColumn(texturetranslation[skytexture],
 					-angle); // get negative of angle for each column to display sky correct way round! --Monster Iestyn 27/01/18
-			colfunc();
+			CALL_COLFUNC(colfunc);
 		}
 	}
 }
@@ -951,6 +1075,10 @@ void R_DrawSinglePlane(visplane_t *pl)
 
 					spanfunctype = SPANDRAWFUNC_WATER;
 
+#ifdef HAVE_RENDERTHREADS
+					R_FlushThreadedDraws();
+#endif
+
 					// Only copy the part of the screen we need
 					VID_BlitLinearScreen((splitscreen && viewplayer == &players[secondarydisplayplayer]) ? screens[0] + (top+(vid.height>>1))*vid.width : screens[0]+((top)*vid.width), screens[1]+((top)*vid.width),
 										 vid.width, bottom-top,
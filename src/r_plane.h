@@ -18,11 +18,11 @@
 #include "r_data.h"
 #include "r_textures.h"
 #include "p_polyobj.h"
+#include "r_threads.h"
 
-#define VISPLANEHASHBITS 9
-#define VISPLANEHASHMASK ((1<<VISPLANEHASHBITS)-1)
+#define VISPLANEHASHBITS 9 // starting size, the table grows with the number of planes
 // the last visplane list is outside of the hash table and is used for fof planes
-#define MAXVISPLANES ((1<<VISPLANEHASHBITS)+1)
+#define NUMVISPLANELISTS (visplanehashsize+1)
 
 //
 // Now what is a visplane, anyway?
@@ -31,6 +31,7 @@
 typedef struct visplane_s
 {
 	struct visplane_s *next;
+	UINT32 hash;
 
 	fixed_t height;
 	fixed_t viewx, viewy, viewz;
@@ -43,9 +44,8 @@ typedef struct visplane_s
 	// colormaps per sector
 	extracolormap_t *extra_colormap;
 
-	// leave pads for [minx-1]/[maxx+1]
-	UINT16 padtopstart, top[MAXVIDWIDTH], padtopend;
-	UINT16 padbottomstart, bottom[MAXVIDWIDTH], padbottomend;
+	// vid.width entries each, with pads for [minx-1]/[maxx+1]
+	UINT16 *top, *bottom;
 	INT32 high, low; // R_PlaneBounds should set these.
 
 	fixed_t xoffs, yoffs; // Scrolling flats.
@@ -55,7 +55,8 @@ typedef struct visplane_s
 	pslope_t *slope;
 } visplane_t;
 
-extern visplane_t *visplanes[MAXVISPLANES];
+extern visplane_t **visplanes;
+extern size_t visplanehashsize;
 extern visplane_t *floorplane;
 extern visplane_t *ceilingplane;
 
@@ -68,7 +69,7 @@ extern fixed_t cachedxstep[MAXVIDHEIGHT];
 extern fixed_t cachedystep[MAXVIDHEIGHT];
 
 extern fixed_t *yslope;
-extern lighttable_t **planezlight;
+extern R_THREADLOCAL lighttable_t **planezlight;
 
 void R_InitPlanes(void);
 void R_ClearPlanes(void);
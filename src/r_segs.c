@@ -126,11 +126,11 @@ static void R_Render2sidedMultiPatchColumn(column_t *column)
 		dc_source = (UINT8 *)column + 3;
 
 		if (colfunc == colfuncs[BASEDRAWFUNC])
-			(colfuncs[COLDRAWFUNC_TWOSMULTIPATCH])();
+			CALL_COLFUNC(colfuncs[COLDRAWFUNC_TWOSMULTIPATCH]);
 		else if (colfunc == colfuncs[COLDRAWFUNC_FUZZY])
-			(colfuncs[COLDRAWFUNC_TWOSMULTIPATCHTRANS])();
+			CALL_COLFUNC(colfuncs[COLDRAWFUNC_TWOSMULTIPATCHTRANS]);
 		else
-			colfunc();
+			CALL_COLFUNC(colfunc);
 	}
 }
 
@@ -1300,7 +1300,7 @@ static void R_RenderSegLoop (void)
 #ifdef TIMING
 				ProfZeroTimer();
 #endif
-				colfunc();
+				CALL_COLFUNC(colfunc);
 #ifdef TIMING
 				RDMSR(0x10,&mycount);
 				mytotal += mycount;      //64bit add
@@ -1356,7 +1356,7 @@ static void R_RenderSegLoop (void)
 						dc_texturemid = rw_toptexturemid;
 						dc_source = R_GetColumn(toptexture, itexturecolumn + (rw_offset_top>>FRACBITS));
 						dc_texheight = textureheight[toptexture]>>FRACBITS;
-						colfunc();
+						CALL_COLFUNC(colfunc);
 						ceilingclip[rw_x] = (INT16)mid;
 					}
 					else if (!rw_ceilingmarked) // entirely off top of screen
@@ -1392,7 +1392,7 @@ static void R_RenderSegLoop (void)
 						dc_texturemid = rw_bottomtexturemid;
 						dc_source = R_GetColumn(bottomtexture, itexturecolumn + (rw_offset_bot>>FRACBITS));
 						dc_texheight = textureheight[bottomtexture]>>FRACBITS;
-						colfunc();
+						CALL_COLFUNC(colfunc);
 						floorclip[rw_x] = (INT16)mid;
 					}
 					else if (!rw_floormarked)  // entirely off bottom of screen
@@ -383,6 +383,11 @@ static void SetSkin(player_t *player, INT32 skinnum)
 
 		P_SetPlayerMobjState(player->mo, player->mo->state-states); // Prevent visual errors when switching between skins with differing number of frames
 	}
+
+	// Joining and changing skin or color all end up here, so get this
+	// player's colormaps ready now rather than mid-frame
+	if (!dedicated)
+		R_PrecacheTranslationColormaps(skinnum, player->skincolor);
 }
 
 // Gets the player to the first usuable skin in the game.
@@ -690,6 +695,8 @@ void R_AddSkins(UINT16 wadnum, boolean mainfile)
 	// search for all skin markers in pwad
 	//
 
+	W_StartPrefetch(wadnum);
+
 	while ((lump = W_CheckForSkinMarkerInPwad(wadnum, lastlump)) != INT16_MAX)
 	{
 		// advance by default
@@ -822,7 +829,7 @@ next_token:
 		R_LoadSkinSprites(wadnum, &lump, &lastlump, skin, 0);
 		//ST_LoadFaceGraphics(numskins); -- nah let's do this elsewhere
 
-		R_FlushTranslationColormapCache();
+		R_InvalidateSkinTranslationColormaps((INT32)(skin - skins));
 
 		if (mainfile == false)
 			CONS_Printf(M_GetText("Added skin '%s'\n"), skin->name);
@@ -838,6 +845,8 @@ next_token:
 
 		numskins++;
 	}
+
+	W_EndPrefetch();
 	return;
 }
 
@@ -859,6 +868,8 @@ void R_PatchSkins(UINT16 wadnum, boolean mainfile)
 	// search for all skin patch markers in pwad
 	//
 
+	W_StartPrefetch(wadnum);
+
 	while ((lump = W_CheckForPatchSkinMarkerInPwad(wadnum, lastlump)) != INT16_MAX)
 	{
 		INT32 skinnum = 0;
@@ -968,11 +979,13 @@ next_token:
 		R_LoadSkinSprites(wadnum, &lump, &lastlump, skin, 0);
 		//ST_LoadFaceGraphics(skinnum); -- nah let's do this elsewhere
 
-		R_FlushTranslationColormapCache();
+		R_InvalidateSkinTranslationColormaps((INT32)(skin - skins));
 
 		if (mainfile == false)
 			CONS_Printf(M_GetText("Patched skin '%s'\n"), skin->name);
 	}
+
+	W_EndPrefetch();
 	return;
 }
 
@@ -1081,7 +1094,7 @@ next_token:
 
 		// Update sprites, in the range of (start_spr2 - free_spr2-1)
 		R_LoadSkinSprites(wadnum, &lump, &lastlump, skin, start_spr2);
-		//R_FlushTranslationColormapCache(); // I don't think this is needed for what we're doing?
+		//R_InvalidateSkinTranslationColormaps(skinnum); // I don't think this is needed for what we're doing?
 	}
 }
 
@@ -27,6 +27,8 @@
 #include "p_setup.h" // levelflats
 #include "byteptr.h"
 #include "dehacked.h"
+#include "i_system.h"
+#include "i_threads.h"
 
 #ifdef HWRENDER
 #include "hardware/hw_glob.h" // HWR_LoadMapTextures
@@ -56,6 +58,29 @@ fixed_t *textureheight; // needed for texture pegging
 
 INT32 *texturetranslation;
 
+static CV_PossibleValue_t texturecachesize_cons_t[] = {{0, "MIN"}, {4096, "MAX"}, {0, NULL}};
+consvar_t cv_texturecachesize = CVAR_INIT ("r_texturecachesize", "128", CV_SAVE, texturecachesize_cons_t, NULL);
+
+// Generated textures are kept until they go over r_texturecachesize
+// megabytes, then the ones that have gone unused the longest are freed.
+static size_t *texturecachebytes;
+static UINT32 *texturelastused;
+static UINT32 texturecacheframe = 1;
+
+static struct
+{
+	size_t used;
+	UINT32 ondemand, pregenerated, evicted;
+	precise_t pregentime;
+	boolean pregenerating;
+} texcache;
+
+typedef struct
+{
+	softwarepatch_t *patch;
+	boolean dealloc;
+} texpatchdata_t;
+
 // Painfully simple texture id cacheing to make maps load faster. :3
 static struct {
 	char name[9];
@@ -246,6 +271,137 @@ static inline void R_DrawBlendFlippedColumnInCache(column_t *patch, UINT8 *cache
 	}
 }
 
+static void R_AddToTextureCache(size_t texnum, size_t blocksize)
+{
+	texturecachebytes[texnum] = blocksize;
+	texturelastused[texnum] = texturecacheframe;
+	texcache.used += blocksize;
+}
+
+// Loads every patch of a texture in the Doom patch format, converting
+// the ones that aren't.
+static texpatchdata_t *R_CacheTexturePatches(texture_t *texture)
+{
+	texpatchdata_t *patches = Z_Malloc(max(texture->patchcount, 1) * sizeof (*patches), PU_STATIC, NULL);
+	texpatch_t *patch;
+	INT32 i;
+
+	for (i = 0, patch = texture->patches; i < texture->patchcount; i++, patch++)
+	{
+		UINT8 *pdata = W_CacheLumpNumPwad(patch->wad, patch->lump, PU_CACHE);
+		size_t lumplength = W_LumpLengthPwad(patch->wad, patch->lump);
+
+		patches[i].dealloc = true;
+
+#ifndef NO_PNG_LUMPS
+		if (Picture_IsLumpPNG(pdata, lumplength))
+			patches[i].patch = (softwarepatch_t *)Picture_PNGConvert(pdata, PICFMT_DOOMPATCH, NULL, NULL, NULL, NULL, lumplength, NULL, 0);
+		else
+#endif
+#ifdef WALLFLATS
+		if (texture->type == TEXTURETYPE_FLAT)
+			patches[i].patch = (softwarepatch_t *)Picture_Convert(PICFMT_FLAT, pdata, PICFMT_DOOMPATCH, 0, NULL, texture->width, texture->height, 0, 0, 0);
+		else
+#endif
+		{
+			(void)lumplength;
+			patches[i].patch = (softwarepatch_t *)pdata;
+			patches[i].dealloc = false;
+		}
+	}
+
+	return patches;
+}
+
+static void R_FreeTexturePatches(texture_t *texture, texpatchdata_t *patches)
+{
+	INT32 i;
+
+	for (i = 0; i < texture->patchcount; i++)
+		if (patches[i].dealloc)
+			Z_Free(patches[i].patch);
+	Z_Free(patches);
+}
+
+// Allocates and clears the block for a multi-patch texture, and sets up
+// its column lookup.
+static UINT8 *R_AllocateCompositeTexture(size_t texnum)
+{
+	texture_t *texture = textures[texnum];
+	size_t blocksize = (texture->width * 4) + (texture->width * texture->height);
+	UINT8 *block;
+
+	texture->holes = false;
+	texture->flip = 0;
+	texturememory += blocksize;
+	block = Z_Malloc(blocksize+1, PU_STATIC, &texturecache[texnum]);
+
+	memset(block, TRANSPARENTPIXEL, blocksize+1); // Transparency hack
+
+	// columns lookup table
+	texturecolumnofs[texnum] = (UINT32 *)block;
+
+	R_AddToTextureCache(texnum, blocksize+1);
+	return block;
+}
+
+// Draws the patches of a multi-patch texture into its block. Nothing but
+// the block and the patches is touched unless a patch has to be blended,
+// which is what lets R_PregenerateTextures hand this to other threads.
+static void R_CompositeTexture(texture_t *texture, UINT8 *block, texpatchdata_t *patches)
+{
+	UINT8 *colofs = block;
+	texpatch_t *patch;
+	column_t *patchcol;
+	INT32 x, x1, x2, i, width, height;
+
+	for (i = 0, patch = texture->patches; i < texture->patchcount; i++, patch++)
+	{
+		softwarepatch_t *realpatch = patches[i].patch;
+		void (*ColumnDrawerPointer)(column_t *, UINT8 *, texpatch_t *, INT32, INT32); // Column drawing function pointer.
+		if (patch->style != AST_COPY)
+			ColumnDrawerPointer = (patch->flip & 2) ? R_DrawBlendFlippedColumnInCache : R_DrawBlendColumnInCache;
+		else
+			ColumnDrawerPointer = (patch->flip & 2) ? R_DrawFlippedColumnInCache : R_DrawColumnInCache;
+
+		x1 = patch->originx;
+		width = SHORT(realpatch->width);
+		height = SHORT(realpatch->height);
+		x2 = x1 + width;
+
+		if (x1 > texture->width || x2 < 0)
+			continue; // patch not located within texture's x bounds, ignore
+
+		if (patch->originy > texture->height || (patch->originy + height) < 0)
+			continue; // patch not located within texture's y bounds, ignore
+
+		// patch is actually inside the texture!
+		// now check if texture is partly off-screen and adjust accordingly
+
+		// left edge
+		if (x1 < 0)
+			x = 0;
+		else
+			x = x1;
+
+		// right edge
+		if (x2 > texture->width)
+			x2 = texture->width;
+
+		for (; x < x2; x++)
+		{
+			if (patch->flip & 1)
+				patchcol = (column_t *)((UINT8 *)realpatch + LONG(realpatch->columnofs[(x1+width-1)-x]));
+			else
+				patchcol = (column_t *)((UINT8 *)realpatch + LONG(realpatch->columnofs[x-x1]));
+
+			// generate column ofset lookup
+			*(UINT32 *)&colofs[x<<2] = LONG((x * texture->height) + (texture->width*4));
+			ColumnDrawerPointer(patchcol, block + LONG(*(UINT32 *)&colofs[x<<2]), patch, texture->height, height);
+		}
+	}
+}
+
 //
 // R_GenerateTexture
 //
@@ -263,11 +419,11 @@ UINT8 *R_GenerateTexture(size_t texnum)
 	UINT8 *blocktex;
 	texture_t *texture;
 	texpatch_t *patch;
+	texpatchdata_t *patches;
 	softwarepatch_t *realpatch;
 	UINT8 *pdata;
-	int x, x1, x2, i, width, height;
+	int x;
 	size_t blocksize;
-	column_t *patchcol;
 	UINT8 *colofs;
 
 	UINT16 wadnum;
@@ -337,6 +493,7 @@ UINT8 *R_GenerateTexture(size_t texnum)
 				&texturecache[texnum]);
 			M_Memcpy(block, realpatch, blocksize);
 			texturememory += blocksize;
+			R_AddToTextureCache(texnum, blocksize);
 
 			// use the patch's column lookup
 			colofs = (block + 8);
@@ -360,104 +517,21 @@ UINT8 *R_GenerateTexture(size_t texnum)
 
 	// multi-patch textures (or 'composite')
 	multipatch:
-	texture->holes = false;
-	texture->flip = 0;
-	blocksize = (texture->width * 4) + (texture->width * texture->height);
-	texturememory += blocksize;
-	block = Z_Malloc(blocksize+1, PU_STATIC, &texturecache[texnum]);
-
-	memset(block, TRANSPARENTPIXEL, blocksize+1); // Transparency hack
-
-	// columns lookup table
-	colofs = block;
-	texturecolumnofs[texnum] = (UINT32 *)colofs;
-
-	// texture data after the lookup table
+	block = R_AllocateCompositeTexture(texnum);
 	blocktex = block + (texture->width*4);
 
 	// Composite the columns together.
-	for (i = 0, patch = texture->patches; i < texture->patchcount; i++, patch++)
-	{
-		boolean dealloc = true;
-		static void (*ColumnDrawerPointer)(column_t *, UINT8 *, texpatch_t *, INT32, INT32); // Column drawing function pointer.
-		if (patch->style != AST_COPY)
-			ColumnDrawerPointer = (patch->flip & 2) ? R_DrawBlendFlippedColumnInCache : R_DrawBlendColumnInCache;
-		else
-			ColumnDrawerPointer = (patch->flip & 2) ? R_DrawFlippedColumnInCache : R_DrawColumnInCache;
-
-		wadnum = patch->wad;
-		lumpnum = patch->lump;
-		pdata = W_CacheLumpNumPwad(wadnum, lumpnum, PU_CACHE);
-		lumplength = W_LumpLengthPwad(wadnum, lumpnum);
-		realpatch = (softwarepatch_t *)pdata;
-		dealloc = true;
-
-#ifndef NO_PNG_LUMPS
-		if (Picture_IsLumpPNG((UINT8 *)realpatch, lumplength))
-			realpatch = (softwarepatch_t *)Picture_PNGConvert((UINT8 *)realpatch, PICFMT_DOOMPATCH, NULL, NULL, NULL, NULL, lumplength, NULL, 0);
-		else
-#endif
-#ifdef WALLFLATS
-		if (texture->type == TEXTURETYPE_FLAT)
-			realpatch = (softwarepatch_t *)Picture_Convert(PICFMT_FLAT, pdata, PICFMT_DOOMPATCH, 0, NULL, texture->width, texture->height, 0, 0, 0);
-		else
-#endif
-		{
-			(void)lumplength;
-			dealloc = false;
-		}
-
-		x1 = patch->originx;
-		width = SHORT(realpatch->width);
-		height = SHORT(realpatch->height);
-		x2 = x1 + width;
-
-		if (x1 > texture->width || x2 < 0)
-		{
-			if (dealloc)
-				Z_Free(realpatch);
-			continue; // patch not located within texture's x bounds, ignore
-		}
-
-		if (patch->originy > texture->height || (patch->originy + height) < 0)
-		{
-			if (dealloc)
-				Z_Free(realpatch);
-			continue; // patch not located within texture's y bounds, ignore
-		}
-
-		// patch is actually inside the texture!
-		// now check if texture is partly off-screen and adjust accordingly
-
-		// left edge
-		if (x1 < 0)
-			x = 0;
-		else
-			x = x1;
-
-		// right edge
-		if (x2 > texture->width)
-			x2 = texture->width;
-
-		for (; x < x2; x++)
-		{
-			if (patch->flip & 1)
-				patchcol = (column_t *)((UINT8 *)realpatch + LONG(realpatch->columnofs[(x1+width-1)-x]));
-			else
-				patchcol = (column_t *)((UINT8 *)realpatch + LONG(realpatch->columnofs[x-x1]));
-
-			// generate column ofset lookup
-			*(UINT32 *)&colofs[x<<2] = LONG((x * texture->height) + (texture->width*4));
-			ColumnDrawerPointer(patchcol, block + LONG(*(UINT32 *)&colofs[x<<2]), patch, texture->height, height);
-		}
-
-		if (dealloc)
-			Z_Free(realpatch);
-	}
+	patches = R_CacheTexturePatches(texture);
+	R_CompositeTexture(texture, block, patches);
+	R_FreeTexturePatches(texture, patches);
 
 done:
 	// Now that the texture has been built in column cache, it is purgable from zone memory.
 	Z_ChangeTag(block, PU_CACHE);
+
+	if (!texcache.pregenerating)
+		texcache.ondemand++;
+
 	return blocktex;
 }
 
@@ -511,6 +585,7 @@ void R_CheckTextureCache(INT32 tex)
 {
 	if (!texturecache[tex])
 		R_GenerateTexture(tex);
+	texturelastused[tex] = texturecacheframe;
 }
 
 //
@@ -529,10 +604,240 @@ UINT8 *R_GetColumn(fixed_t tex, INT32 col)
 	data = texturecache[tex];
 	if (!data)
 		data = R_GenerateTexture(tex);
+	texturelastused[tex] = texturecacheframe;
 
 	return data + LONG(texturecolumnofs[tex][col]);
 }
 
+static int R_CompareTextureAge(const void *a, const void *b)
+{
+	UINT32 agea = texturelastused[*(const INT32 *)a];
+	UINT32 ageb = texturelastused[*(const INT32 *)b];
+	return (agea > ageb) - (agea < ageb);
+}
+
+//
+// R_NextTextureCacheFrame
+//
+// Starts a new frame for the texture cache's ages. Call this once for each
+// displayed frame, not for each view, so that in splitscreen the textures
+// drawn by the first view don't look old while the second one is drawn.
+//
+void R_NextTextureCacheFrame(void)
+{
+	texturecacheframe++;
+}
+
+//
+// R_TrimTextureCache
+//
+// Frees the textures that have gone unused the longest until the cache
+// fits in r_texturecachesize again. Call this between views, since the
+// renderer keeps pointers into textures until the view is drawn.
+//
+void R_TrimTextureCache(void)
+{
+	const size_t budget = (size_t)cv_texturecachesize.value << 20;
+	INT32 *unused;
+	INT32 i, count = 0;
+
+	if (!budget || texcache.used <= budget)
+		return;
+
+	// PU_CACHE blocks can be purged without us knowing.
+	texcache.used = 0;
+	for (i = 0; i < numtextures; i++)
+		if (texturecache[i])
+			texcache.used += texturecachebytes[i];
+
+	if (texcache.used <= budget)
+		return;
+
+	unused = malloc(numtextures * sizeof (*unused));
+	if (!unused)
+		return;
+
+	// Whatever was drawn this frame or the last is likely to be drawn again.
+	for (i = 0; i < numtextures; i++)
+		if (texturecache[i] && texturelastused[i] + 1 < texturecacheframe)
+			unused[count++] = i;
+
+	qsort(unused, count, sizeof (*unused), R_CompareTextureAge);
+
+	for (i = 0; i < count && texcache.used > budget; i++)
+	{
+		texcache.used -= texturecachebytes[unused[i]];
+		Z_Free(texturecache[unused[i]]);
+		texcache.evicted++;
+	}
+
+	free(unused);
+}
+
+// Textures whose patches are all copied in can be composited by any thread.
+static boolean R_CanCompositeOffThread(texture_t *texture)
+{
+	INT32 i;
+
+	// Single-patch textures might not need compositing at all.
+	if (texture->patchcount < 2)
+		return false;
+
+	for (i = 0; i < texture->patchcount; i++)
+		if (texture->patches[i].style != AST_COPY)
+			return false;
+
+	return true;
+}
+
+typedef struct
+{
+	INT32 texnum;
+	UINT8 *block;
+	texpatchdata_t *patches;
+} texturejob_t;
+
+static struct
+{
+	texturejob_t *jobs;
+	INT32 numjobs, nextjob;
+#ifdef HAVE_THREADS
+	INT32 workers;
+	I_mutex mutex;
+	I_cond cond;
+#endif
+} pregen;
+
+static void R_RunTextureJobs(void)
+{
+	for (;;)
+	{
+		texturejob_t *job = NULL;
+
+#ifdef HAVE_THREADS
+		I_lock_mutex(&pregen.mutex);
+#endif
+		if (pregen.nextjob < pregen.numjobs)
+			job = &pregen.jobs[pregen.nextjob++];
+#ifdef HAVE_THREADS
+		I_unlock_mutex(pregen.mutex);
+#endif
+
+		if (!job)
+			break;
+
+		R_CompositeTexture(textures[job->texnum], job->block, job->patches);
+	}
+}
+
+#ifdef HAVE_THREADS
+static void R_TextureWorker(void *userdata)
+{
+	(void)userdata;
+
+	R_RunTextureJobs();
+
+	I_lock_mutex(&pregen.mutex);
+	pregen.workers--;
+	I_wake_all_cond(&pregen.cond);
+	I_unlock_mutex(pregen.mutex);
+}
+#endif
+
+#define PREGEN_MAXWORKERS 7
+
+/** Generates the given textures ahead of time, as far as the cache
+  * budget allows. Multi-patch textures are composited on worker threads,
+  * with everything that touches the zone or the WADs done here first.
+  *
+  * \param present Nonzero for each texture number to generate.
+  */
+void R_PregenerateTextures(const char *present)
+{
+	const size_t budget = (size_t)cv_texturecachesize.value << 20;
+	precise_t start = I_GetPreciseTime();
+	INT32 i;
+
+	pregen.jobs = Z_Malloc(max(numtextures, 1) * sizeof (*pregen.jobs), PU_STATIC, NULL);
+	pregen.numjobs = pregen.nextjob = 0;
+	texcache.pregenerating = true;
+
+	for (i = 0; i < numtextures; i++)
+	{
+		if (!present[i] || texturecache[i])
+			continue;
+
+		if (budget && texcache.used >= budget)
+			break;
+
+		if (R_CanCompositeOffThread(textures[i]))
+		{
+			texturejob_t *job = &pregen.jobs[pregen.numjobs++];
+
+			job->texnum = i;
+			job->block = R_AllocateCompositeTexture(i);
+			job->patches = R_CacheTexturePatches(textures[i]);
+		}
+		else
+			R_GenerateTexture(i);
+
+		texcache.pregenerated++;
+	}
+
+#ifdef HAVE_THREADS
+	pregen.workers = max(0, min(min(I_GetCPUCount() - 1, PREGEN_MAXWORKERS), pregen.numjobs - 1));
+	for (i = 0; i < pregen.workers; i++)
+		I_spawn_thread("texture-gen", R_TextureWorker, NULL);
+#endif
+
+	R_RunTextureJobs();
+
+#ifdef HAVE_THREADS
+	I_lock_mutex(&pregen.mutex);
+	while (pregen.workers > 0)
+		I_hold_cond(&pregen.cond, pregen.mutex);
+	I_unlock_mutex(pregen.mutex);
+#endif
+
+	for (i = 0; i < pregen.numjobs; i++)
+	{
+		texturejob_t *job = &pregen.jobs[i];
+
+		R_FreeTexturePatches(textures[job->texnum], job->patches);
+		Z_ChangeTag(job->block, PU_CACHE);
+	}
+
+	Z_Free(pregen.jobs);
+	pregen.jobs = NULL;
+	texcache.pregenerating = false;
+	texcache.pregentime = I_GetPreciseTime() - start;
+}
+
+void Command_TextureCache_f(void)
+{
+	INT32 i, count = 0;
+
+	texcache.used = 0;
+	for (i = 0; i < numtextures; i++)
+	{
+		if (!texturecache[i])
+			continue;
+		texcache.used += texturecachebytes[i];
+		count++;
+	}
+
+	CONS_Printf(M_GetText("Cached textures:   %d of %d\n"), count, numtextures);
+	CONS_Printf(M_GetText("Memory used:       %s KB\n"), sizeu1(texcache.used>>10));
+	if (cv_texturecachesize.value)
+		CONS_Printf(M_GetText("Budget:            %s KB\n"), sizeu1((size_t)cv_texturecachesize.value<<10));
+	else
+		CONS_Printf(M_GetText("Budget:            none\n"));
+	CONS_Printf(M_GetText("Pregenerated:      %u (%.2f ms)\n"), texcache.pregenerated,
+		(double)texcache.pregentime * 1000.0 / I_GetPrecisePrecision());
+	CONS_Printf(M_GetText("Generated on use:  %u\n"), texcache.ondemand);
+	CONS_Printf(M_GetText("Evicted:           %u\n"), texcache.evicted);
+}
+
 void *R_GetFlat(lumpnum_t flatlumpnum)
 {
 	return W_CacheLumpNum(flatlumpnum, PU_CACHE);
@@ -723,6 +1028,7 @@ void R_FlushTextureCache(void)
 	if (numtextures)
 		for (i = 0; i < numtextures; i++)
 			Z_Free(texturecache[i]);
+	texcache.used = 0;
 }
 
 // Need these prototypes for later; defining them here instead of r_textures.h so they're "private"
@@ -1019,6 +1325,9 @@ static void R_AllocateTextures(INT32 add)
 	recallocuser(&texturecolumnofs, oldsize, newsize);
 	// Allocate texture referencing cache.
 	recallocuser(&texturecache, oldsize, newsize);
+	// Allocate texture cache bookkeeping.
+	recallocuser(&texturecachebytes, numtextures * sizeof (*texturecachebytes), newtextures * sizeof (*texturecachebytes));
+	recallocuser(&texturelastused, numtextures * sizeof (*texturelastused), newtextures * sizeof (*texturelastused));
 	// Allocate texture width table.
 	recallocuser(&texturewidth, oldsize, newsize);
 	// Allocate texture height table.
@@ -85,6 +85,12 @@ UINT8 *R_GenerateTexture(size_t texnum);
 UINT8 *R_GenerateTextureAsFlat(size_t texnum);
 INT32 R_GetTextureNum(INT32 texnum);
 void R_CheckTextureCache(INT32 tex);
+void R_NextTextureCacheFrame(void);
+void R_TrimTextureCache(void);
+void R_PregenerateTextures(const char *present);
+void Command_TextureCache_f(void);
+
+extern consvar_t cv_texturecachesize;
 void R_ClearTextureNumCache(boolean btell);
 
 // Retrieve texture data.
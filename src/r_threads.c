@@ -0,0 +1,842 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 1999-2023 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  r_threads.c
+/// \brief Software renderer drawing on worker threads
+///
+///	While r_threads is above 1 or r_deferred is on, R_RenderPlayerView
+///	still walks the BSP, clips walls and builds visplanes, drawsegs and
+///	vissprites on the main thread, but the column and span drawers it calls
+///	are queued instead of run. At a flush, the view is cut into vertical
+///	tiles, the queue is sorted into a list per tile, and each tile replays
+///	its own list in order, drawing only the pixels inside it. Every pixel
+///	still sees the same drawers in the same order as before, so the
+///	picture comes out exactly the same.
+///
+///	With r_deferred the tiles are narrow enough that a tile's part of the
+///	screen stays in the cache while it is drawn, instead of one strip per
+///	thread. The commands in a tile aren't reordered by texture, since
+///	anything translucent or masked depends on what was drawn under it.
+
+#include "doomdef.h"
+#include "command.h"
+#include "i_system.h"
+#include "i_threads.h"
+#include "i_video.h"
+#include "m_perfstats.h"
+#include "r_local.h"
+#include "v_video.h"
+#include "z_zone.h"
+
+#ifdef HAVE_RENDERTHREADS
+
+#define STRIPALIGN 32 // strip edges fall on multiples of this, in pixels
+#define MINSTRIPWIDTH 8 // see R_RecordSpan
+#define TILEWIDTH 64 // tile width with r_deferred on
+#define MAXTILES (MAXVIDWIDTH/TILEWIDTH + 1)
+
+static CV_PossibleValue_t renderthreads_cons_t[] = {{0, "MIN"}, {MAXRENDERTHREADS, "MAX"}, {0, NULL}};
+consvar_t cv_renderthreads = CVAR_INIT ("r_threads", "0", CV_SAVE, renderthreads_cons_t, NULL);
+consvar_t cv_deferreddraws = CVAR_INIT ("r_deferred", "Off", CV_SAVE, CV_OnOff, NULL);
+
+boolean rt_recording = false;
+
+enum
+{
+	RT_FORCE_NONE,
+	RT_FORCE_DIRECT,
+	RT_FORCE_DEFERRED
+};
+
+typedef enum
+{
+	RT_COLUMN,
+	RT_SPAN, // affine, power of two: clipped by stepping the start
+	RT_SPAN_NPO2, // affine, any size: same, but the start is wrapped
+	RT_SPAN_TILTED, // drawn whole into a spare row, see R_DrawSpanInTile
+	RT_SPAN_PIXELS // already drawn when it was queued, see R_RecordSpan
+} rtcmdtype_t;
+
+typedef struct
+{
+	lighttable_t *colormap;
+	UINT8 *source, *transmap, *translation;
+	INT32 x, yl, yh, texheight;
+	fixed_t iscale, texturemid;
+	UINT8 hires;
+} rtcolumn_t;
+
+typedef struct
+{
+	lighttable_t *colormap, *translation, **zlight;
+	UINT8 *source, *transmap;
+	INT32 y, x1, x2, waterofs, bgofs;
+	fixed_t xfrac, yfrac, xstep, ystep;
+	UINT32 xshift, yshift, shiftup, mask;
+	UINT16 flatwidth, flatheight;
+	boolean powersoftwo, solidcolor;
+	float zeroheight; // for the slope lighting
+	size_t data; // su, sv and sz in rt.vectors, or the pixels in rt.pixels
+} rtspan_t;
+
+// Column sources made up on the spot, see R_AllocQueuedSource
+#define SOURCEBLOCKSIZE 65536
+
+typedef struct rtsourceblock_s
+{
+	struct rtsourceblock_s *next;
+	size_t used;
+	UINT8 data[SOURCEBLOCKSIZE];
+} rtsourceblock_t;
+
+typedef struct
+{
+	void (*func)(void);
+	rtcmdtype_t type;
+	union
+	{
+		rtcolumn_t column;
+		rtspan_t span;
+	} u;
+} rtcommand_t;
+
+static struct
+{
+	rtcommand_t *commands;
+	size_t numcommands, maxcommands;
+	floatv3_t *vectors;
+	size_t numvectors, maxvectors;
+	UINT8 *pixels;
+	size_t numpixels, maxpixels;
+
+	// Blocks are kept from one flush to the next and never move, so
+	// queued columns can point into them
+	rtsourceblock_t *sourceblocks, *cursource;
+
+	// Indices into commands, sorted by tile; tile t's run starts at
+	// tilefirst[t] and ends at tilefirst[t+1]
+	UINT32 *bins;
+	size_t maxbins;
+	size_t tilefirst[MAXTILES+1];
+
+	// The main thread's row table, which the workers take a copy of
+	UINT8 *lookup[MAXVIDHEIGHT*4];
+	INT32 lookuprows;
+	UINT32 lookupgen;
+
+	INT32 tilex[MAXTILES+1];
+	INT32 tilewidth;
+	INT32 numtiles, nexttile, pending;
+
+	INT32 workers;
+	boolean stopping;
+
+	// Set by R_BeginThreadedDraws; r_checkdeferred overrides the cvars
+	boolean deferred;
+	INT32 force;
+	boolean checkrequested;
+
+	I_mutex mutex;
+	I_cond cond;
+} rt;
+
+// malloc'd, since the zone isn't safe to use off the main thread
+static R_THREADLOCAL UINT8 *scratchrow;
+static R_THREADLOCAL size_t scratchsize;
+static R_THREADLOCAL UINT32 lookupgen;
+
+static const INT32 tiltedspans[] =
+{
+	SPANDRAWFUNC_TILTED,
+	SPANDRAWFUNC_TILTEDTRANS,
+	SPANDRAWFUNC_TILTEDSPLAT,
+	SPANDRAWFUNC_TILTEDSPRITE,
+	SPANDRAWFUNC_TILTEDTRANSSPRITE,
+	SPANDRAWFUNC_TILTEDWATER,
+	SPANDRAWFUNC_TILTEDSOLID,
+	SPANDRAWFUNC_TILTEDTRANSSOLID,
+	SPANDRAWFUNC_TILTEDWATERSOLID,
+	SPANDRAWFUNC_TILTEDFOG
+};
+
+// Tilted spans that never read what's under them
+static const INT32 bakedspans[] =
+{
+	SPANDRAWFUNC_TILTED,
+	SPANDRAWFUNC_TILTEDWATER,
+	SPANDRAWFUNC_TILTEDSOLID,
+	SPANDRAWFUNC_TILTEDWATERSOLID
+};
+
+static void R_SaveColumn(rtcolumn_t *c)
+{
+	c->colormap = dc_colormap;
+	c->source = dc_source;
+	c->transmap = dc_transmap;
+	c->translation = dc_translation;
+	c->x = dc_x;
+	c->yl = dc_yl;
+	c->yh = dc_yh;
+	c->texheight = dc_texheight;
+	c->iscale = dc_iscale;
+	c->texturemid = dc_texturemid;
+	c->hires = dc_hires;
+}
+
+static void R_LoadColumn(const rtcolumn_t *c)
+{
+	dc_colormap = c->colormap;
+	dc_source = c->source;
+	dc_transmap = c->transmap;
+	dc_translation = c->translation;
+	dc_x = c->x;
+	dc_yl = c->yl;
+	dc_yh = c->yh;
+	dc_texheight = c->texheight;
+	dc_iscale = c->iscale;
+	dc_texturemid = c->texturemid;
+	dc_hires = c->hires;
+}
+
+static void R_SaveSpan(rtspan_t *s)
+{
+	s->colormap = ds_colormap;
+	s->translation = ds_translation;
+	s->zlight = planezlight;
+	s->source = ds_source;
+	s->transmap = ds_transmap;
+	s->y = ds_y;
+	s->x1 = ds_x1;
+	s->x2 = ds_x2;
+	s->waterofs = ds_waterofs;
+	s->bgofs = ds_bgofs;
+	s->xfrac = ds_xfrac;
+	s->yfrac = ds_yfrac;
+	s->xstep = ds_xstep;
+	s->ystep = ds_ystep;
+	s->xshift = nflatxshift;
+	s->yshift = nflatyshift;
+	s->shiftup = nflatshiftup;
+	s->mask = nflatmask;
+	s->flatwidth = ds_flatwidth;
+	s->flatheight = ds_flatheight;
+	s->powersoftwo = ds_powersoftwo;
+	s->solidcolor = ds_solidcolor;
+	s->zeroheight = zeroheight;
+}
+
+static void R_LoadSpan(const rtspan_t *s)
+{
+	ds_colormap = s->colormap;
+	ds_translation = s->translation;
+	planezlight = s->zlight;
+	ds_source = s->source;
+	ds_transmap = s->transmap;
+	ds_y = s->y;
+	ds_x1 = s->x1;
+	ds_x2 = s->x2;
+	ds_waterofs = s->waterofs;
+	ds_bgofs = s->bgofs;
+	ds_xfrac = s->xfrac;
+	ds_yfrac = s->yfrac;
+	ds_xstep = s->xstep;
+	ds_ystep = s->ystep;
+	nflatxshift = s->xshift;
+	nflatyshift = s->yshift;
+	nflatshiftup = s->shiftup;
+	nflatmask = s->mask;
+	ds_flatwidth = s->flatwidth;
+	ds_flatheight = s->flatheight;
+	ds_powersoftwo = s->powersoftwo;
+	ds_solidcolor = s->solidcolor;
+	zeroheight = s->zeroheight;
+}
+
+static rtcommand_t *R_NewCommand(void (*func)(void), rtcmdtype_t type)
+{
+	rtcommand_t *cmd;
+
+	if (rt.numcommands == rt.maxcommands)
+	{
+		rt.maxcommands = rt.maxcommands ? rt.maxcommands*2 : 4096;
+		rt.commands = Z_Realloc(rt.commands, rt.maxcommands * sizeof (*rt.commands), PU_STATIC, NULL);
+	}
+
+	cmd = &rt.commands[rt.numcommands++];
+	cmd->func = func;
+	cmd->type = type;
+	return cmd;
+}
+
+static rtcmdtype_t R_SpanType(void (*func)(void))
+{
+	size_t i;
+
+	for (i = 0; i < sizeof (bakedspans) / sizeof (*bakedspans); i++)
+		if (func == spanfuncs[bakedspans[i]] || func == spanfuncs_npo2[bakedspans[i]])
+			return RT_SPAN_PIXELS;
+
+	for (i = 0; i < sizeof (tiltedspans) / sizeof (*tiltedspans); i++)
+		if (func == spanfuncs[tiltedspans[i]] || func == spanfuncs_npo2[tiltedspans[i]])
+			return RT_SPAN_TILTED;
+
+	for (i = 0; i < SPANDRAWFUNC_MAX; i++)
+		if (func == spanfuncs_npo2[i])
+			return RT_SPAN_NPO2;
+
+	return RT_SPAN;
+}
+
+static void R_CheckScratchRow(void)
+{
+	if (scratchsize >= vid.rowbytes)
+		return;
+
+	free(scratchrow);
+	scratchrow = malloc(vid.rowbytes);
+	scratchsize = scratchrow ? vid.rowbytes : 0;
+	if (!scratchrow)
+		I_Error("R_CheckScratchRow: out of memory");
+}
+
+/** Queues a column with the current dc_ parameters.
+  *
+  * \param func The column drawer.
+  */
+void R_RecordColumn(void (*func)(void))
+{
+	// It only splits the column up by light level, and the pieces
+	// come back through here.
+	if (func == colfuncs[COLDRAWFUNC_SHADOWED])
+	{
+		func();
+		return;
+	}
+
+	R_SaveColumn(&R_NewCommand(func, RT_COLUMN)->u.column);
+}
+
+/** Queues a span with the current ds_ parameters.
+  *
+  * \param func The span drawer.
+  */
+void R_RecordSpan(void (*func)(void))
+{
+	rtcmdtype_t type = R_SpanType(func);
+	rtcommand_t *cmd;
+
+	// The basic span drawers give up on a span starting in the last eight
+	// bytes of the screen. Strips are at least that wide, so a piece of
+	// a span that was drawn will never give up on its own.
+	if ((func == spanfuncs[BASEDRAWFUNC] || func == spanfuncs_npo2[BASEDRAWFUNC])
+		&& ylookup[ds_y] + columnofs[ds_x1] + 8 > screens[0] + vid.rowbytes * vid.height)
+		return;
+
+	cmd = R_NewCommand(func, type);
+	R_SaveSpan(&cmd->u.span);
+
+	if (type == RT_SPAN_PIXELS)
+	{
+		// Cutting a tilted span up means drawing all of it for every tile
+		// it touches. When the result doesn't depend on the screen, draw
+		// it once now and let the tiles copy their part.
+		UINT8 *row = ylookup[ds_y];
+		size_t len = ds_x2 - ds_x1 + 1;
+
+		if (rt.numpixels + len > rt.maxpixels)
+		{
+			rt.maxpixels = max(rt.maxpixels*2, rt.numpixels + len);
+			rt.pixels = Z_Realloc(rt.pixels, rt.maxpixels, PU_STATIC, NULL);
+		}
+
+		R_CheckScratchRow();
+		ylookup[ds_y] = scratchrow;
+		func();
+		ylookup[ds_y] = row;
+
+		cmd->u.span.data = rt.numpixels;
+		M_Memcpy(rt.pixels + rt.numpixels, scratchrow + columnofs[cmd->u.span.x1], len);
+		rt.numpixels += len;
+	}
+	else if (type == RT_SPAN_TILTED)
+	{
+		if (rt.numvectors + 3 > rt.maxvectors)
+		{
+			rt.maxvectors = rt.maxvectors ? rt.maxvectors*2 : 3*1024;
+			rt.vectors = Z_Realloc(rt.vectors, rt.maxvectors * sizeof (*rt.vectors), PU_STATIC, NULL);
+		}
+
+		cmd->u.span.data = rt.numvectors;
+		rt.vectors[rt.numvectors++] = *ds_sup;
+		rt.vectors[rt.numvectors++] = *ds_svp;
+		rt.vectors[rt.numvectors++] = *ds_szp;
+	}
+}
+
+/** Gets memory for a column source that only lives as long as the
+  * column does. It stays valid until the queue is flushed.
+  *
+  * \param len Size of the source in bytes, at most SOURCEBLOCKSIZE.
+  */
+UINT8 *R_AllocQueuedSource(size_t len)
+{
+	UINT8 *source;
+
+	if (!rt.cursource || rt.cursource->used + len > SOURCEBLOCKSIZE)
+	{
+		rtsourceblock_t *block = rt.cursource ? rt.cursource->next : rt.sourceblocks;
+
+		if (!block)
+		{
+			block = Z_Malloc(sizeof (*block), PU_STATIC, NULL);
+			block->next = NULL;
+			if (rt.cursource)
+				rt.cursource->next = block;
+			else
+				rt.sourceblocks = block;
+		}
+
+		block->used = 0;
+		rt.cursource = block;
+	}
+
+	source = rt.cursource->data + rt.cursource->used;
+	rt.cursource->used += len;
+	return source;
+}
+
+// Brings a texture position into [0, size), the same as the NPO2 drawers
+// would have by the time they reached it.
+static fixed_t R_WrapPosition(INT64 pos, INT64 size)
+{
+	pos %= size;
+	if (pos < 0)
+		pos += size;
+	return (fixed_t)pos;
+}
+
+static void R_DrawSpanInTile(const rtcommand_t *cmd, INT32 tx1, INT32 tx2)
+{
+	const rtspan_t *span = &cmd->u.span;
+	INT32 x1 = max(span->x1, tx1);
+	INT32 x2 = min(span->x2, tx2);
+	INT32 skip;
+
+	if (x1 > x2)
+		return;
+
+	if (cmd->type == RT_SPAN_PIXELS)
+	{
+		M_Memcpy(ylookup[span->y] + columnofs[x1], rt.pixels + span->data + (x1 - span->x1), x2 - x1 + 1);
+		return;
+	}
+
+	R_LoadSpan(span);
+
+	if (cmd->type == RT_SPAN_TILTED)
+	{
+		ds_sup = &rt.vectors[span->data];
+		ds_svp = &rt.vectors[span->data + 1];
+		ds_szp = &rt.vectors[span->data + 2];
+	}
+
+	if (x1 == span->x1 && x2 == span->x2)
+	{
+		cmd->func();
+		return;
+	}
+
+	if (cmd->type == RT_SPAN_TILTED)
+	{
+		// The slope drawers step their texture coordinates in blocks from
+		// the start of the span, so a piece of one wouldn't come out the
+		// same. Draw the whole thing into a spare row and keep our part.
+		UINT8 *row = ylookup[span->y];
+		size_t ofs = columnofs[x1], len = (x2 - x1 + 1) * vid.bpp;
+
+		M_Memcpy(scratchrow + ofs, row + ofs, len);
+		ylookup[span->y] = scratchrow;
+		cmd->func();
+		ylookup[span->y] = row;
+		M_Memcpy(row + ofs, scratchrow + ofs, len);
+		return;
+	}
+
+	skip = x1 - span->x1;
+	if (skip)
+	{
+		if (cmd->type == RT_SPAN_NPO2)
+		{
+			INT32 waterofs = (cmd->func == spanfuncs_npo2[SPANDRAWFUNC_WATER]) ? span->waterofs : 0;
+
+			ds_xfrac = R_WrapPosition((INT64)span->xfrac + (INT64)skip * span->xstep,
+				(INT64)span->flatwidth << FRACBITS);
+			ds_yfrac = R_WrapPosition((INT64)span->yfrac + waterofs + (INT64)skip * span->ystep,
+				(INT64)span->flatheight << FRACBITS) - waterofs;
+		}
+		else
+		{
+			ds_xfrac = (fixed_t)((UINT32)span->xfrac + (UINT32)skip * (UINT32)span->xstep);
+			ds_yfrac = (fixed_t)((UINT32)span->yfrac + (UINT32)skip * (UINT32)span->ystep);
+		}
+	}
+
+	ds_x1 = x1;
+	ds_x2 = x2;
+	cmd->func();
+}
+
+static void R_DrawTile(INT32 tile)
+{
+	INT32 tx1 = rt.tilex[tile], tx2 = rt.tilex[tile+1] - 1;
+	size_t i;
+
+	R_CheckScratchRow();
+
+	for (i = rt.tilefirst[tile]; i < rt.tilefirst[tile+1]; i++)
+	{
+		const rtcommand_t *cmd = &rt.commands[rt.bins[i]];
+
+		if (cmd->type == RT_COLUMN)
+		{
+			R_LoadColumn(&cmd->u.column);
+			cmd->func();
+		}
+		else
+			R_DrawSpanInTile(cmd, tx1, tx2);
+	}
+}
+
+static void R_DrawWorker(void *userdata)
+{
+	(void)userdata;
+
+	I_lock_mutex(&rt.mutex);
+	for (;;)
+	{
+		INT32 tile;
+
+		while (!rt.stopping && rt.nexttile >= rt.numtiles)
+			I_hold_cond(&rt.cond, rt.mutex);
+
+		if (rt.stopping)
+			break;
+
+		tile = rt.nexttile++;
+		I_unlock_mutex(rt.mutex);
+
+		if (lookupgen != rt.lookupgen)
+		{
+			M_Memcpy(ylookup, rt.lookup, rt.lookuprows * sizeof (*ylookup));
+			lookupgen = rt.lookupgen;
+		}
+		R_DrawTile(tile);
+
+		I_lock_mutex(&rt.mutex);
+		if (--rt.pending == 0)
+			I_wake_all_cond(&rt.cond);
+	}
+	rt.workers--;
+	I_wake_all_cond(&rt.cond);
+	I_unlock_mutex(rt.mutex);
+}
+
+static void R_StopDrawWorkers(void)
+{
+	I_lock_mutex(&rt.mutex);
+	rt.stopping = true;
+	I_wake_all_cond(&rt.cond);
+	while (rt.workers > 0)
+		I_hold_cond(&rt.cond, rt.mutex);
+	I_unlock_mutex(rt.mutex);
+}
+
+// Cuts the view into tiles, none narrower than MINSTRIPWIDTH, and
+// returns how many there are. Without r_deferred, there's one strip
+// for each thread.
+static INT32 R_CutTiles(INT32 numthreads)
+{
+	INT32 width = TILEWIDTH;
+	INT32 i, x;
+
+	if (!rt.deferred)
+	{
+		width = (viewwidth + numthreads - 1) / numthreads;
+		width = (width + STRIPALIGN - 1) & ~(STRIPALIGN - 1);
+	}
+
+	for (i = 0, x = 0; x < viewwidth; i++, x += width)
+		rt.tilex[i] = x;
+
+	// A sliver at the right edge goes to its neighbour.
+	if (i > 1 && viewwidth - rt.tilex[i-1] < MINSTRIPWIDTH)
+		i--;
+
+	rt.tilex[i] = viewwidth;
+	rt.tilewidth = width;
+	return i;
+}
+
+static INT32 R_TileAt(INT32 x, INT32 numtiles)
+{
+	INT32 tile = x / rt.tilewidth;
+	return max(0, min(tile, numtiles - 1));
+}
+
+// Sorts the queue into a list for each tile, keeping the order the
+// commands came in. A span goes into every tile it crosses.
+static void R_BinCommands(INT32 numtiles)
+{
+	size_t next[MAXTILES];
+	size_t i;
+	INT32 t;
+
+	memset(rt.tilefirst, 0, (numtiles + 1) * sizeof (*rt.tilefirst));
+
+	for (i = 0; i < rt.numcommands; i++)
+	{
+		const rtcommand_t *cmd = &rt.commands[i];
+
+		if (cmd->type == RT_COLUMN)
+			rt.tilefirst[R_TileAt(cmd->u.column.x, numtiles) + 1]++;
+		else
+		{
+			INT32 t2 = R_TileAt(cmd->u.span.x2, numtiles);
+			for (t = R_TileAt(cmd->u.span.x1, numtiles); t <= t2; t++)
+				rt.tilefirst[t + 1]++;
+		}
+	}
+
+	for (t = 0; t < numtiles; t++)
+	{
+		rt.tilefirst[t + 1] += rt.tilefirst[t];
+		next[t] = rt.tilefirst[t];
+	}
+
+	if (rt.tilefirst[numtiles] > rt.maxbins)
+	{
+		rt.maxbins = max(rt.maxbins*2, rt.tilefirst[numtiles]);
+		rt.bins = Z_Realloc(rt.bins, rt.maxbins * sizeof (*rt.bins), PU_STATIC, NULL);
+	}
+
+	for (i = 0; i < rt.numcommands; i++)
+	{
+		const rtcommand_t *cmd = &rt.commands[i];
+
+		if (cmd->type == RT_COLUMN)
+			rt.bins[next[R_TileAt(cmd->u.column.x, numtiles)]++] = (UINT32)i;
+		else
+		{
+			INT32 t2 = R_TileAt(cmd->u.span.x2, numtiles);
+			for (t = R_TileAt(cmd->u.span.x1, numtiles); t <= t2; t++)
+				rt.bins[next[t]++] = (UINT32)i;
+		}
+	}
+
+	ps_sw_numdrawbinned.value.i += rt.tilefirst[numtiles];
+}
+
+/** Starts queueing drawer calls, if r_threads or r_deferred asks for it.
+  */
+void R_BeginThreadedDraws(void)
+{
+	rt.numcommands = rt.numvectors = rt.numpixels = 0;
+	rt.cursource = NULL;
+
+	if (rt.force)
+	{
+		rt.deferred = (rt.force == RT_FORCE_DEFERRED);
+		rt_recording = (rt.deferred && vid.bpp == 1 && !rt.stopping);
+	}
+	else
+	{
+		rt.deferred = cv_deferreddraws.value;
+		rt_recording = ((cv_renderthreads.value > 1 || rt.deferred)
+			&& vid.bpp == 1 && !rt.stopping);
+	}
+
+	ps_sw_numdrawcmds.value.i = 0;
+	ps_sw_numdrawtiles.value.i = 0;
+	ps_sw_numdrawbinned.value.i = 0;
+	ps_sw_drawqueuetime.value.p = 0;
+}
+
+/** Draws everything queued so far, splitting the view up between the
+  * main thread and the workers, and waits for them to finish.
+  * Anything that reads back from the screen has to flush first.
+  */
+void R_FlushThreadedDraws(void)
+{
+	INT32 numthreads = max(cv_renderthreads.value, 1);
+	INT32 numtiles;
+
+	if (!rt.numcommands)
+		return;
+
+	numtiles = R_CutTiles(numthreads);
+	numthreads = min(numthreads, numtiles);
+	R_BinCommands(numtiles);
+
+	ps_sw_numdrawcmds.value.i += rt.numcommands;
+	ps_sw_numdrawtiles.value.i += numtiles;
+
+	if (rt.workers < numthreads - 1)
+	{
+		// Workers waiting on the condition would hang I_stop_threads.
+		if (!rt.workers)
+			I_AddExitFunc(R_StopDrawWorkers);
+
+		I_lock_mutex(&rt.mutex);
+		while (rt.workers < numthreads - 1)
+		{
+			rt.workers++;
+			I_spawn_thread("render-tiles", R_DrawWorker, NULL);
+		}
+		I_unlock_mutex(rt.mutex);
+	}
+
+	rt.lookuprows = viewheight;
+	M_Memcpy(rt.lookup, ylookup, rt.lookuprows * sizeof (*ylookup));
+	rt.lookupgen++;
+
+	{
+		// Whatever the renderer left in the drawer globals has to survive
+		// our tiles going through them.
+		rtcolumn_t column;
+		rtspan_t span;
+		floatv3_t *sup = ds_sup, *svp = ds_svp, *szp = ds_szp;
+
+		R_SaveColumn(&column);
+		R_SaveSpan(&span);
+
+		I_lock_mutex(&rt.mutex);
+		rt.numtiles = numtiles;
+		rt.nexttile = 0;
+		rt.pending = numtiles;
+		if (numthreads > 1)
+			I_wake_all_cond(&rt.cond);
+
+		while (rt.nexttile < rt.numtiles)
+		{
+			INT32 tile = rt.nexttile++;
+
+			I_unlock_mutex(rt.mutex);
+			R_DrawTile(tile);
+			I_lock_mutex(&rt.mutex);
+			rt.pending--;
+		}
+
+		while (rt.pending > 0)
+			I_hold_cond(&rt.cond, rt.mutex);
+		I_unlock_mutex(rt.mutex);
+
+		R_LoadColumn(&column);
+		R_LoadSpan(&span);
+		ds_sup = sup;
+		ds_svp = svp;
+		ds_szp = szp;
+	}
+
+	rt.numcommands = rt.numvectors = rt.numpixels = 0;
+	rt.cursource = NULL;
+}
+
+/** Draws whatever is left in the queue and goes back to calling the
+  * drawers directly.
+  */
+void R_EndThreadedDraws(void)
+{
+	if (!rt_recording)
+		return;
+
+	PS_START_TIMING(ps_sw_drawqueuetime);
+	R_FlushThreadedDraws();
+	PS_STOP_TIMING(ps_sw_drawqueuetime);
+	rt_recording = false;
+}
+
+static void R_CompareScreens(const UINT8 *direct, const UINT8 *deferred)
+{
+	INT32 x, y, firstx = -1, firsty = -1;
+	size_t differ = 0;
+
+	for (y = 0; y < vid.height; y++)
+		for (x = 0; x < vid.width; x++)
+			if (direct[y * vid.rowbytes + x] != deferred[y * vid.rowbytes + x])
+			{
+				if (!differ++)
+				{
+					firstx = x;
+					firsty = y;
+				}
+			}
+
+	if (differ)
+		CONS_Alert(CONS_WARNING, "r_checkdeferred: %s pixels differ, the first at (%d, %d)\n",
+			sizeu1(differ), firstx, firsty);
+	else
+		CONS_Printf("r_checkdeferred: the view is identical with r_deferred on and off\n");
+}
+
+/** Does the check asked for by r_checkdeferred, if there is one:
+  * renders the view calling the drawers directly, then again through
+  * the deferred tiles, starting from the same screen both times, and
+  * reports any pixel that came out differently.
+  *
+  * \param player The player whose view is being rendered.
+  * \return True if the view was rendered.
+  */
+boolean R_CheckDeferredDraws(player_t *player)
+{
+	size_t size = vid.rowbytes * vid.height;
+	UINT8 *before, *direct;
+
+	if (!rt.checkrequested)
+		return false;
+	rt.checkrequested = false;
+
+	if (vid.bpp != 1)
+	{
+		CONS_Alert(CONS_WARNING, "r_checkdeferred: only 8-bit color is queued\n");
+		return false;
+	}
+
+	before = Z_Malloc(size, PU_STATIC, NULL);
+	direct = Z_Malloc(size, PU_STATIC, NULL);
+	M_Memcpy(before, screens[0], size);
+
+	rt.force = RT_FORCE_DIRECT;
+	R_RenderPlayerView(player);
+	M_Memcpy(direct, screens[0], size);
+
+	M_Memcpy(screens[0], before, size);
+	rt.force = RT_FORCE_DEFERRED;
+	R_RenderPlayerView(player);
+	rt.force = RT_FORCE_NONE;
+
+	R_CompareScreens(direct, screens[0]);
+
+	Z_Free(direct);
+	Z_Free(before);
+	return true;
+}
+
+// Try it looking at a flipped sprite and a sloped translucent plane,
+// the two things that have gone wrong in replay before.
+void Command_CheckDeferred_f(void)
+{
+	if (rendermode != render_soft)
+	{
+		CONS_Printf("r_checkdeferred only works in the software renderer\n");
+		return;
+	}
+
+	rt.checkrequested = true;
+}
+
+#endif // HAVE_RENDERTHREADS
@@ -0,0 +1,56 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 1999-2023 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  r_threads.h
+/// \brief Software renderer drawing on worker threads, or deferred and
+///        sorted by tile
+
+#ifndef __R_THREADS__
+#define __R_THREADS__
+
+#include "doomtype.h"
+
+// The column and span drawers read their parameters from globals, so
+// those have to be per-thread for the workers to run drawers at all.
+#if defined (HAVE_THREADS) && defined (THREADLOCAL)
+#define HAVE_RENDERTHREADS
+#define R_THREADLOCAL THREADLOCAL
+#else
+#define R_THREADLOCAL
+#endif
+
+#ifdef HAVE_RENDERTHREADS
+#include "command.h"
+
+#define MAXRENDERTHREADS 16
+
+extern consvar_t cv_renderthreads, cv_deferreddraws;
+
+// True between R_BeginThreadedDraws and R_EndThreadedDraws, while drawer
+// calls are being queued instead of run.
+extern boolean rt_recording;
+
+void R_RecordColumn(void (*func)(void));
+void R_RecordSpan(void (*func)(void));
+UINT8 *R_AllocQueuedSource(size_t len);
+
+void R_BeginThreadedDraws(void);
+void R_FlushThreadedDraws(void);
+void R_EndThreadedDraws(void);
+
+boolean R_CheckDeferredDraws(struct player_s *player);
+void Command_CheckDeferred_f(void);
+
+#define CALL_COLFUNC(func) (rt_recording ? R_RecordColumn(func) : (func)())
+#define CALL_SPANFUNC(func) (rt_recording ? R_RecordSpan(func) : (func)())
+#else
+#define CALL_COLFUNC(func) (func)()
+#define CALL_SPANFUNC(func) (func)()
+#endif
+
+#endif
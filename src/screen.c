@@ -105,6 +105,12 @@ boolean R_SSE = false;
 boolean R_3DNow = false;
 boolean R_MMXExt = false;
 boolean R_SSE2 = false;
+boolean R_AVX2 = false;
+#ifdef __aarch64__
+boolean R_NEON = true; // always there on 64-bit ARM
+#else
+boolean R_NEON = false;
+#endif
 
 void SCR_SetDrawFuncs(void)
 {
@@ -116,9 +122,6 @@ void SCR_SetDrawFuncs(void)
 		colfuncs[BASEDRAWFUNC] = R_DrawColumn_8;
 		spanfuncs[BASEDRAWFUNC] = R_DrawSpan_8;
 
-		colfunc = colfuncs[BASEDRAWFUNC];
-		spanfunc = spanfuncs[BASEDRAWFUNC];
-
 		colfuncs[COLDRAWFUNC_FUZZY] = R_DrawTranslucentColumn_8;
 		colfuncs[COLDRAWFUNC_TRANS] = R_DrawTranslatedColumn_8;
 		colfuncs[COLDRAWFUNC_SHADE] = R_DrawShadeColumn_8;
@@ -164,6 +167,30 @@ void SCR_SetDrawFuncs(void)
 		spanfuncs_npo2[SPANDRAWFUNC_WATER] = R_DrawWaterSpan_NPO2_8;
 		spanfuncs_npo2[SPANDRAWFUNC_TILTEDWATER] = R_DrawTiltedWaterSpan_NPO2_8;
 
+		// Same pixels as the above, just faster
+#if defined (HAVE_X86_DRAWERS)
+		if (R_AVX2)
+		{
+			colfuncs[BASEDRAWFUNC] = R_DrawColumn_8_AVX2;
+			colfuncs[COLDRAWFUNC_FUZZY] = R_DrawTranslucentColumn_8_AVX2;
+			spanfuncs[BASEDRAWFUNC] = R_DrawSpan_8_AVX2;
+			spanfuncs[SPANDRAWFUNC_TRANS] = R_DrawTranslucentSpan_8_AVX2;
+		}
+		else if (R_SSE2)
+		{
+			spanfuncs[BASEDRAWFUNC] = R_DrawSpan_8_SSE2;
+			spanfuncs[SPANDRAWFUNC_TRANS] = R_DrawTranslucentSpan_8_SSE2;
+		}
+#elif defined (HAVE_NEON_DRAWERS)
+		if (R_NEON)
+		{
+			spanfuncs[BASEDRAWFUNC] = R_DrawSpan_8_NEON;
+			spanfuncs[SPANDRAWFUNC_TRANS] = R_DrawTranslucentSpan_8_NEON;
+		}
+#endif
+
+		colfunc = colfuncs[BASEDRAWFUNC];
+		spanfunc = spanfuncs[BASEDRAWFUNC];
 	}
 /*	else if (vid.bpp > 1)
 	{
@@ -243,7 +270,9 @@ void SCR_Startup(void)
 			R_SSE = true;
 		if (RCpuInfo->SSE2)
 			R_SSE2 = true;
-		CONS_Printf("CPU Info: 486: %i, 586: %i, MMX: %i, 3DNow: %i, MMXExt: %i, SSE2: %i\n", R_486, R_586, R_MMX, R_3DNow, R_MMXExt, R_SSE2);
+		if (RCpuInfo->AVX2)
+			R_AVX2 = true;
+		CONS_Printf("CPU Info: 486: %i, 586: %i, MMX: %i, 3DNow: %i, MMXExt: %i, SSE2: %i, AVX2: %i\n", R_486, R_586, R_MMX, R_3DNow, R_MMXExt, R_SSE2, R_AVX2);
 	}
 
 	if (M_CheckParm("-486"))
@@ -264,6 +293,13 @@ void SCR_Startup(void)
 
 	if (M_CheckParm("-SSE2"))
 		R_SSE2 = true;
+	if (M_CheckParm("-noSSE2"))
+		R_SSE2 = false;
+
+	if (M_CheckParm("-noAVX2"))
+		R_AVX2 = false;
+	if (M_CheckParm("-noNEON"))
+		R_NEON = false;
 
 	M_SetupMemcpy();
 
@@ -276,6 +312,9 @@ void SCR_Startup(void)
 
 	vid.modenum = 0;
 
+	// The video mode was set before we knew what the CPU has
+	SCR_SetDrawFuncs();
+
 	V_Init();
 	V_Recalc();
 
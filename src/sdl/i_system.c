@@ -3129,6 +3129,12 @@ size_t I_GetFreeMem(size_t *total)
 #endif
 }
 
+// Number of logical CPUs, for sizing worker thread pools
+INT32 I_GetCPUCount(void)
+{
+	return SDL_GetCPUCount();
+}
+
 const CPUInfoFlags *I_CPUInfo(void)
 {
 #if defined (_WIN32)
@@ -3169,6 +3175,9 @@ const CPUInfoFlags *I_CPUInfo(void)
 	}
 	WIN_CPUInfo.MMXExt      = SDL_FALSE; //SDL_HasMMXExt(); No longer in SDL2
 	WIN_CPUInfo.AMD3DNowExt = SDL_FALSE; //SDL_Has3DNowExt(); No longer in SDL2
+#endif
+#if defined (HAVE_SDLCPUINFO) && SDL_VERSION_ATLEAST(2,0,4)
+	WIN_CPUInfo.AVX2        = SDL_HasAVX2(); // also checks the OS saves the registers
 #endif
 	GetSystemInfo(&SI);
 	WIN_CPUInfo.CPUs = SI.dwNumberOfProcessors;
@@ -3186,6 +3195,9 @@ const CPUInfoFlags *I_CPUInfo(void)
 	SDL_CPUInfo.SSE         = SDL_HasSSE();
 	SDL_CPUInfo.SSE2        = SDL_HasSSE2();
 	SDL_CPUInfo.AltiVec     = SDL_HasAltiVec();
+#if SDL_VERSION_ATLEAST(2,0,4)
+	SDL_CPUInfo.AVX2        = SDL_HasAVX2();
+#endif
 	return &SDL_CPUInfo;
 #else
 	return NULL; /// \todo CPUID asm
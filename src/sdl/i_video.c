@@ -116,6 +116,7 @@ boolean allow_fullscreen = false;
 static SDL_bool disable_fullscreen = SDL_FALSE;
 #define USE_FULLSCREEN (disable_fullscreen||!allow_fullscreen)?0:cv_fullscreen.value
 static SDL_bool disable_mouse = SDL_FALSE;
+static SDL_bool headless = SDL_FALSE; // draw into screens[] only, never present (-headless)
 #define USE_MOUSEINPUT (!disable_mouse && cv_usemouse.value && havefocus)
 #define MOUSE_MENU false //(!disable_mouse && cv_usemouse.value && menuactive && !USE_FULLSCREEN)
 #define MOUSEBUTTONS_MAX MOUSEBUTTONS
@@ -1251,7 +1252,7 @@ void I_FinishUpdate(void)
 	if (cv_showping.value && netgame && consoleplayer != serverplayer)
 		SCR_DisplayLocalPing();
 
-	if (rendermode == render_soft && screens[0])
+	if (rendermode == render_soft && screens[0] && !headless)
 	{
 		if (!bufSurface) //Double-Check
 		{
@@ -1803,6 +1804,12 @@ void I_StartupGraphics(void)
 
 	keyboard_started = true;
 
+	// No window or display: the software renderer still draws every
+	// frame into screens[], which is all -benchdemo needs.
+	headless = M_CheckParm("-headless") ? SDL_TRUE : SDL_FALSE;
+	if (headless)
+		SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+
 #if !defined(HAVE_TTF)
 	// Previously audio was init here for questionable reasons?
 	if (SDL_InitSubSystem(SDL_INIT_VIDEO) < 0)
@@ -1862,6 +1869,9 @@ void I_StartupGraphics(void)
 	if (chosenrendermode != render_none)
 		rendermode = chosenrendermode;
 
+	if (headless)
+		rendermode = chosenrendermode = render_soft;
+
 	usesdl2soft = M_CheckParm("-softblit");
 	borderlesswindow = M_CheckParm("-borderless");
 
@@ -68,6 +68,7 @@
 #include "p_setup.h" // P_ScanThings
 #endif
 #include "m_misc.h" // M_MapNumber
+#include "m_argv.h"
 #include "g_game.h" // G_SetGameModified
 
 #ifdef HWRENDER
@@ -79,6 +80,14 @@
 #include "console.h"
 #endif
 
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
+
+#ifdef HAVE_THREADS
+#include "i_threads.h"
+#endif
+
 #ifndef O_BINARY
 #define O_BINARY 0
 #endif
@@ -119,6 +128,10 @@ void W_Shutdown(void)
 	{
 		wadfile_t *wad = wadfiles[numwadfiles];
 
+#ifdef HAVE_MMAP
+		if (wad->mapping)
+			munmap(wad->mapping, wad->filesize);
+#endif
 		if (wad->handle)
 			fclose(wad->handle);
 		Z_Free(wad->filename);
@@ -133,6 +146,10 @@ void W_Shutdown(void)
 		}
 
 		Z_Free(wad->lumpinfo);
+		Z_Free(wad->namehash);
+		Z_Free(wad->longnamehash);
+		Z_Free(wad->namechain);
+		Z_Free(wad->longnamechain);
 		Z_Free(wad);
 	}
 
@@ -181,7 +198,7 @@ FILE *W_OpenWadFile(const char **filename, boolean useerrors)
 
 		// If findfile finds the file, the full path will be returned
 		// in filenamebuf == *filename.
-		if (findfile(filenamebuf, NULL, true))
+		if (findfile(filenamebuf, sizeof filenamebuf, NULL, true))
 		{
 			if ((handle = fopen(*filename, "rb")) == NULL)
 			{
@@ -311,20 +328,12 @@ static INT32 W_MakeFileMD5(const char *filename, void *resblock)
 	(void)filename;
 	memset(resblock, 0x00, 16);
 #else
-	FILE *fhandle;
-
-	if ((fhandle = fopen(filename, "rb")) != NULL)
+	tic_t t = I_GetTime();
+	CONS_Debug(DBG_SETUP, "Making MD5 for %s\n",filename);
+	if (getfilemd5(filename, resblock)) // reuses the addon index when it can
 	{
-		tic_t t = I_GetTime();
-		CONS_Debug(DBG_SETUP, "Making MD5 for %s\n",filename);
-		if (md5_stream(fhandle, resblock) == 1)
-		{
-			fclose(fhandle);
-			return 1;
-		}
 		CONS_Debug(DBG_SETUP, "MD5 calc for %s took %f seconds\n",
 			filename, (float)(I_GetTime() - t)/NEWTICRATE);
-		fclose(fhandle);
 		return 0;
 	}
 #endif
@@ -337,6 +346,86 @@ static void W_InvalidateLumpnumCache(void)
 	memset(lumpnumcache, 0, sizeof (lumpnumcache));
 }
 
+#define LUMPINDEX_EMPTY UINT16_MAX
+
+// Builds the name lookup tables of a wad file, so that
+// W_CheckNumForNamePwad and W_CheckNumForLongNamePwad don't
+// have to scan every lump. Each table is open-addressed and
+// holds the first lump with a given name. The rest of the lumps
+// with that name are linked in ascending order through the chain
+// arrays, which keeps the 'startlump' searches working.
+static void W_BuildLumpIndex(wadfile_t *wadfile)
+{
+	const UINT16 numlumps = wadfile->numlumps;
+	lumpinfo_t *lumpinfo = wadfile->lumpinfo;
+	UINT32 size = 2;
+	INT32 i;
+
+	while (size < (UINT32)numlumps * 2)
+		size <<= 1;
+
+	wadfile->hashmask = size - 1;
+	wadfile->namehash = Z_Malloc(size * sizeof (UINT16), PU_STATIC, NULL);
+	wadfile->longnamehash = Z_Malloc(size * sizeof (UINT16), PU_STATIC, NULL);
+	wadfile->namechain = Z_Malloc(max(numlumps, 1) * sizeof (UINT16), PU_STATIC, NULL);
+	wadfile->longnamechain = Z_Malloc(max(numlumps, 1) * sizeof (UINT16), PU_STATIC, NULL);
+	memset(wadfile->namehash, 0xFF, size * sizeof (UINT16));
+	memset(wadfile->longnamehash, 0xFF, size * sizeof (UINT16));
+
+	// Insert backwards, so that each lump is pushed in front of the
+	// later ones with the same name and the table keeps the first.
+	for (i = numlumps - 1; i >= 0; i--)
+	{
+		lumpinfo_t *lump_p = &lumpinfo[i];
+		UINT32 slot;
+
+		slot = lump_p->hash & wadfile->hashmask;
+		while (wadfile->namehash[slot] != LUMPINDEX_EMPTY
+			&& strncmp(lumpinfo[wadfile->namehash[slot]].name, lump_p->name, 8))
+			slot = (slot + 1) & wadfile->hashmask;
+		wadfile->namechain[i] = wadfile->namehash[slot];
+		wadfile->namehash[slot] = (UINT16)i;
+
+		slot = quickncasehash(lump_p->longname, SIZE_MAX) & wadfile->hashmask;
+		while (wadfile->longnamehash[slot] != LUMPINDEX_EMPTY
+			&& strcmp(lumpinfo[wadfile->longnamehash[slot]].longname, lump_p->longname))
+			slot = (slot + 1) & wadfile->hashmask;
+		wadfile->longnamechain[i] = wadfile->longnamehash[slot];
+		wadfile->longnamehash[slot] = (UINT16)i;
+	}
+}
+
+// Returns the first lump whose name matches exactly, or LUMPINDEX_EMPTY.
+static UINT16 W_FindLumpIndexName(const wadfile_t *wadfile, const char *name, UINT32 hash)
+{
+	UINT32 slot;
+	UINT16 i;
+
+	for (slot = hash & wadfile->hashmask; (i = wadfile->namehash[slot]) != LUMPINDEX_EMPTY; slot = (slot + 1) & wadfile->hashmask)
+	{
+		const lumpinfo_t *lump_p = wadfile->lumpinfo + i;
+		if (lump_p->hash == hash && !strncmp(lump_p->name, name, 8))
+			break;
+	}
+
+	return i;
+}
+
+// Same as above, for long names.
+static UINT16 W_FindLumpIndexLongName(const wadfile_t *wadfile, const char *name)
+{
+	UINT32 slot;
+	UINT16 i;
+
+	for (slot = quickncasehash(name, SIZE_MAX) & wadfile->hashmask; (i = wadfile->longnamehash[slot]) != LUMPINDEX_EMPTY; slot = (slot + 1) & wadfile->hashmask)
+	{
+		if (!strcmp(wadfile->lumpinfo[i].longname, name))
+			break;
+	}
+
+	return i;
+}
+
 /** Detect a file type.
  * \todo Actually detect the wad/pkzip headers and whatnot, instead of just checking the extensions.
  */
@@ -837,6 +926,28 @@ static void W_ReadFileShaders(wadfile_t *wadfile)
 //
 // Can now load dehacked files (.soc)
 //
+/** Maps a WAD or PK3 into memory, so lumps can be read without going
+  * through stdio. Leaves the mapping NULL if that can't be done, in which
+  * case everything falls back to reading from the file handle.
+  */
+static void W_MapFile(wadfile_t *wadfile)
+{
+	wadfile->mapping = NULL;
+#ifdef HAVE_MMAP
+	if (wadfile->type != RET_WAD && wadfile->type != RET_PK3)
+		return;
+	if (!wadfile->filesize || M_CheckParm("-nommap"))
+		return;
+
+	wadfile->mapping = mmap(NULL, wadfile->filesize, PROT_READ, MAP_PRIVATE, fileno(wadfile->handle), 0);
+	if (wadfile->mapping == MAP_FAILED)
+	{
+		CONS_Debug(DBG_SETUP, "W_MapFile: could not map %s, reading it instead\n", wadfile->filename);
+		wadfile->mapping = NULL;
+	}
+#endif
+}
+
 UINT16 W_InitFile(const char *filename, boolean mainfile, boolean startup)
 {
 	FILE *handle;
@@ -955,6 +1066,7 @@ UINT16 W_InitFile(const char *filename, boolean mainfile, boolean startup)
 	fseek(handle, 0, SEEK_END);
 	wadfile->filesize = (unsigned)ftell(handle);
 	wadfile->type = type;
+	W_MapFile(wadfile);
 
 	// already generated, just copy it over
 	M_Memcpy(&wadfile->md5sum, &md5sum, 16);
@@ -965,6 +1077,8 @@ UINT16 W_InitFile(const char *filename, boolean mainfile, boolean startup)
 	Z_Calloc(numlumps * sizeof (*wadfile->lumpcache), PU_STATIC, &wadfile->lumpcache);
 	Z_Calloc(numlumps * sizeof (*wadfile->patchcache), PU_STATIC, &wadfile->patchcache);
 
+	W_BuildLumpIndex(wadfile);
+
 	//
 	// add the wadfile
 	//
@@ -1134,6 +1248,7 @@ UINT16 W_InitFolder(const char *path, boolean mainfile, boolean startup)
 	wadfile->path = fullpath;
 	wadfile->type = RET_FOLDER;
 	wadfile->handle = NULL;
+	wadfile->mapping = NULL;
 	wadfile->numlumps = numlumps;
 	wadfile->foldercount = foldercount;
 	wadfile->lumpinfo = lumpinfo;
@@ -1146,6 +1261,8 @@ UINT16 W_InitFolder(const char *path, boolean mainfile, boolean startup)
 	Z_Calloc(numlumps * sizeof (*wadfile->lumpcache), PU_STATIC, &wadfile->lumpcache);
 	Z_Calloc(numlumps * sizeof (*wadfile->patchcache), PU_STATIC, &wadfile->patchcache);
 
+	W_BuildLumpIndex(wadfile);
+
 	CONS_Printf(M_GetText("Added folder %s (%u files, %u folders)\n"), fn, numlumps, foldercount);
 	wadfiles = Z_Realloc(wadfiles, sizeof(wadfile_t *) * (numwadfiles + 1), PU_STATIC, NULL);
 	wadfiles[numwadfiles] = wadfile;
@@ -1184,6 +1301,10 @@ void W_InitMultipleFiles(addfilelist_t *list)
 		else
 			W_InitFile(fn, mainfile, true);
 	}
+
+#ifndef NOMD5
+	saveaddonindex(); // keep the checksums of everything just loaded
+#endif
 }
 
 /** Make sure a lump number is valid.
@@ -1225,29 +1346,27 @@ const char *W_CheckNameForNum(lumpnum_t lumpnum)
 //
 UINT16 W_CheckNumForNamePwad(const char *name, UINT16 wad, UINT16 startlump)
 {
-	UINT16 i;
 	static char uname[8 + 1];
-	UINT32 hash;
+	wadfile_t *wadfile;
+	UINT16 i;
 
 	if (!TestValidLump(wad,0))
 		return INT16_MAX;
 
+	wadfile = wadfiles[wad];
+	if (startlump >= wadfile->numlumps)
+		return INT16_MAX;
+
 	strlcpy(uname, name, sizeof uname);
 	strupr(uname);
-	hash = quickncasehash(uname, 8);
 
 	//
-	// scan forward
 	// start at 'startlump', useful parameter when there are multiple
 	//                       resources with the same name
 	//
-	if (startlump < wadfiles[wad]->numlumps)
-	{
-		lumpinfo_t *lump_p = wadfiles[wad]->lumpinfo + startlump;
-		for (i = startlump; i < wadfiles[wad]->numlumps; i++, lump_p++)
-			if (lump_p->hash == hash && !strncmp(lump_p->name, uname, sizeof(uname) - 1))
-				return i;
-	}
+	for (i = W_FindLumpIndexName(wadfile, uname, quickncasehash(uname, 8)); i != LUMPINDEX_EMPTY; i = wadfile->namechain[i])
+		if (i >= startlump)
+			return i;
 
 	// not found.
 	return INT16_MAX;
@@ -1261,27 +1380,27 @@ UINT16 W_CheckNumForNamePwad(const char *name, UINT16 wad, UINT16 startlump)
 //
 UINT16 W_CheckNumForLongNamePwad(const char *name, UINT16 wad, UINT16 startlump)
 {
-	UINT16 i;
 	static char uname[256 + 1];
+	wadfile_t *wadfile;
+	UINT16 i;
 
 	if (!TestValidLump(wad,0))
 		return INT16_MAX;
 
+	wadfile = wadfiles[wad];
+	if (startlump >= wadfile->numlumps)
+		return INT16_MAX;
+
 	strlcpy(uname, name, sizeof uname);
 	strupr(uname);
 
 	//
-	// scan forward
 	// start at 'startlump', useful parameter when there are multiple
 	//                       resources with the same name
 	//
-	if (startlump < wadfiles[wad]->numlumps)
-	{
-		lumpinfo_t *lump_p = wadfiles[wad]->lumpinfo + startlump;
-		for (i = startlump; i < wadfiles[wad]->numlumps; i++, lump_p++)
-			if (!strcmp(lump_p->longname, uname))
-				return i;
-	}
+	for (i = W_FindLumpIndexLongName(wadfile, uname); i != LUMPINDEX_EMPTY; i = wadfile->longnamechain[i])
+		if (i >= startlump)
+			return i;
 
 	// not found.
 	return INT16_MAX;
@@ -1456,12 +1575,9 @@ lumpnum_t W_CheckNumForMap(const char *name)
 	{
 		if (wadfiles[i]->type == RET_WAD)
 		{
-			for (lumpNum = 0; lumpNum < wadfiles[i]->numlumps; lumpNum++)
-			{
-				p = wadfiles[i]->lumpinfo + lumpNum;
-				if (p->hash == hash && !strncmp(name, p->name, 8))
-					return (i<<16) + lumpNum;
-			}
+			lumpNum = W_FindLumpIndexName(wadfiles[i], name, hash);
+			if (lumpNum != LUMPINDEX_EMPTY)
+				return (i<<16) + lumpNum;
 		}
 		else if (W_FileHasFolders(wadfiles[i]))
 		{
@@ -1555,13 +1671,11 @@ lumpnum_t W_CheckNumForNameInBlock(const char *name, const char *blockstart, con
 #include "fastcmp.h"
 UINT8 W_LumpExists(const char *name)
 {
-	INT32 i,j;
+	INT32 i;
 	for (i = numwadfiles - 1; i >= 0; i--)
 	{
-		lumpinfo_t *lump_p = wadfiles[i]->lumpinfo;
-		for (j = 0; j < wadfiles[i]->numlumps; ++j, ++lump_p)
-			if (fastcmp(lump_p->longname, name))
-				return true;
+		if (W_FindLumpIndexLongName(wadfiles[i], name) != LUMPINDEX_EMPTY)
+			return true;
 	}
 	return false;
 }
@@ -1681,8 +1795,288 @@ void zerr(int ret)
 }
 #endif
 
+// Returns where a lump's data on disk starts in its file's mapping,
+// or NULL if the file isn't mapped or the lump runs past its end.
+static UINT8 *W_MappedLumpData(wadfile_t *wadfile, lumpinfo_t *l)
+{
+	if (!wadfile->mapping)
+		return NULL;
+	if (l->position > wadfile->filesize || l->disksize > wadfile->filesize - l->position)
+		return NULL;
+	return wadfile->mapping + l->position;
+}
+
+// ==========================================================================
+//                                                            LUMP PREFETCH
+// ==========================================================================
+// Adding a big PK3 spends most of its time inflating sprites one after
+// another. While a prefetch is running, lumps queued with W_PrefetchLump
+// are inflated by worker threads, straight from the file's mapping, and
+// W_ReadLumpHeaderPwad picks the result up instead of inflating it again.
+//
+// The workers only ever touch the mapping, zlib and malloc: zone memory
+// and the console aren't safe to use off the main thread.
+
+#if defined (HAVE_THREADS) && defined (HAVE_ZLIB) && defined (HAVE_MMAP)
+#define PREFETCH_MAXWORKERS 8
+#define PREFETCH_BUDGET (64<<20) // inflated bytes waiting to be picked up
+
+typedef enum
+{
+	PREFETCH_NONE,
+	PREFETCH_QUEUED,
+	PREFETCH_BUSY,
+	PREFETCH_READY
+} prefetchstate_t;
+
+static struct
+{
+	wadfile_t *wadfile;
+	UINT16 wad;
+
+	UINT8 *state; // prefetchstate_t for every lump in the file
+	UINT8 **data; // malloc'd inflated lump, while PREFETCH_READY
+	UINT16 *queue; // ring buffer of lump numbers
+	size_t queuehead, queuetail;
+
+	size_t readybytes;
+	INT32 workers;
+	boolean stopping;
+
+	I_mutex mutex;
+	I_cond cond;
+} prefetch;
+
+static UINT8 *W_InflateMappedLump(UINT8 *raw, size_t rawsize, size_t size)
+{
+	UINT8 *data = malloc(size);
+	z_stream strm;
+	int zErr;
+
+	if (!data)
+		return NULL;
+
+	strm.zalloc = Z_NULL;
+	strm.zfree = Z_NULL;
+	strm.opaque = Z_NULL;
+	strm.next_in = raw;
+	strm.avail_in = (uInt)rawsize;
+	strm.next_out = data;
+	strm.avail_out = (uInt)size;
+
+	zErr = inflateInit2(&strm, -15);
+	if (zErr == Z_OK)
+	{
+		zErr = inflate(&strm, Z_FINISH);
+		(void)inflateEnd(&strm);
+	}
+
+	if (zErr != Z_STREAM_END)
+	{
+		free(data);
+		return NULL;
+	}
+	return data;
+}
+
+static void W_PrefetchWorker(void *userdata)
+{
+	(void)userdata;
+
+	I_lock_mutex(&prefetch.mutex);
+	for (;;)
+	{
+		lumpinfo_t *l;
+		UINT16 lump;
+		UINT8 *data;
+
+		while (!prefetch.stopping && (prefetch.queuehead == prefetch.queuetail || prefetch.readybytes >= PREFETCH_BUDGET))
+			I_hold_cond(&prefetch.cond, prefetch.mutex);
+
+		if (prefetch.stopping)
+			break;
+
+		lump = prefetch.queue[prefetch.queuehead];
+		prefetch.queuehead = (prefetch.queuehead + 1) % prefetch.wadfile->numlumps;
+
+		// The main thread may have needed it before we got to it.
+		if (prefetch.state[lump] != PREFETCH_QUEUED)
+			continue;
+
+		prefetch.state[lump] = PREFETCH_BUSY;
+		I_unlock_mutex(prefetch.mutex);
+
+		l = prefetch.wadfile->lumpinfo + lump;
+		data = W_InflateMappedLump(prefetch.wadfile->mapping + l->position, l->disksize, l->size);
+
+		I_lock_mutex(&prefetch.mutex);
+		if (data)
+		{
+			prefetch.data[lump] = data;
+			prefetch.state[lump] = PREFETCH_READY;
+			prefetch.readybytes += l->size;
+		}
+		else // let the main thread run into the error itself
+			prefetch.state[lump] = PREFETCH_NONE;
+		I_wake_all_cond(&prefetch.cond);
+	}
+	prefetch.workers--;
+	I_wake_all_cond(&prefetch.cond);
+	I_unlock_mutex(prefetch.mutex);
+}
+
+/** Starts worker threads to inflate lumps of a file in the background.
+  * Only one file can be prefetched from at a time; this ends any previous
+  * prefetch. Does nothing if the file isn't mapped or there's only one CPU.
+  *
+  * \param wad The file lumps will be queued from.
+  * \sa W_PrefetchLump, W_EndPrefetch
+  */
+void W_StartPrefetch(UINT16 wad)
+{
+	wadfile_t *wadfile;
+	INT32 i, numworkers;
+
+	W_EndPrefetch();
+
+	if (wad >= numwadfiles)
+		return;
+
+	wadfile = wadfiles[wad];
+	if (wadfile->type != RET_PK3 || !wadfile->mapping || !wadfile->numlumps)
+		return;
+
+	numworkers = min(I_GetCPUCount() - 1, PREFETCH_MAXWORKERS);
+	if (numworkers < 1 || M_CheckParm("-noprefetch"))
+		return;
+
+	prefetch.wadfile = wadfile;
+	prefetch.wad = wad;
+	prefetch.state = calloc(wadfile->numlumps, sizeof (*prefetch.state));
+	prefetch.data = calloc(wadfile->numlumps, sizeof (*prefetch.data));
+	prefetch.queue = malloc(wadfile->numlumps * sizeof (*prefetch.queue));
+	if (!prefetch.state || !prefetch.data || !prefetch.queue)
+		I_Error("W_StartPrefetch: out of memory");
+	prefetch.queuehead = prefetch.queuetail = 0;
+	prefetch.readybytes = 0;
+	prefetch.stopping = false;
+	prefetch.workers = numworkers;
+
+	// Workers waiting on the condition would hang I_stop_threads.
+	I_AddExitFunc(W_EndPrefetch);
+
+	for (i = 0; i < numworkers; i++)
+		I_spawn_thread("lump-prefetch", W_PrefetchWorker, NULL);
+}
+
+/** Queues a lump to be inflated in the background, if a prefetch is
+  * running for its file. Lumps should be queued in the order they will
+  * be read in.
+  *
+  * \param wad The file the lump is in.
+  * \param lump The lump to inflate.
+  */
+void W_PrefetchLump(UINT16 wad, UINT16 lump)
+{
+	size_t next;
+	lumpinfo_t *l;
+
+	if (!prefetch.wadfile || wad != prefetch.wad || lump >= prefetch.wadfile->numlumps)
+		return;
+
+	l = prefetch.wadfile->lumpinfo + lump;
+	if (l->compression != CM_DEFLATE || !W_MappedLumpData(prefetch.wadfile, l))
+		return;
+
+	I_lock_mutex(&prefetch.mutex);
+	next = (prefetch.queuetail + 1) % prefetch.wadfile->numlumps;
+	if (prefetch.state[lump] == PREFETCH_NONE && next != prefetch.queuehead)
+	{
+		prefetch.state[lump] = PREFETCH_QUEUED;
+		prefetch.queue[prefetch.queuetail] = lump;
+		prefetch.queuetail = next;
+		I_wake_one_cond(&prefetch.cond);
+	}
+	I_unlock_mutex(prefetch.mutex);
+}
+
+/** Stops the workers and throws away whatever they inflated that was
+  * never read.
+  */
+void W_EndPrefetch(void)
+{
+	UINT16 i;
+
+	if (!prefetch.wadfile)
+		return;
+
+	I_RemoveExitFunc(W_EndPrefetch);
+
+	I_lock_mutex(&prefetch.mutex);
+	prefetch.stopping = true;
+	I_wake_all_cond(&prefetch.cond);
+	while (prefetch.workers > 0)
+		I_hold_cond(&prefetch.cond, prefetch.mutex);
+	I_unlock_mutex(prefetch.mutex);
+
+	for (i = 0; i < prefetch.wadfile->numlumps; i++)
+		free(prefetch.data[i]);
+
+	free(prefetch.state);
+	free(prefetch.data);
+	free(prefetch.queue);
+	prefetch.state = NULL;
+	prefetch.data = NULL;
+	prefetch.queue = NULL;
+	prefetch.wadfile = NULL;
+}
+
+// Hands over a lump the workers inflated, waiting for it if it's in
+// progress. Returns NULL if nobody has started on it yet, in which case
+// the caller inflates it itself.
+static UINT8 *W_TakePrefetchedLump(UINT16 wad, UINT16 lump)
+{
+	UINT8 *data = NULL;
+
+	if (!prefetch.wadfile || wad != prefetch.wad)
+		return NULL;
+
+	I_lock_mutex(&prefetch.mutex);
+	while (prefetch.state[lump] == PREFETCH_BUSY)
+		I_hold_cond(&prefetch.cond, prefetch.mutex);
+
+	if (prefetch.state[lump] == PREFETCH_READY)
+	{
+		data = prefetch.data[lump];
+		prefetch.data[lump] = NULL;
+		prefetch.readybytes -= prefetch.wadfile->lumpinfo[lump].size;
+		I_wake_all_cond(&prefetch.cond);
+	}
+	prefetch.state[lump] = PREFETCH_NONE;
+	I_unlock_mutex(prefetch.mutex);
+
+	return data;
+}
+#else
+void W_StartPrefetch(UINT16 wad)
+{
+	(void)wad;
+}
+
+void W_PrefetchLump(UINT16 wad, UINT16 lump)
+{
+	(void)wad;
+	(void)lump;
+}
+
+void W_EndPrefetch(void)
+{
+}
+#endif
+
 /** Reads bytes from the head of a lump.
-  * Note: If the lump is compressed, the whole thing has to be read anyway.
+  * Note: If the lump is compressed, everything up to the bytes wanted
+  * has to be decompressed anyway.
   *
   * \param wad Wad number to read from.
   * \param lump Lump number to read from.
@@ -1697,6 +2091,7 @@ size_t W_ReadLumpHeaderPwad(UINT16 wad, UINT16 lump, void *dest, size_t size, si
 	size_t lumpsize, bytesread;
 	lumpinfo_t *l;
 	FILE *handle = NULL;
+	UINT8 *mapped;
 
 	if (!TestValidLump(wad, lump))
 		return 0;
@@ -1749,16 +2144,27 @@ size_t W_ReadLumpHeaderPwad(UINT16 wad, UINT16 lump, void *dest, size_t size, si
 		size = lumpsize - offset;
 
 	// Let's get the raw lump data.
-	// We setup the desired file handle to read the lump data.
-	if (wadfiles[wad]->type != RET_FOLDER)
-		handle = wadfiles[wad]->handle;
-	fseek(handle, (long)(l->position + offset), SEEK_SET);
+	// If the file is mapped, it's already in memory; otherwise we setup
+	// the desired file handle to read the lump data.
+	mapped = W_MappedLumpData(wadfiles[wad], l);
+	if (!mapped)
+	{
+		if (wadfiles[wad]->type != RET_FOLDER)
+			handle = wadfiles[wad]->handle;
+		fseek(handle, (long)(l->position + offset), SEEK_SET);
+	}
 
 	// But let's not copy it yet. We support different compression formats on lumps, so we need to take that into account.
 	switch(wadfiles[wad]->lumpinfo[lump].compression)
 	{
 	case CM_NOCOMPRESSION:		// If it's uncompressed, we directly write the data into our destination, and return the bytes read.
-		bytesread = fread(dest, 1, size, handle);
+		if (mapped)
+		{
+			M_Memcpy(dest, mapped + offset, size);
+			bytesread = size;
+		}
+		else
+			bytesread = fread(dest, 1, size, handle);
 		if (wadfiles[wad]->type == RET_FOLDER)
 			fclose(handle);
 #ifdef NO_PNG_LUMPS
@@ -1773,11 +2179,16 @@ size_t W_ReadLumpHeaderPwad(UINT16 wad, UINT16 lump, void *dest, size_t size, si
 			char *decData; // Lump's decompressed real data.
 			size_t retval; // Helper var, lzf_decompress returns 0 when an error occurs.
 
-			rawData = Z_Malloc(l->disksize, PU_STATIC, NULL);
 			decData = Z_Malloc(l->size, PU_STATIC, NULL);
 
-			if (fread(rawData, 1, l->disksize, handle) < l->disksize)
-				I_Error("wad %d, lump %d: cannot read compressed data", wad, lump);
+			if (mapped)
+				rawData = (char *)mapped;
+			else
+			{
+				rawData = Z_Malloc(l->disksize, PU_STATIC, NULL);
+				if (fread(rawData, 1, l->disksize, handle) < l->disksize)
+					I_Error("wad %d, lump %d: cannot read compressed data", wad, lump);
+			}
 			retval = lzf_decompress(rawData, l->disksize, decData, l->size);
 #ifndef AVOID_ERRNO
 			if (retval == 0) // If this was returned, check if errno was set
@@ -1798,7 +2209,8 @@ size_t W_ReadLumpHeaderPwad(UINT16 wad, UINT16 lump, void *dest, size_t size, si
 			if (!decData) // Did we get no data at all?
 				return 0;
 			M_Memcpy(dest, decData + offset, size);
-			Z_Free(rawData);
+			if (!mapped)
+				Z_Free(rawData);
 			Z_Free(decData);
 #ifdef NO_PNG_LUMPS
 			if (Picture_IsLumpPNG((UINT8 *)dest, size))
@@ -1820,13 +2232,32 @@ size_t W_ReadLumpHeaderPwad(UINT16 wad, UINT16 lump, void *dest, size_t size, si
 			int zErr; // Helper var.
 			z_stream strm;
 			unsigned long rawSize = l->disksize;
-			unsigned long decSize = l->size;
+			unsigned long decSize = offset + size; // Header reads can stop early.
+
+#if defined (HAVE_THREADS) && defined (HAVE_MMAP)
+			decData = W_TakePrefetchedLump(wad, lump);
+			if (decData)
+			{
+				M_Memcpy(dest, decData + offset, size);
+				free(decData);
+#ifdef NO_PNG_LUMPS
+				if (Picture_IsLumpPNG((UINT8 *)dest, size))
+					Picture_ThrowPNGError(l->fullname, wadfiles[wad]->filename);
+#endif
+				return size;
+			}
+#endif
 
-			rawData = Z_Malloc(rawSize, PU_STATIC, NULL);
 			decData = Z_Malloc(decSize, PU_STATIC, NULL);
 
-			if (fread(rawData, 1, rawSize, handle) < rawSize)
-				I_Error("wad %d, lump %d: cannot read compressed data", wad, lump);
+			if (mapped)
+				rawData = mapped; // inflate straight from the mapping
+			else
+			{
+				rawData = Z_Malloc(rawSize, PU_STATIC, NULL);
+				if (fread(rawData, 1, rawSize, handle) < rawSize)
+					I_Error("wad %d, lump %d: cannot read compressed data", wad, lump);
+			}
 
 			strm.zalloc = Z_NULL;
 			strm.zfree = Z_NULL;
@@ -1841,15 +2272,15 @@ size_t W_ReadLumpHeaderPwad(UINT16 wad, UINT16 lump, void *dest, size_t size, si
 			zErr = inflateInit2(&strm, -15);
 			if (zErr == Z_OK)
 			{
-				zErr = inflate(&strm, Z_FINISH);
-				if (zErr == Z_STREAM_END)
+				zErr = inflate(&strm, (decSize < l->size) ? Z_SYNC_FLUSH : Z_FINISH);
+				if (zErr == Z_STREAM_END || (zErr == Z_OK && !strm.avail_out))
 				{
-					M_Memcpy(dest, decData, size);
+					M_Memcpy(dest, decData + offset, size);
 				}
 				else
 				{
 					size = 0;
-					zerr(zErr);
+					zerr((zErr == Z_OK) ? Z_DATA_ERROR : zErr);
 				}
 
 				(void)inflateEnd(&strm);
@@ -1860,7 +2291,8 @@ size_t W_ReadLumpHeaderPwad(UINT16 wad, UINT16 lump, void *dest, size_t size, si
 				zerr(zErr);
 			}
 
-			Z_Free(rawData);
+			if (!mapped)
+				Z_Free(rawData);
 			Z_Free(decData);
 
 #ifdef NO_PNG_LUMPS
@@ -1898,6 +2330,36 @@ void W_ReadLumpPwad(UINT16 wad, UINT16 lump, void *dest)
 	W_ReadLumpHeaderPwad(wad, lump, dest, 0, 0);
 }
 
+// Big uncompressed lumps are cached by mapping them straight out of the
+// file, so they don't need to be read or copied until they're used.
+#define MAPLUMP_MINSIZE (64<<10)
+
+static void *W_MapLumpPwad(UINT16 wad, UINT16 lump, INT32 tag)
+{
+#ifdef HAVE_MMAP
+	wadfile_t *wadfile = wadfiles[wad];
+	lumpinfo_t *l = wadfile->lumpinfo + lump;
+	void *ptr;
+
+	if (l->compression != CM_NOCOMPRESSION || l->size < MAPLUMP_MINSIZE)
+		return NULL;
+	if (!W_MappedLumpData(wadfile, l))
+		return NULL;
+
+	ptr = Z_MapFile(fileno(wadfile->handle), l->position, l->size, tag, &wadfile->lumpcache[lump]);
+#ifdef NO_PNG_LUMPS
+	if (ptr && Picture_IsLumpPNG((UINT8 *)ptr, l->size))
+		Picture_ThrowPNGError(l->fullname, wadfile->filename);
+#endif
+	return ptr;
+#else
+	(void)wad;
+	(void)lump;
+	(void)tag;
+	return NULL;
+#endif
+}
+
 // ==========================================================================
 // W_CacheLumpNum
 // ==========================================================================
@@ -1909,7 +2371,7 @@ void *W_CacheLumpNumPwad(UINT16 wad, UINT16 lump, INT32 tag)
 		return NULL;
 
 	lumpcache = wadfiles[wad]->lumpcache;
-	if (!lumpcache[lump])
+	if (!lumpcache[lump] && !W_MapLumpPwad(wad, lump, tag))
 	{
 		void *ptr = Z_Malloc(W_LumpLengthPwad(wad, lump), tag, &lumpcache[lump]);
 		W_ReadLumpHeaderPwad(wad, lump, ptr, 0, 0);  // read the lump in full
@@ -128,9 +128,13 @@ typedef struct wadfile_s
 	lumpinfo_t *lumpinfo;
 	lumpcache_t *lumpcache;
 	lumpcache_t *patchcache;
+	UINT16 *namehash, *longnamehash; // open-addressing lookup of the first lump with each name
+	UINT16 *namechain, *longnamechain; // next lump with the same name, in lump order
+	UINT32 hashmask;
 	UINT16 numlumps; // this wad's number of resources
 	UINT16 foldercount; // folder count
 	FILE *handle;
+	UINT8 *mapping; // whole file mapped read-only, or NULL to read through handle
 	UINT32 filesize; // for network
 	UINT8 md5sum[16];
 
@@ -199,6 +203,11 @@ boolean W_IsLumpFolder(UINT16 wad, UINT16 lump); // for detecting folder "lumps"
 void zerr(int ret); // zlib error checking
 #endif
 
+// Background decompression of lumps that are about to be read in full
+void W_StartPrefetch(UINT16 wad);
+void W_PrefetchLump(UINT16 wad, UINT16 lump);
+void W_EndPrefetch(void);
+
 size_t W_ReadLumpHeaderPwad(UINT16 wad, UINT16 lump, void *dest, size_t size, size_t offset);
 size_t W_ReadLumpHeader(lumpnum_t lump, void *dest, size_t size, size_t offest); // read all or a part of a lump
 void W_ReadLumpPwad(UINT16 wad, UINT16 lump, void *dest);
@@ -39,6 +39,11 @@
 #include "hardware/hw_main.h" // For hardware memory info
 #endif
 
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 #ifdef HAVE_VALGRIND
 #include "valgrind.h"
 static boolean Z_calloc = false;
@@ -46,6 +51,11 @@ static boolean Z_calloc = false;
 #endif
 
 #define ZONEID 0xa441d13d
+#define ZONEMAPID 0xa441d13e // data is a file mapping, see Z_MapFile
+#define ZONESLABID 0xa441d13f // block lives in a slab slot, see Z_SlabAlloc
+#define ZONEARENAID 0xa441d140 // block lives in the level arena, see Z_ArenaAlloc
+
+#define Z_VALIDID(block) ((block)->id == ZONEID || (block)->id == ZONEMAPID || (block)->id == ZONESLABID || (block)->id == ZONEARENAID)
 
 #ifdef ZDEBUG
 //#define ZDEBUG2
@@ -71,6 +81,21 @@ typedef struct memblock_s
 #define MEMORY(x) (void *)((uintptr_t)(x) + sizeof(memblock_t))
 #define MEMBLOCK(x) (memblock_t *)((uintptr_t)(x) - sizeof(memblock_t))
 
+// Blocks carved out of slabs and the level arena are aligned like malloc's
+// would be, since callers may keep long doubles or SSE vectors in them.
+#if defined (__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define ZONEALIGN (_Alignof(max_align_t) > 16 ? _Alignof(max_align_t) : 16)
+#else
+#define ZONEALIGN 16
+#endif
+#define ZONEALIGNUP(x) (((x) + ZONEALIGN - 1) & ~(size_t)(ZONEALIGN - 1))
+
+// Slab and arena slots start with padding, then a pointer back to where
+// the slot came from, then the block header, ending where the aligned
+// data starts.
+#define SLOTHEADER ZONEALIGNUP(sizeof (void *) + sizeof (memblock_t))
+#define SLOTBLOCK(slot) (memblock_t *)((UINT8 *)(slot) + SLOTHEADER - sizeof (memblock_t))
+
 // both the head and tail of the zone memory block list
 static memblock_t head;
 
@@ -78,6 +103,9 @@ static memblock_t head;
 // Function prototypes
 //
 static void Command_Memfree_f(void);
+static void Z_SlabFree(memblock_t *block);
+static void Z_ArenaFree(memblock_t *block);
+static void Z_ReleaseEmptySlabs(void);
 #ifdef ZDEBUG
 static void Command_Memdump_f(void);
 #endif
@@ -138,7 +166,7 @@ void Z_Free(void *ptr)
 
 	block = MEMBLOCK(ptr);
 #ifdef PARANOIA
-	if (block->id != ZONEID)
+	if (!Z_VALIDID(block))
 #ifdef ZDEBUG
 		I_Error("Z_Free at %s:%d: wrong id", file, line);
 #else
@@ -167,6 +195,26 @@ void Z_Free(void *ptr)
 #endif
 	block->prev->next = block->next;
 	block->next->prev = block->prev;
+	if (block->id == ZONESLABID)
+	{
+		Z_SlabFree(block);
+		return;
+	}
+	if (block->id == ZONEARENAID)
+	{
+		Z_ArenaFree(block);
+		return;
+	}
+#ifdef HAVE_MMAP
+	if (block->id == ZONEMAPID)
+	{
+		// The mapping starts on the page the header lives in.
+		const uintptr_t pagemask = (uintptr_t)sysconf(_SC_PAGESIZE) - 1;
+		const uintptr_t base = (uintptr_t)block & ~pagemask;
+		munmap((void *)base, (uintptr_t)ptr + block->realsize - base);
+		return;
+	}
+#endif
 	free(block);
 }
 
@@ -199,6 +247,254 @@ static void *xm(size_t size)
 	return p;
 }
 
+// ----------------
+// Small-block slabs
+// ----------------
+// Small blocks (mobjs, precipitation, thinkers, secnodes, Lua userdata)
+// are handed out from fixed-size slots carved out of bigger chunks, so
+// spawning and removing them doesn't go to malloc every time. Each slot
+// holds a pointer back to its slab, followed by the usual block header, so
+// the rest of the zone code can't tell the difference.
+
+#define SLABSIZE (64<<10)
+
+typedef struct zslab_s
+{
+	struct zslab_s *prev, *next; // in the list of slabs with free slots
+	void **freeslot; // free slots are chained through their second word
+	UINT32 used, capacity;
+	UINT8 sizeclass;
+} zslab_t;
+
+// Largest data size for each class
+static const size_t slabclasses[] = {32, 64, 96, 128, 192, 256, 384, 512, 768, 1024};
+#define NUMSLABCLASSES (sizeof (slabclasses) / sizeof (*slabclasses))
+#define SLOTSIZE(sc) (SLOTHEADER + ZONEALIGNUP(slabclasses[sc]))
+
+static zslab_t *freeslabs[NUMSLABCLASSES]; // slabs with at least one free slot
+static size_t slabtotal, slabused; // bytes, for memfree
+
+static INT32 Z_SlabClass(size_t size)
+{
+	INT32 sc;
+	for (sc = 0; sc < (INT32)NUMSLABCLASSES; sc++)
+		if (size <= slabclasses[sc])
+			return sc;
+	return -1;
+}
+
+static void Z_LinkSlab(zslab_t *slab)
+{
+	slab->prev = NULL;
+	slab->next = freeslabs[slab->sizeclass];
+	if (slab->next)
+		slab->next->prev = slab;
+	freeslabs[slab->sizeclass] = slab;
+}
+
+static void Z_UnlinkSlab(zslab_t *slab)
+{
+	if (slab->prev)
+		slab->prev->next = slab->next;
+	else
+		freeslabs[slab->sizeclass] = slab->next;
+	if (slab->next)
+		slab->next->prev = slab->prev;
+	slab->prev = slab->next = NULL;
+}
+
+/** Takes a slot from a slab of the given size class, making a new slab if
+  * they're all full.
+  *
+  * \param sc Size class, from Z_SlabClass.
+  * \return The block header in the slot.
+  */
+static memblock_t *Z_SlabAlloc(INT32 sc)
+{
+	zslab_t *slab = freeslabs[sc];
+	void **slot;
+
+	if (!slab)
+	{
+		const size_t slotsize = SLOTSIZE(sc);
+		UINT8 *slots;
+		UINT32 i;
+
+		slab = xm(SLABSIZE);
+		slab->sizeclass = (UINT8)sc;
+		slab->used = 0;
+		slab->freeslot = NULL;
+
+		// Don't count on malloc's alignment being as strict as ours
+		slots = (UINT8 *)ZONEALIGNUP((uintptr_t)slab + sizeof (zslab_t));
+		slab->capacity = (UINT32)((SLABSIZE - (slots - (UINT8 *)slab)) / slotsize);
+
+		for (i = slab->capacity; i--;)
+		{
+			slot = (void **)SLOTBLOCK(slots + i * slotsize) - 1;
+			slot[0] = slab;
+			slot[1] = slab->freeslot;
+			slab->freeslot = slot;
+		}
+
+		Z_LinkSlab(slab);
+		slabtotal += SLABSIZE;
+	}
+
+	slot = slab->freeslot;
+	slab->freeslot = slot[1];
+	if (++slab->used == slab->capacity)
+		Z_UnlinkSlab(slab);
+	slabused += SLOTSIZE(sc);
+
+	return (memblock_t *)(slot + 1);
+}
+
+/** Puts a slab block's slot back on its slab's free list.
+  * Empty slabs are kept until Z_ReleaseEmptySlabs.
+  */
+static void Z_SlabFree(memblock_t *block)
+{
+	void **slot = (void **)block - 1;
+	zslab_t *slab = slot[0];
+
+	if (slab->used-- == slab->capacity)
+		Z_LinkSlab(slab);
+
+	slot[1] = slab->freeslot;
+	slab->freeslot = slot;
+	slabused -= SLOTSIZE(slab->sizeclass);
+}
+
+// Gives slabs nothing is using back to the system.
+static void Z_ReleaseEmptySlabs(void)
+{
+	zslab_t *slab, *next;
+	size_t sc;
+
+	for (sc = 0; sc < NUMSLABCLASSES; sc++)
+	{
+		for (slab = freeslabs[sc]; slab; slab = next)
+		{
+			next = slab->next;
+			if (slab->used)
+				continue;
+			Z_UnlinkSlab(slab);
+			free(slab);
+			slabtotal -= SLABSIZE;
+		}
+	}
+}
+
+// -----------
+// Level arena
+// -----------
+// Level geometry and the other big PU_LEVEL/PU_LEVSPEC blocks are
+// bump-allocated out of large chunks instead of being malloc'd one by one.
+// A chunk is given back as soon as the last block in it is freed, which
+// for level data means all at once when Z_FreeTags clears the level. The
+// chunk currently being filled is just rewound instead, ready for the next
+// map. Blocks can still be freed, retagged or reallocated individually;
+// freeing one early only keeps its space reserved until its chunk empties.
+
+#define ARENACHUNKSIZE (1<<20)
+#define ARENAMAXBLOCK (ARENACHUNKSIZE/4) // anything bigger gets its own malloc
+
+typedef struct
+{
+	size_t start; // offset of the first slot, which is aligned
+	size_t used; // bump offset from the start of the chunk
+	UINT32 live; // blocks in this chunk not yet freed
+} zarenachunk_t;
+
+#define ARENASLOTSIZE(size) (SLOTHEADER + ZONEALIGNUP(size))
+
+static zarenachunk_t *arenachunk; // the chunk new blocks come from
+static size_t arenatotal, arenaused; // bytes, for memfree
+
+static boolean Z_IsArenaTag(INT32 tag)
+{
+	return (tag == PU_LEVEL || tag == PU_LEVSPEC);
+}
+
+/** Bump-allocates a block in the level arena, starting a new chunk if the
+  * current one is full.
+  *
+  * \param size Size of the block's data.
+  * \return The block header.
+  */
+static memblock_t *Z_ArenaAlloc(size_t size)
+{
+	const size_t slotsize = ARENASLOTSIZE(size);
+	zarenachunk_t **slot;
+
+	if (!arenachunk || arenachunk->used + slotsize > ARENACHUNKSIZE)
+	{
+		// The old chunk is freed along with its last block.
+		arenachunk = xm(ARENACHUNKSIZE);
+		arenachunk->start = ZONEALIGNUP((uintptr_t)arenachunk + sizeof (zarenachunk_t)) - (uintptr_t)arenachunk;
+		arenachunk->used = arenachunk->start;
+		arenachunk->live = 0;
+		arenatotal += ARENACHUNKSIZE;
+	}
+
+	slot = (zarenachunk_t **)SLOTBLOCK((UINT8 *)arenachunk + arenachunk->used) - 1;
+	*slot = arenachunk;
+	arenachunk->used += slotsize;
+	arenachunk->live++;
+	arenaused += slotsize;
+
+	return (memblock_t *)(slot + 1);
+}
+
+static void Z_ArenaFree(memblock_t *block)
+{
+	zarenachunk_t *chunk = ((zarenachunk_t **)block)[-1];
+
+	arenaused -= ARENASLOTSIZE(block->realsize);
+
+	if (--chunk->live)
+	{
+		// If it was the last block handed out, its space can be reused.
+		if (chunk == arenachunk && (UINT8 *)MEMORY(block) + ZONEALIGNUP(block->realsize) == (UINT8 *)chunk + chunk->used)
+			chunk->used -= ARENASLOTSIZE(block->realsize);
+		return;
+	}
+
+	if (chunk == arenachunk)
+		chunk->used = chunk->start;
+	else
+	{
+		free(chunk);
+		arenatotal -= ARENACHUNKSIZE;
+	}
+}
+
+/** Resizes the last block handed out by the arena in place, which is what
+  * arrays grown one element at a time while loading a level usually are.
+  *
+  * \return True if the block was resized.
+  */
+static boolean Z_ArenaResize(memblock_t *block, size_t size)
+{
+	zarenachunk_t *chunk = ((zarenachunk_t **)block)[-1];
+	const size_t oldslot = ARENASLOTSIZE(block->realsize);
+	const size_t newslot = ARENASLOTSIZE(size);
+
+	if (chunk != arenachunk || size > ARENAMAXBLOCK)
+		return false;
+	if ((UINT8 *)MEMORY(block) + ZONEALIGNUP(block->realsize) != (UINT8 *)chunk + chunk->used)
+		return false;
+	if (chunk->used - oldslot + newslot > ARENACHUNKSIZE)
+		return false;
+
+	chunk->used = chunk->used - oldslot + newslot;
+	arenaused = arenaused - oldslot + newslot;
+	block->size = sizeof (memblock_t) + size;
+	block->realsize = size;
+	return true;
+}
+
 /** The Z_MallocAlign function.
   * Allocates a block of memory, adds it to a linked list so we can keep track of it.
   *
@@ -220,13 +516,19 @@ void *Z_MallocAlign(size_t size, INT32 tag, void *user, INT32 alignbits)
 {
 	memblock_t *block;
 	void *ptr;
+	INT32 sc = Z_SlabClass(size);
 	(void)(alignbits); // no longer used, so silence warnings.
 
 #ifdef ZDEBUG2
 	CONS_Debug(DBG_MEMORY, "Z_Malloc %s:%d\n", file, line);
 #endif
 
-	block = xm(sizeof (memblock_t) + size);
+	if (sc >= 0)
+		block = Z_SlabAlloc(sc);
+	else if (Z_IsArenaTag(tag) && size <= ARENAMAXBLOCK)
+		block = Z_ArenaAlloc(size);
+	else
+		block = xm(sizeof (memblock_t) + size);
 	ptr = MEMORY(block);
 	I_Assert((intptr_t)ptr % sizeof (void *) == 0);
 
@@ -252,7 +554,12 @@ void *Z_MallocAlign(size_t size, INT32 tag, void *user, INT32 alignbits)
 	VALGRIND_CREATE_MEMPOOL(block, size, Z_calloc);
 #endif
 
-	block->id = ZONEID;
+	if (sc >= 0)
+		block->id = ZONESLABID;
+	else if (Z_IsArenaTag(tag) && size <= ARENAMAXBLOCK)
+		block->id = ZONEARENAID;
+	else
+		block->id = ZONEID;
 
 	if (user != NULL)
 	{
@@ -342,7 +649,7 @@ void *Z_ReallocAlign(void *ptr, size_t size, INT32 tag, void *user, INT32 alignb
 
 	block = MEMBLOCK(ptr);
 #ifdef PARANOIA
-	if (block->id != ZONEID)
+	if (!Z_VALIDID(block))
 #ifdef ZDEBUG
 		I_Error("Z_ReallocAlign at %s:%d: wrong id", file, line);
 #else
@@ -353,6 +660,21 @@ void *Z_ReallocAlign(void *ptr, size_t size, INT32 tag, void *user, INT32 alignb
 	if (block == NULL)
 		return NULL;
 
+	copysize = block->realsize;
+	if (block->id == ZONEARENAID && Z_IsArenaTag(tag) && Z_SlabClass(size) < 0
+	&& Z_ArenaResize(block, size))
+	{
+		if (size > copysize)
+			memset((char*)ptr+copysize, 0x00, size-copysize);
+		if (block->user != NULL && block->user != user)
+			*block->user = NULL;
+		block->user = user;
+		block->tag = tag;
+		if (user)
+			*((void**)user) = ptr;
+		return ptr;
+	}
+
 #ifdef ZDEBUG
 	// Write every Z_Realloc call to a debug file.
 	DEBFILE(va("Z_Realloc at %s:%d\n", file, line));
@@ -385,6 +707,92 @@ void *Z_ReallocAlign(void *ptr, size_t size, INT32 tag, void *user, INT32 alignb
 	return rez;
 }
 
+#ifdef HAVE_MMAP
+/** Maps part of an open file into zone memory instead of reading it.
+  * The mapping is private and copy-on-write, so the block can be written
+  * to, retagged and freed like any other; pages are only read from disk
+  * as they are touched.
+  *
+  * \param fd File descriptor, opened for reading.
+  * \param offset Position of the data in the file.
+  *               Must be pointer-aligned, as zone memory always is.
+  * \param size Length of the data, in bytes.
+  * \param tag Purge tag.
+  * \param user The address of a pointer to the mapped memory, as with Z_Malloc.
+  * \return A pointer to the data, or NULL if it couldn't be mapped,
+  *         in which case the caller should read it normally.
+  */
+void *Z_MapFile(int fd, size_t offset, size_t size, INT32 tag, void *user)
+{
+	const size_t pagesize = (size_t)sysconf(_SC_PAGESIZE);
+	const size_t pageoffset = offset % pagesize;
+	// The header has to sit right before the data. If the data starts too
+	// close to a page boundary, put an anonymous page in front for it.
+	const size_t headerpage = (pageoffset < sizeof (memblock_t)) ? pagesize : 0;
+	const size_t maplen = headerpage + pageoffset + size;
+	memblock_t *block;
+	UINT8 *base;
+	void *ptr;
+
+	if (offset % sizeof (void *) || !size)
+		return NULL;
+
+	if (tag >= PU_PURGELEVEL && user == NULL)
+		I_Error("Z_MapFile: attempted to map purgable block "
+			"(size %s) with no user", sizeu1(size));
+
+	if (headerpage)
+	{
+		base = mmap(NULL, maplen, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+		if (base == MAP_FAILED)
+			return NULL;
+		if (mmap(base + headerpage, maplen - headerpage, PROT_READ|PROT_WRITE,
+			MAP_PRIVATE|MAP_FIXED, fd, (off_t)(offset - pageoffset)) == MAP_FAILED)
+		{
+			munmap(base, maplen);
+			return NULL;
+		}
+	}
+	else
+	{
+		base = mmap(NULL, maplen, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, (off_t)(offset - pageoffset));
+		if (base == MAP_FAILED)
+			return NULL;
+	}
+
+	ptr = base + headerpage + pageoffset;
+	block = MEMBLOCK(ptr);
+
+	block->next = head.next;
+	block->prev = &head;
+	head.next = block;
+	block->next->prev = block;
+
+	block->tag = tag;
+	block->user = NULL;
+#ifdef ZDEBUG
+	block->ownerline = __LINE__;
+	block->ownerfile = __FILE__;
+#endif
+	block->size = sizeof (memblock_t) + size;
+	block->realsize = size;
+
+#ifdef VALGRIND_CREATE_MEMPOOL
+	VALGRIND_CREATE_MEMPOOL(block, size, true);
+#endif
+
+	block->id = ZONEMAPID;
+
+	if (user != NULL)
+	{
+		block->user = user;
+		*(void **)user = ptr;
+	}
+
+	return ptr;
+}
+#endif
+
 /** Frees all memory for a given set of tags.
   *
   * \param lowtag The lowest tag to consider.
@@ -401,6 +809,8 @@ void Z_FreeTags(INT32 lowtag, INT32 hightag)
 		if (block->tag >= lowtag && block->tag <= hightag)
 			Z_Free(MEMORY(block));
 	}
+
+	Z_ReleaseEmptySlabs();
 }
 
 /** Iterates through all memory for a given set of tags.
@@ -528,7 +938,7 @@ void Z_CheckHeap(INT32 i)
 #endif
 				);
 		}
-		if (block->id != ZONEID)
+		if (!Z_VALIDID(block))
 		{
 			I_Error("Z_CheckHeap %d: block %u"
 #ifdef ZDEBUG
@@ -568,7 +978,7 @@ void Z_ChangeTag(void *ptr, INT32 tag)
 	block = MEMBLOCK(ptr);
 
 #ifdef PARANOIA
-	if (block->id != ZONEID) I_Error("Z_ChangeTag at %s:%d: wrong id", file, line);
+	if (!Z_VALIDID(block)) I_Error("Z_ChangeTag at %s:%d: wrong id", file, line);
 #endif
 
 	if (tag >= PU_PURGELEVEL && block->user == NULL)
@@ -599,7 +1009,7 @@ void Z_SetUser(void *ptr, void **newuser)
 	block = MEMBLOCK(ptr);
 
 #ifdef PARANOIA
-	if (block->id != ZONEID) I_Error("Z_SetUser at %s:%d: wrong id", file, line);
+	if (!Z_VALIDID(block)) I_Error("Z_SetUser at %s:%d: wrong id", file, line);
 #endif
 
 	if (block->tag >= PU_PURGELEVEL && newuser == NULL)
@@ -663,6 +1073,10 @@ static void Command_Memfree_f(void)
 	CONS_Printf(M_GetText("Special thinker        : %7s KB\n"), sizeu1(Z_TagUsage(PU_LEVSPEC)>>10));
 	CONS_Printf(M_GetText("All purgable           : %7s KB\n"),
 		sizeu1(Z_TagsUsage(PU_PURGELEVEL, INT32_MAX)>>10));
+	CONS_Printf(M_GetText("Small-block slabs      : %7s KB (%s KB in use)\n"),
+		sizeu1(slabtotal>>10), sizeu2(slabused>>10));
+	CONS_Printf(M_GetText("Level arena            : %7s KB (%s KB in use)\n"),
+		sizeu1(arenatotal>>10), sizeu2(arenaused>>10));
 
 #ifdef HWRENDER
 	if (rendermode == render_opengl)
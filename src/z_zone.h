@@ -107,6 +107,10 @@ void *Z_ReallocAlign(void *ptr, size_t size, INT32 tag, void *user, INT32 alignb
 #define Z_Calloc(s,t,u)    Z_CallocAlign(s, t, u, sizeof(void *))
 #define Z_Realloc(p,s,t,u) Z_ReallocAlign(p, s, t, u, sizeof(void *))
 
+#ifdef HAVE_MMAP
+void *Z_MapFile(int fd, size_t offset, size_t size, INT32 tag, void *user);
+#endif
+
 // Free all memory by tag
 // these don't give line numbers for ZDEBUG currently though
 // (perhaps this should be changed in future?)